@@ -0,0 +1,578 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aligned_memory.h"
+#include "cglm/cglm.h"
+#include "cube.h"
+#include "renderer.h"
+#include "tracy/TracyC.h"
+
+// Fixed scenes through the whole raster pipeline at fixed resolutions, with a fixed camera, so
+// two runs on the same machine only differ by timing noise and two commits are comparable:
+// frame time percentiles, throughput, and a checksum of the last frame so a faster build can
+// be told apart from one that draws something else. Results go out as JSON, one result per
+// line; -b compares against such a file from an earlier build.
+
+#define BENCH_MAX_RESOLUTIONS 8
+
+typedef struct {
+    model sphere; // High-poly mesh
+    model wire_sphere; // Low-poly, with edges
+    model grid; // Many small triangles facing the camera
+    model quads; // Screen-filling layers
+    model cube;
+    float *instance_components; // 10 arrays of BENCH_INSTANCE_COUNT, see instance_data
+    instance_data instances;
+} bench_assets;
+
+#define BENCH_INSTANCE_COUNT 4096
+
+typedef void bench_draw(const bench_assets *assets, camera *cam, graphics_buffer *buff);
+
+typedef struct {
+    const char *name;
+    bench_draw *draw;
+} bench_scene;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+} bench_resolution;
+
+typedef struct {
+    uint32_t frame_count;
+    uint32_t warmup_count;
+    uint32_t thread_count;
+    const char *filter; // Substring of the scene names to run, 0 = all
+    const char *output_path; // 0 = stdout
+    const char *baseline_path; // 0 = no comparison
+    bench_resolution resolutions[BENCH_MAX_RESOLUTIONS];
+    uint32_t resolution_count;
+} bench_options;
+
+typedef struct {
+    const char *scene;
+    uint32_t width;
+    uint32_t height;
+    double ms_min;
+    double ms_mean;
+    double ms_p50;
+    double ms_p90;
+    double ms_p99;
+    uint64_t triangles; // Per frame, into the pipeline
+    uint64_t lines; // Per frame, for render_obj_wire
+    uint64_t pixels_written; // Per frame
+    double mtris_per_s;
+    double mpixels_per_s;
+    uint64_t checksum;
+} bench_result;
+
+static double get_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// --- Assets ---
+
+static bool alloc_model(model *m, const uint32_t vertex_count, const uint32_t index_count) {
+    *m = (model){0};
+    m->vertices = malloc(sizeof(vec4) * vertex_count);
+    m->indices = malloc(sizeof(uint32_t) * index_count);
+    if (!m->vertices || !m->indices) {
+        free(m->vertices);
+        free(m->indices);
+        *m = (model){0};
+        return false;
+    }
+    TracyCAlloc(m->vertices, sizeof(vec4) * vertex_count);
+    TracyCAlloc(m->indices, sizeof(uint32_t) * index_count);
+
+    m->vertex_count = vertex_count;
+    m->index_count = index_count;
+    return true;
+}
+
+// Quad (a, b, c, d) counter-clockwise seen from the front, as two clockwise-on-screen triangles
+static uint32_t *emit_quad(uint32_t *out, const uint32_t a, const uint32_t b, const uint32_t c, const uint32_t d) {
+    *out++ = a;
+    *out++ = c;
+    *out++ = b;
+    *out++ = a;
+    *out++ = d;
+    *out++ = c;
+    return out;
+}
+
+static bool make_sphere(model *m, const uint32_t slices, const uint32_t stacks, const float radius) {
+    if (!alloc_model(m, (slices + 1) * (stacks + 1), slices * stacks * 6)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i <= stacks; ++i) {
+        const float theta = (float) GLM_PI * (float) i / (float) stacks;
+        for (uint32_t j = 0; j <= slices; ++j) {
+            const float phi = 2.0f * (float) GLM_PI * (float) j / (float) slices;
+            float *v = m->vertices[i * (slices + 1) + j];
+            v[0] = radius * sinf(theta) * cosf(phi);
+            v[1] = radius * cosf(theta);
+            v[2] = -radius * sinf(theta) * sinf(phi);
+            v[3] = 1.0f;
+        }
+    }
+
+    // Seen from outside, stack i + 1 is below stack i and slice j + 1 is to the right of j
+    uint32_t *out = m->indices;
+    for (uint32_t i = 0; i < stacks; ++i) {
+        for (uint32_t j = 0; j < slices; ++j) {
+            const uint32_t top = i * (slices + 1) + j;
+            const uint32_t bottom = top + slices + 1;
+            out = emit_quad(out, bottom, bottom + 1, top + 1, top);
+        }
+    }
+    return true;
+}
+
+// A columns x rows grid of quads in the z = 0 plane, facing +z
+static bool make_grid(model *m, const uint32_t columns, const uint32_t rows, const float width, const float height) {
+    if (!alloc_model(m, (columns + 1) * (rows + 1), columns * rows * 6)) {
+        return false;
+    }
+
+    for (uint32_t y = 0; y <= rows; ++y) {
+        for (uint32_t x = 0; x <= columns; ++x) {
+            float *v = m->vertices[y * (columns + 1) + x];
+            v[0] = width * ((float) x / (float) columns - 0.5f);
+            v[1] = height * ((float) y / (float) rows - 0.5f);
+            v[2] = 0.0f;
+            v[3] = 1.0f;
+        }
+    }
+
+    uint32_t *out = m->indices;
+    for (uint32_t y = 0; y < rows; ++y) {
+        for (uint32_t x = 0; x < columns; ++x) {
+            const uint32_t bottom = y * (columns + 1) + x;
+            const uint32_t top = bottom + columns + 1;
+            out = emit_quad(out, bottom, bottom + 1, top + 1, top);
+        }
+    }
+    return true;
+}
+
+// layer_count quads facing +z, from z = 0 back, listed far to near so every layer passes the
+// depth test: each pixel is written layer_count times
+static bool make_layers(model *m, const uint32_t layer_count, const float spacing) {
+    if (!alloc_model(m, layer_count * 4, layer_count * 6)) {
+        return false;
+    }
+
+    uint32_t *out = m->indices;
+    for (uint32_t l = 0; l < layer_count; ++l) {
+        const float z = -spacing * (float) (layer_count - 1 - l);
+        const vec4 corners[4] = {
+            {-8.0f, -5.0f, z, 1.0f}, {8.0f, -5.0f, z, 1.0f}, {8.0f, 5.0f, z, 1.0f}, {-8.0f, 5.0f, z, 1.0f},
+        };
+        memcpy(m->vertices[l * 4], corners, sizeof(corners));
+        out = emit_quad(out, l * 4, l * 4 + 1, l * 4 + 2, l * 4 + 3);
+    }
+    return true;
+}
+
+// A 16 x 16 x 16 block of cubes in front of the camera, each turned its own fixed way
+static bool make_instances(bench_assets *assets) {
+    const uint32_t count = BENCH_INSTANCE_COUNT;
+    float *c = malloc(sizeof(float) * count * 10);
+    if (!c) {
+        return false;
+    }
+    TracyCAlloc(c, sizeof(float) * count * 10);
+    assets->instance_components = c;
+
+    float *position[3] = {c, c + count, c + 2 * count};
+    float *rotation[4] = {c + 3 * count, c + 4 * count, c + 5 * count, c + 6 * count};
+    float *scale[3] = {c + 7 * count, c + 8 * count, c + 9 * count};
+    for (uint32_t i = 0; i < count; ++i) {
+        position[0][i] = ((float) (i % 16) - 7.5f) * 0.4f;
+        position[1][i] = ((float) (i / 16 % 16) - 7.5f) * 0.22f;
+        position[2][i] = -(float) (i / 256) * 0.4f;
+
+        versor q;
+        glm_quat(q, (float) i * 0.1f, 0.3f, 1.0f, (float) (i % 5) * 0.2f);
+        for (int k = 0; k < 4; ++k) {
+            rotation[k][i] = q[k];
+        }
+        for (int k = 0; k < 3; ++k) {
+            scale[k][i] = 0.15f;
+        }
+    }
+
+    assets->instances = (instance_data){
+        position[0], position[1], position[2],
+        rotation[0], rotation[1], rotation[2], rotation[3],
+        scale[0], scale[1], scale[2],
+    };
+    return true;
+}
+
+static bool assets_init(bench_assets *assets) {
+    *assets = (bench_assets){0};
+    if (!make_sphere(&assets->sphere, 512, 256, 1.2f) || !make_sphere(&assets->wire_sphere, 96, 48, 1.2f) ||
+        !make_grid(&assets->grid, 384, 216, 6.0f, 3.4f) || !make_layers(&assets->quads, 4, 0.5f) ||
+        !make_instances(assets)) {
+        return false;
+    }
+    model_build_unique_edges(&assets->wire_sphere);
+    init_cube_mesh(&assets->cube);
+    return true;
+}
+
+static void assets_free(bench_assets *assets) {
+    model_free(&assets->sphere);
+    model_free(&assets->wire_sphere);
+    model_free(&assets->grid);
+    model_free(&assets->quads);
+    model_free(&assets->cube);
+    if (assets->instance_components) {
+        TracyCFree(assets->instance_components);
+        free(assets->instance_components);
+    }
+    *assets = (bench_assets){0};
+}
+
+// --- Scenes ---
+
+static void draw_small_triangles(const bench_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = GLM_VEC3_ZERO_INIT;
+    versor rot = GLM_QUAT_IDENTITY_INIT;
+    render_obj_raster(assets->grid, pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+static void draw_large_triangles(const bench_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = GLM_VEC3_ZERO_INIT;
+    versor rot = GLM_QUAT_IDENTITY_INIT;
+    render_obj_raster(assets->quads, pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+static void draw_high_poly(const bench_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = GLM_VEC3_ZERO_INIT;
+    versor rot;
+    glm_quat(rot, 0.5f, 1.0f, 1.0f, 0.0f);
+    render_obj_raster(assets->sphere, pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+static void draw_wireframe(const bench_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = GLM_VEC3_ZERO_INIT;
+    versor rot;
+    glm_quat(rot, 0.5f, 1.0f, 1.0f, 0.0f);
+    render_obj_wire(assets->wire_sphere, pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+static void draw_instances(const bench_assets *assets, camera *cam, graphics_buffer *buff) {
+    render_obj_raster_instanced(&assets->cube, &assets->instances, BENCH_INSTANCE_COUNT, cam, buff);
+}
+
+static const bench_scene g_scenes[] = {
+    {"small_triangles", draw_small_triangles},
+    {"large_triangles", draw_large_triangles},
+    {"high_poly_mesh", draw_high_poly},
+    {"wireframe", draw_wireframe},
+    {"instances", draw_instances},
+};
+
+// --- Running ---
+
+static int compare_doubles(const void *a, const void *b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double *sorted, const uint32_t count, const double p) {
+    uint32_t rank = (uint32_t) ceil(p / 100.0 * (double) count);
+    rank = rank ? rank - 1 : 0;
+    return sorted[rank < count ? rank : count - 1];
+}
+
+// FNV-1a over the visible pixels, row by row so the pitch does not matter
+static uint64_t checksum_pixels(const graphics_buffer *buff) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t y = 0; y < buff->height; ++y) {
+        const uint8_t *row = (const uint8_t *) buff->memory + (size_t) y * buff->pitch;
+        for (size_t i = 0; i < (size_t) buff->width * 4; ++i) {
+            hash = (hash ^ row[i]) * 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+static bool run_scene(const bench_options *options, const bench_assets *assets, const bench_scene *scene,
+                      const bench_resolution resolution, bench_result *result) {
+    graphics_buffer buff = {0};
+    buff.width = resolution.width;
+    buff.height = resolution.height;
+    buff.pitch = resolution.width * 4;
+    buff.memory_size = ((size_t) buff.pitch * buff.height + 63) & ~(size_t) 63;
+    buff.memory = aligned_malloc(64, buff.memory_size);
+    double *frame_ms = malloc(sizeof(double) * options->frame_count);
+    if (!buff.memory || !frame_ms) {
+        aligned_free(buff.memory);
+        free(frame_ms);
+        return false;
+    }
+    TracyCAlloc(buff.memory, buff.memory_size);
+    TracyCAlloc(frame_ms, sizeof(double) * options->frame_count);
+
+    renderer_depth_init(&buff);
+    renderer_tiles_init(&buff);
+
+    camera cam;
+    vec3 eye = {0.0f, 0.0f, 3.0f};
+    versor look;
+    glm_quat_forp(eye, GLM_VEC3_ZERO, ((vec3){0.0f, 1.0f, 0.0f}), look);
+    camera_init(&cam, eye, look, glm_rad(60.0f), (float) buff.width / (float) buff.height, 0.1f, 100.0f);
+
+    renderer_stats stats = {0};
+    for (uint32_t frame = 0; frame < options->warmup_count + options->frame_count; ++frame) {
+        TracyCFrameMarkStart("bench");
+        const double start = get_seconds();
+
+        clean_buff(&buff);
+        renderer_begin_frame(&buff);
+        scene->draw(assets, &cam, &buff);
+        renderer_end_frame(&buff);
+
+        const double elapsed = get_seconds() - start;
+        TracyCFrameMarkEnd("bench");
+
+        if (frame >= options->warmup_count) {
+            frame_ms[frame - options->warmup_count] = elapsed * 1000.0;
+        }
+    }
+    renderer_get_stats(&stats);
+
+    double total_ms = 0.0;
+    for (uint32_t i = 0; i < options->frame_count; ++i) {
+        total_ms += frame_ms[i];
+    }
+    qsort(frame_ms, options->frame_count, sizeof(double), compare_doubles);
+
+    const double mean_s = total_ms / options->frame_count / 1000.0;
+    *result = (bench_result){
+        .scene = scene->name,
+        .width = buff.width,
+        .height = buff.height,
+        .ms_min = frame_ms[0],
+        .ms_mean = total_ms / options->frame_count,
+        .ms_p50 = percentile(frame_ms, options->frame_count, 50.0),
+        .ms_p90 = percentile(frame_ms, options->frame_count, 90.0),
+        .ms_p99 = percentile(frame_ms, options->frame_count, 99.0),
+        .triangles = stats.triangles_in,
+        .lines = scene->draw == draw_wireframe ? assets->wire_sphere.edge_count : 0,
+        .pixels_written = stats.pixels_written,
+        .mtris_per_s = mean_s > 0.0 ? (double) stats.triangles_in / mean_s * 1e-6 : 0.0,
+        .mpixels_per_s = mean_s > 0.0 ? (double) stats.pixels_written / mean_s * 1e-6 : 0.0,
+        .checksum = checksum_pixels(&buff),
+    };
+
+    renderer_tiles_free(&buff);
+    renderer_depth_free(&buff);
+    TracyCFree(frame_ms);
+    free(frame_ms);
+    TracyCFree(buff.memory);
+    aligned_free(buff.memory);
+    return true;
+}
+
+// --- Output ---
+
+static void write_result(FILE *out, const bench_result *r, const bool last) {
+    fprintf(out,
+            "    {\"scene\": \"%s\", \"width\": %u, \"height\": %u, \"ms_min\": %.4f, \"ms_mean\": %.4f, "
+            "\"ms_p50\": %.4f, \"ms_p90\": %.4f, \"ms_p99\": %.4f, \"triangles\": %llu, \"lines\": %llu, "
+            "\"pixels_written\": %llu, \"mtris_per_s\": %.2f, \"mpixels_per_s\": %.2f, "
+            "\"checksum\": \"%016llx\"}%s\n",
+            r->scene, r->width, r->height, r->ms_min, r->ms_mean, r->ms_p50, r->ms_p90, r->ms_p99,
+            (unsigned long long) r->triangles, (unsigned long long) r->lines,
+            (unsigned long long) r->pixels_written, r->mtris_per_s, r->mpixels_per_s,
+            (unsigned long long) r->checksum, last ? "" : ",");
+}
+
+// Looks up scene at width x height in a file written by write_result. Not a JSON parser: it
+// relies on this tool's one-result-per-line layout.
+static bool find_baseline(FILE *baseline, const bench_result *r, double *ms_p50, uint64_t *checksum) {
+    rewind(baseline);
+    char line[1024];
+    while (fgets(line, sizeof(line), baseline)) {
+        char scene[64];
+        uint32_t width, height;
+        unsigned long long hash;
+        double p50;
+        if (sscanf(line, " {\"scene\": \"%63[^\"]\", \"width\": %u, \"height\": %u", scene, &width, &height) != 3 ||
+            strcmp(scene, r->scene) != 0 || width != r->width || height != r->height) {
+            continue;
+        }
+
+        const char *p50_field = strstr(line, "\"ms_p50\": ");
+        const char *checksum_field = strstr(line, "\"checksum\": \"");
+        if (!p50_field || !checksum_field || sscanf(p50_field, "\"ms_p50\": %lf", &p50) != 1 ||
+            sscanf(checksum_field, "\"checksum\": \"%llx\"", &hash) != 1) {
+            return false;
+        }
+        *ms_p50 = p50;
+        *checksum = hash;
+        return true;
+    }
+    return false;
+}
+
+static void print_usage(const char *exe) {
+    fprintf(stderr,
+            "usage: %s [-n frames] [-w warmup] [-t threads] [-s scene] [-r WxH]... [-o out.json] [-b baseline.json]\n"
+            "  -n   timed frames per scene and resolution (default 100)\n"
+            "  -w   untimed frames before them (default 10)\n"
+            "  -t   raster threads including the main thread (default 1)\n"
+            "  -s   only run scenes whose name contains this\n"
+            "  -r   resolution, repeatable (default 640x360, 1280x720, 1920x1080)\n"
+            "  -o   write the JSON results here instead of stdout\n"
+            "  -b   compare median frame times and checksums with an earlier -o file\n"
+            "scenes: small_triangles, large_triangles, high_poly_mesh, wireframe, instances\n",
+            exe);
+}
+
+static bool parse_options(const int argc, char **argv, bench_options *options) {
+    *options = (bench_options){
+        .frame_count = 100,
+        .warmup_count = 10,
+        .thread_count = 1,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:t:s:r:o:b:")) != -1) {
+        switch (opt) {
+            case 'n': options->frame_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'w': options->warmup_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 't': options->thread_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 's': options->filter = optarg;
+                break;
+            case 'o': options->output_path = optarg;
+                break;
+            case 'b': options->baseline_path = optarg;
+                break;
+            case 'r': {
+                bench_resolution *r = &options->resolutions[options->resolution_count];
+                if (options->resolution_count == BENCH_MAX_RESOLUTIONS ||
+                    sscanf(optarg, "%ux%u", &r->width, &r->height) != 2 || !r->width || !r->height) {
+                    return false;
+                }
+                options->resolution_count++;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    if (!options->resolution_count) {
+        options->resolutions[0] = (bench_resolution){640, 360};
+        options->resolutions[1] = (bench_resolution){1280, 720};
+        options->resolutions[2] = (bench_resolution){1920, 1080};
+        options->resolution_count = 3;
+    }
+    return options->frame_count > 0;
+}
+
+int main(const int argc, char **argv) {
+    bench_options options;
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE *baseline = 0;
+    if (options.baseline_path && !(baseline = fopen(options.baseline_path, "r"))) {
+        fprintf(stderr, "failed to open %s\n", options.baseline_path);
+        return 1;
+    }
+
+    bench_assets assets;
+    if (!assets_init(&assets)) {
+        fprintf(stderr, "failed to build the scenes\n");
+        return 1;
+    }
+
+    renderer_set_raster_path(RASTER_PATH_SIMD);
+    renderer_set_line_mode(LINE_MODE_ALIASED);
+    renderer_set_thread_count(options.thread_count);
+
+    constexpr uint32_t scene_count = sizeof(g_scenes) / sizeof(g_scenes[0]);
+    bench_result results[scene_count * BENCH_MAX_RESOLUTIONS];
+    uint32_t result_count = 0;
+    bool changed = false;
+
+    fprintf(stderr, "%-16s %10s %9s %9s %9s %10s %10s  %s\n", "scene", "resolution", "p50 ms", "p90 ms", "p99 ms",
+            "Mtris/s", "Mpix/s", "checksum");
+    for (uint32_t s = 0; s < scene_count; ++s) {
+        if (options.filter && !strstr(g_scenes[s].name, options.filter)) {
+            continue;
+        }
+
+        for (uint32_t r = 0; r < options.resolution_count; ++r) {
+            bench_result *result = &results[result_count];
+            if (!run_scene(&options, &assets, &g_scenes[s], options.resolutions[r], result)) {
+                fprintf(stderr, "failed to allocate a %ux%u target\n", options.resolutions[r].width,
+                        options.resolutions[r].height);
+                continue;
+            }
+            result_count++;
+
+            char resolution[32];
+            snprintf(resolution, sizeof(resolution), "%ux%u", result->width, result->height);
+            fprintf(stderr, "%-16s %10s %9.3f %9.3f %9.3f %10.2f %10.2f  %016llx", result->scene, resolution,
+                    result->ms_p50, result->ms_p90, result->ms_p99, result->mtris_per_s, result->mpixels_per_s,
+                    (unsigned long long) result->checksum);
+
+            double baseline_p50;
+            uint64_t baseline_checksum;
+            if (baseline && find_baseline(baseline, result, &baseline_p50, &baseline_checksum)) {
+                const bool same_pixels = baseline_checksum == result->checksum;
+                changed |= !same_pixels;
+                fprintf(stderr, "  %+6.1f%%%s", (result->ms_p50 / baseline_p50 - 1.0) * 100.0,
+                        same_pixels ? "" : "  PIXELS CHANGED");
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+
+    FILE *out = options.output_path ? fopen(options.output_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "failed to open %s\n", options.output_path);
+    } else {
+        fprintf(out, "{\n  \"frames\": %u,\n  \"warmup\": %u,\n  \"threads\": %u,\n  \"results\": [\n",
+                options.frame_count, options.warmup_count, options.thread_count);
+        for (uint32_t i = 0; i < result_count; ++i) {
+            write_result(out, &results[i], i + 1 == result_count);
+        }
+        fprintf(out, "  ]\n}\n");
+        if (out != stdout) {
+            fclose(out);
+        }
+    }
+
+    if (baseline) {
+        fclose(baseline);
+    }
+    renderer_set_thread_count(1);
+    assets_free(&assets);
+
+    // A checksum that moved is a rendering change, not a performance one: fail so scripts notice
+    return out && !changed ? 0 : 2;
+}
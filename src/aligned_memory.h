@@ -0,0 +1,29 @@
+#ifndef MYC23PROJECT_ALIGNED_MEMORY_H
+#define MYC23PROJECT_ALIGNED_MEMORY_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// C11 aligned_alloc is missing from the MSVC and MinGW CRTs, whose _aligned_malloc memory has to
+// go back through _aligned_free. Memory from aligned_malloc must only be freed with aligned_free.
+static inline void *aligned_malloc(const size_t align, const size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    return aligned_alloc(align, size);
+#endif
+}
+
+static inline void aligned_free(void *memory) {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+#endif //MYC23PROJECT_ALIGNED_MEMORY_H
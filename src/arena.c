@@ -0,0 +1,155 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+#include "aligned_memory.h"
+#include "tracy/TracyC.h"
+
+// Block data starts one cache line after the header, so aligned allocations never straddle
+// the header and the first allocation of a block is cache-line aligned.
+#define ARENA_BLOCK_ALIGN 64
+
+struct arena_block {
+    arena_block *next;
+    size_t size; // Usable bytes after the header
+    size_t used;
+};
+
+static_assert(sizeof(arena_block) <= ARENA_BLOCK_ALIGN, "arena block header must fit in one cache line");
+
+static inline uint8_t *block_data(arena_block *block) {
+    return (uint8_t *) block + ARENA_BLOCK_ALIGN;
+}
+
+void arena_init(arena *a, const size_t block_size) {
+    *a = (arena){.block_size = block_size};
+}
+
+static arena_block *new_block(arena *a, const size_t min_size) {
+    size_t size = a->block_size ? a->block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    if (size < min_size) {
+        size = min_size;
+    }
+    size = (size + ARENA_BLOCK_ALIGN - 1) & ~(size_t) (ARENA_BLOCK_ALIGN - 1);
+
+    arena_block *block = aligned_malloc(ARENA_BLOCK_ALIGN, ARENA_BLOCK_ALIGN + size);
+    if (!block) {
+        return 0;
+    }
+    TracyCAlloc(block, ARENA_BLOCK_ALIGN + size);
+
+    *block = (arena_block){.size = size};
+    a->reserved += size;
+    return block;
+}
+
+void *arena_alloc(arena *a, const size_t size, const size_t align) {
+    arena_block *block = a->current;
+    while (block) {
+        const size_t offset = (block->used + align - 1) & ~(align - 1);
+        if (offset + size <= block->size) {
+            block->used = offset + size;
+            a->used += size;
+            return block_data(block) + offset;
+        }
+
+        // Blocks past current still hold last frame's usage
+        if (!block->next) {
+            break;
+        }
+        block = block->next;
+        block->used = 0;
+        a->current = block;
+    }
+
+    arena_block *fresh = new_block(a, size);
+    if (!fresh) {
+        return 0;
+    }
+    if (block) {
+        block->next = fresh;
+    } else {
+        a->first = fresh;
+    }
+    a->current = fresh;
+
+    fresh->used = size;
+    a->used += size;
+    return block_data(fresh);
+}
+
+void arena_reset(arena *a) {
+    a->current = a->first;
+    if (a->first) {
+        a->first->used = 0;
+    }
+    a->used = 0;
+}
+
+void arena_free(arena *a) {
+    arena_block *block = a->first;
+    while (block) {
+        arena_block *next = block->next;
+        TracyCFree(block);
+        aligned_free(block);
+        block = next;
+    }
+
+    arena_init(a, a->block_size);
+}
+
+void frame_arena_init(frame_arena *f, const size_t block_size) {
+    arena_init(&f->arenas[0], block_size);
+    arena_init(&f->arenas[1], block_size);
+    f->index = 0;
+}
+
+arena *frame_arena_begin(frame_arena *f) {
+    f->index ^= 1;
+    arena *current = &f->arenas[f->index];
+    arena_reset(current);
+    return current;
+}
+
+void frame_arena_free(frame_arena *f) {
+    arena_free(&f->arenas[0]);
+    arena_free(&f->arenas[1]);
+}
+
+// Records are at least a pointer, for the free list, and 16-byte aligned for vector loads.
+#define POOL_ALIGN 16
+
+void pool_init(pool *p, size_t element_size, const uint32_t elements_per_block) {
+    if (element_size < sizeof(void *)) {
+        element_size = sizeof(void *);
+    }
+    element_size = (element_size + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1);
+
+    *p = (pool){.element_size = element_size};
+    arena_init(&p->storage, element_size * elements_per_block);
+}
+
+void *pool_alloc(pool *p) {
+    if (p->free_list) {
+        void *element = p->free_list;
+        p->free_list = *(void **) element;
+        return element;
+    }
+
+    return arena_alloc(&p->storage, p->element_size, POOL_ALIGN);
+}
+
+void pool_release(pool *p, void *element) {
+    *(void **) element = p->free_list;
+    p->free_list = element;
+}
+
+void pool_reset(pool *p) {
+    p->free_list = 0;
+    arena_reset(&p->storage);
+}
+
+void pool_free(pool *p) {
+    arena_free(&p->storage);
+    p->free_list = 0;
+}
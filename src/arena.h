@@ -0,0 +1,67 @@
+#ifndef MYC23PROJECT_ARENA_H
+#define MYC23PROJECT_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Block size used when an arena was zero-initialized instead of going through arena_init.
+#define ARENA_DEFAULT_BLOCK_SIZE (256 * 1024)
+
+typedef struct arena_block arena_block;
+
+// Linear allocator over a chain of blocks. Allocating bumps a pointer; arena_reset rewinds to
+// the first block but keeps every block, so once the high-water mark has been reached the
+// arena never touches the heap again. Blocks are reported to Tracy, allocations are not.
+typedef struct {
+    arena_block *first;
+    arena_block *current;
+    size_t block_size; // Size of new blocks, larger allocations get a block of their own
+    size_t used; // Bytes handed out since the last reset
+    size_t reserved; // Bytes held in blocks
+} arena;
+
+void arena_init(arena *a, size_t block_size);
+
+// Returns 0 only when a new block was needed and the heap is out of memory. align must be a
+// power of two no larger than 64.
+void *arena_alloc(arena *a, size_t size, size_t align);
+
+#define arena_alloc_array(a, type, count) ((type *) arena_alloc((a), sizeof(type) * (count), alignof(type)))
+
+void arena_reset(arena *a);
+
+void arena_free(arena *a);
+
+// Two arenas used on alternate frames: what frame N allocated stays valid while frame N + 1
+// records, so a consumer of frame N (raster workers, present) can run behind the producer.
+typedef struct {
+    arena arenas[2];
+    uint32_t index; // Arena of the current frame
+} frame_arena;
+
+void frame_arena_init(frame_arena *f, size_t block_size);
+
+// Switches to the other arena and resets it, dropping what was allocated two frames ago.
+arena *frame_arena_begin(frame_arena *f);
+
+void frame_arena_free(frame_arena *f);
+
+// Fixed-size records bump-allocated from an arena and recycled through a free list. Releasing
+// single records is O(1), and pool_reset drops every record at once.
+typedef struct {
+    arena storage;
+    void *free_list;
+    size_t element_size;
+} pool;
+
+void pool_init(pool *p, size_t element_size, uint32_t elements_per_block);
+
+void *pool_alloc(pool *p);
+
+void pool_release(pool *p, void *element);
+
+void pool_reset(pool *p);
+
+void pool_free(pool *p);
+
+#endif //MYC23PROJECT_ARENA_H
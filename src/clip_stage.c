@@ -0,0 +1,117 @@
+#include "clip_stage.h"
+
+#include "profile.h"
+
+clip_guard_band clip_stage_guard_band(const uint32_t width, const uint32_t height) {
+    // screen_x = (x / w + 1) * half_width stays within [-G, width + G] for |x / w| <= 1 + G / half_width
+    const float half_width = 0.5f * (float) (width ? width : 1);
+    const float half_height = 0.5f * (float) (height ? height : 1);
+
+    return (clip_guard_band){
+        .guard_x = 1.0f + CLIP_GUARD_BAND_PIXELS / half_width,
+        .guard_y = 1.0f + CLIP_GUARD_BAND_PIXELS / half_height,
+    };
+}
+
+// Signed distance to a plane, >= 0 inside
+static inline float plane_distance(const uint32_t plane, const vec4 v, const clip_guard_band guard) {
+    switch (plane) {
+        case CLIP_PLANE_NEAR: return v[2] + v[3];
+        case CLIP_PLANE_RIGHT: return guard.guard_x * v[3] - v[0];
+        case CLIP_PLANE_LEFT: return guard.guard_x * v[3] + v[0];
+        case CLIP_PLANE_TOP: return guard.guard_y * v[3] - v[1];
+        case CLIP_PLANE_BOTTOM:
+        default: return guard.guard_y * v[3] + v[1];
+    }
+}
+
+uint32_t clip_stage_codes(const vec4 position, const clip_guard_band guard) {
+    uint32_t code = 0;
+    for (uint32_t plane = 1; plane < 1u << CLIP_PLANE_COUNT; plane <<= 1) {
+        if (plane_distance(plane, position, guard) < 0.0f) {
+            code |= plane;
+        }
+    }
+
+    return code;
+}
+
+static inline void lerp_vertex(const clip_vertex *a, const clip_vertex *b, const float t,
+                               const uint32_t attribute_count, clip_vertex *out) {
+    glm_vec4_lerp((float *) a->position, (float *) b->position, t, out->position);
+    for (uint32_t i = 0; i < attribute_count; ++i) {
+        out->attributes[i] = a->attributes[i] + t * (b->attributes[i] - a->attributes[i]);
+    }
+}
+
+uint32_t clip_stage_polygon(const clip_vertex triangle[3], const uint32_t plane_mask, const clip_guard_band guard,
+                            const uint32_t attribute_count, clip_vertex out[CLIP_MAX_POLYGON_VERTICES]) {
+    PROFILE_FINE_ZONE(clip_polygon_tracy, "ClipPolygon");
+
+    clip_vertex scratch[CLIP_MAX_POLYGON_VERTICES];
+    clip_vertex *src = out;
+    clip_vertex *dst = scratch;
+
+    src[0] = triangle[0];
+    src[1] = triangle[1];
+    src[2] = triangle[2];
+    uint32_t count = 3;
+
+    // Near goes first: after it every vertex has w > 0, which the guard band planes rely on
+    for (uint32_t plane = 1; plane < 1u << CLIP_PLANE_COUNT && count > 0; plane <<= 1) {
+        if (!(plane_mask & plane)) {
+            continue;
+        }
+
+        uint32_t out_count = 0;
+        const clip_vertex *prev = &src[count - 1];
+        float prev_distance = plane_distance(plane, prev->position, guard);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            const clip_vertex *curr = &src[i];
+            const float curr_distance = plane_distance(plane, curr->position, guard);
+
+            if ((prev_distance >= 0.0f) != (curr_distance >= 0.0f)) {
+                // The edge crosses the plane: emit the intersection
+                const float t = prev_distance / (prev_distance - curr_distance);
+                lerp_vertex(prev, curr, t, attribute_count, &dst[out_count++]);
+            }
+            if (curr_distance >= 0.0f) {
+                dst[out_count++] = *curr;
+            }
+
+            prev = curr;
+            prev_distance = curr_distance;
+        }
+
+        clip_vertex *swap = src;
+        src = dst;
+        dst = swap;
+        count = out_count;
+    }
+
+    if (src != out) {
+        for (uint32_t i = 0; i < count; ++i) {
+            out[i] = src[i];
+        }
+    }
+
+    PROFILE_FINE_ZONE_END(clip_polygon_tracy);
+    return count;
+}
+
+bool clip_stage_line_near(vec4 a, vec4 b) {
+    const float da = a[2] + a[3];
+    const float db = b[2] + b[3];
+
+    if (da < 0.0f && db < 0.0f) {
+        return false;
+    }
+    if (da < 0.0f) {
+        glm_vec4_lerp(a, b, da / (da - db), a);
+    } else if (db < 0.0f) {
+        glm_vec4_lerp(b, a, db / (db - da), b);
+    }
+
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef MYC23PROJECT_CLIP_STAGE_H
+#define MYC23PROJECT_CLIP_STAGE_H
+
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+
+// Planes the clipper knows about, all in homogeneous clip space. The x/y planes are the guard
+// band, not the viewport: triangles that poke out of the screen are left to the rasterizer's
+// AABB clamp, and only clipped once they get far enough away to threaten the edge math.
+#define CLIP_PLANE_NEAR   1  // z >= -w
+#define CLIP_PLANE_RIGHT  2  // x <= guard_x * w
+#define CLIP_PLANE_LEFT   4  // x >= -guard_x * w
+#define CLIP_PLANE_TOP    8  // y <= guard_y * w
+#define CLIP_PLANE_BOTTOM 16 // y >= -guard_y * w
+#define CLIP_PLANE_COUNT  5
+
+// A triangle clipped against every plane gains at most one vertex per plane
+#define CLIP_MAX_POLYGON_VERTICES (3 + CLIP_PLANE_COUNT)
+
+// Guard band half-extent in pixels beyond each screen edge. The rasterizer snaps vertices to
+// int32 28.4 fixed point (|coordinate| < 2^27 pixels) and evaluates edge functions in int64 once
+// per Hi-Z block, but steps them in int32 inside a block: an edge straddling an 8x8 block is
+// within about 16 * (|dx| + |dy|) * 16 of zero there, which stays in int32 while an edge spans
+// less than 2^19 pixels on each axis. A guard band this size keeps edges far below that.
+#define CLIP_GUARD_BAND_PIXELS 8192.0f
+
+// Per-vertex attributes carried through clipping. Matches RASTER_MAX_ATTRIBUTES.
+#define CLIP_MAX_ATTRIBUTES 8
+
+typedef struct {
+    vec4 position; // Clip space
+    float attributes[CLIP_MAX_ATTRIBUTES]; // Only the first attribute_count are used
+} clip_vertex;
+
+typedef struct {
+    float guard_x; // Guard band as a multiple of w, 1 = exactly the viewport
+    float guard_y;
+} clip_guard_band;
+
+clip_guard_band clip_stage_guard_band(uint32_t width, uint32_t height);
+
+// CLIP_PLANE_* bits of the planes the vertex is outside of
+uint32_t clip_stage_codes(const vec4 position, clip_guard_band guard);
+
+// Sutherland-Hodgman against every plane in plane_mask. Returns the vertex count of the
+// resulting convex polygon (0 when fully clipped away); triangulate it as a fan. New vertices
+// interpolate the first attribute_count attributes linearly in clip space, which is what
+// keeps them perspective-correct after the divide.
+uint32_t clip_stage_polygon(const clip_vertex triangle[3], uint32_t plane_mask, clip_guard_band guard,
+                            uint32_t attribute_count, clip_vertex out[CLIP_MAX_POLYGON_VERTICES]);
+
+// Clips the segment a-b against the near plane in place. Returns false when nothing is left.
+bool clip_stage_line_near(vec4 a, vec4 b);
+
+#endif //MYC23PROJECT_CLIP_STAGE_H
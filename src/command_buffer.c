@@ -0,0 +1,299 @@
+#include "command_buffer.h"
+
+#include <stdlib.h>
+
+#include "tracy/TracyC.h"
+
+static bool reserve_commands(command_buffer *restrict cb, const uint32_t needed) {
+    if (needed <= cb->capacity) {
+        return true;
+    }
+
+    uint32_t new_capacity = cb->capacity ? cb->capacity : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    draw_command *grown = realloc(cb->commands, sizeof(draw_command) * new_capacity);
+    if (!grown) {
+        return false;
+    }
+    if (cb->commands) {
+        TracyCFree(cb->commands);
+    }
+    TracyCAlloc(grown, sizeof(draw_command) * new_capacity);
+
+    cb->commands = grown;
+    cb->capacity = new_capacity;
+    return true;
+}
+
+// Keys and order are double length: the radix sort ping-pongs between the two halves.
+static bool reserve_sort(command_buffer *restrict cb) {
+    if (cb->count <= cb->sort_capacity) {
+        return true;
+    }
+
+    if (cb->keys) {
+        TracyCFree(cb->keys);
+        TracyCFree(cb->order);
+    }
+    free(cb->keys);
+    free(cb->order);
+
+    cb->sort_capacity = cb->capacity;
+    cb->keys = malloc(sizeof(uint64_t) * 2 * cb->sort_capacity);
+    cb->order = malloc(sizeof(uint32_t) * 2 * cb->sort_capacity);
+    if (!cb->keys || !cb->order) {
+        free(cb->keys);
+        free(cb->order);
+        cb->keys = 0;
+        cb->order = 0;
+        cb->sort_capacity = 0;
+        return false;
+    }
+    TracyCAlloc(cb->keys, sizeof(uint64_t) * 2 * cb->sort_capacity);
+    TracyCAlloc(cb->order, sizeof(uint32_t) * 2 * cb->sort_capacity);
+    return true;
+}
+
+static bool reserve_merged(command_buffer *restrict cb, const uint32_t instance_count) {
+    if (instance_count <= cb->merged_capacity) {
+        return true;
+    }
+
+    if (cb->merged) {
+        TracyCFree(cb->merged);
+        free(cb->merged);
+    }
+
+    cb->merged_capacity = cb->sort_capacity;
+    cb->merged = malloc(sizeof(float) * 10 * cb->merged_capacity);
+    if (!cb->merged) {
+        cb->merged_capacity = 0;
+        return false;
+    }
+    TracyCAlloc(cb->merged, sizeof(float) * 10 * cb->merged_capacity);
+    return true;
+}
+
+void command_buffer_free(command_buffer *cb) {
+    if (cb->commands) {
+        TracyCFree(cb->commands);
+        free(cb->commands);
+    }
+    if (cb->keys) {
+        TracyCFree(cb->keys);
+        TracyCFree(cb->order);
+        free(cb->keys);
+        free(cb->order);
+    }
+    if (cb->merged) {
+        TracyCFree(cb->merged);
+        free(cb->merged);
+    }
+
+    *cb = (command_buffer){0};
+}
+
+void command_buffer_draw(command_buffer *restrict cb, const render_pipeline pipeline, const uint16_t material,
+                         const model *mesh, vec3 pos, versor rot, vec3 scale) {
+    if (!reserve_commands(cb, cb->count + 1)) {
+        return;
+    }
+
+    draw_command *cmd = &cb->commands[cb->count++];
+    *cmd = (draw_command){
+        .mesh = mesh,
+        .pipeline = pipeline,
+        .material = material,
+    };
+    glm_quat_copy(rot, cmd->rotation);
+    glm_vec3_copy(pos, cmd->position);
+    glm_vec3_copy(scale, cmd->scale);
+}
+
+void command_buffer_draw_instanced(command_buffer *restrict cb, const uint16_t material, const model *mesh,
+                                   const instance_data *instances, const uint32_t instance_count) {
+    if (instance_count == 0 || !reserve_commands(cb, cb->count + 1)) {
+        return;
+    }
+
+    cb->commands[cb->count++] = (draw_command){
+        .mesh = mesh,
+        .instances = instances,
+        .instance_count = instance_count,
+        .pipeline = RENDER_PIPELINE_RASTER,
+        .material = material,
+    };
+}
+
+// View depth quantized to DRAW_KEY_DEPTH_BITS. The clip w of a point is its distance along the
+// view axis, so only the last row of PV is needed.
+static inline uint64_t quantize_depth(const mat4 pv, const float inv_far, const float x, const float y,
+                                      const float z) {
+    const float w = pv[0][3] * x + pv[1][3] * y + pv[2][3] * z + pv[3][3];
+    const float t = glm_clamp(w * inv_far, 0.0f, 1.0f);
+    return (uint64_t) (t * (float) ((1u << DRAW_KEY_DEPTH_BITS) - 1));
+}
+
+static uint64_t make_key(const draw_command *restrict cmd, const mat4 pv, const float inv_far) {
+    uint64_t depth;
+    if (cmd->instances) {
+        // Nearest instance, so the draw is not queued behind things it covers
+        const instance_data *in = cmd->instances;
+        depth = UINT64_MAX;
+        for (uint32_t i = 0; i < cmd->instance_count; ++i) {
+            const uint64_t d = quantize_depth(pv, inv_far, in->position_x[i], in->position_y[i], in->position_z[i]);
+            depth = d < depth ? d : depth;
+        }
+    } else {
+        depth = quantize_depth(pv, inv_far, cmd->position[0], cmd->position[1], cmd->position[2]);
+    }
+
+    return (uint64_t) cmd->pipeline << DRAW_KEY_PIPELINE_SHIFT |
+           depth << DRAW_KEY_DEPTH_SHIFT |
+           (uint64_t) cmd->material << DRAW_KEY_MATERIAL_SHIFT;
+}
+
+// LSD radix sort of (key, index) pairs, 8 bits per pass. Stable, so draws with equal keys keep
+// their recording order. Passes where every key has the same digit are skipped, which drops
+// the always-zero low bits of the key for free. Returns the half of the scratch holding the result.
+static uint32_t *radix_sort(uint64_t *restrict keys, uint32_t *restrict order, const uint32_t count,
+                            const uint32_t capacity) {
+    uint64_t *src_keys = keys, *dst_keys = keys + capacity;
+    uint32_t *src_order = order, *dst_order = order + capacity;
+
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        uint32_t histogram[256] = {0};
+        for (uint32_t i = 0; i < count; ++i) {
+            histogram[(src_keys[i] >> shift) & 0xFF]++;
+        }
+        if (histogram[(src_keys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t b = 0; b < 256; ++b) {
+            const uint32_t bucket = histogram[b];
+            histogram[b] = offset;
+            offset += bucket;
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t dst = histogram[(src_keys[i] >> shift) & 0xFF]++;
+            dst_keys[dst] = src_keys[i];
+            dst_order[dst] = src_order[i];
+        }
+
+        uint64_t *swap_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = swap_keys;
+        uint32_t *swap_order = src_order;
+        src_order = dst_order;
+        dst_order = swap_order;
+    }
+
+    return src_order;
+}
+
+static bool can_merge(const draw_command *restrict a, const draw_command *restrict b) {
+    return a->pipeline == RENDER_PIPELINE_RASTER && b->pipeline == RENDER_PIPELINE_RASTER &&
+           !a->instances && !b->instances && a->mesh == b->mesh && a->material == b->material;
+}
+
+// Draws commands [first, first + count) of the sorted order as one instanced draw.
+static void execute_merged(command_buffer *restrict cb, const uint32_t *restrict sorted, const uint32_t first,
+                           const uint32_t count, camera *restrict cam, graphics_buffer *restrict buff) {
+    float *restrict c = cb->merged;
+    for (uint32_t i = 0; i < count; ++i) {
+        const draw_command *cmd = &cb->commands[sorted[first + i]];
+        c[i] = cmd->position[0];
+        c[count + i] = cmd->position[1];
+        c[count * 2 + i] = cmd->position[2];
+        c[count * 3 + i] = cmd->rotation[0];
+        c[count * 4 + i] = cmd->rotation[1];
+        c[count * 5 + i] = cmd->rotation[2];
+        c[count * 6 + i] = cmd->rotation[3];
+        c[count * 7 + i] = cmd->scale[0];
+        c[count * 8 + i] = cmd->scale[1];
+        c[count * 9 + i] = cmd->scale[2];
+    }
+
+    const instance_data instances = {
+        c, c + count, c + count * 2,
+        c + count * 3, c + count * 4, c + count * 5, c + count * 6,
+        c + count * 7, c + count * 8, c + count * 9,
+    };
+    render_obj_raster_instanced(cb->commands[sorted[first]].mesh, &instances, count, cam, buff);
+}
+
+static void execute(draw_command *restrict cmd, camera *restrict cam, graphics_buffer *restrict buff) {
+    if (cmd->instances) {
+        render_obj_raster_instanced(cmd->mesh, cmd->instances, cmd->instance_count, cam, buff);
+        return;
+    }
+
+    switch (cmd->pipeline) {
+        case RENDER_PIPELINE_RASTER:
+            render_obj_raster(*cmd->mesh, cmd->position, cmd->rotation, cmd->scale, cam, buff);
+            break;
+        case RENDER_PIPELINE_OUTLINE:
+            render_obj(*cmd->mesh, cmd->position, cmd->rotation, cmd->scale, cam, buff);
+            break;
+        case RENDER_PIPELINE_WIRE:
+            render_obj_wire(*cmd->mesh, cmd->position, cmd->rotation, cmd->scale, cam, buff);
+            break;
+    }
+}
+
+void command_buffer_submit(command_buffer *restrict cb, camera *restrict cam, graphics_buffer *restrict buff) {
+    TracyCZone(command_submit_tracy, true);
+
+    if (cb->count == 0 || !reserve_sort(cb)) {
+        cb->count = 0;
+        TracyCZoneEnd(command_submit_tracy);
+        return;
+    }
+
+    TracyCZoneN(stage_sort, "SortDraws", true);
+    mat4 pv;
+    glm_mat4_copy(*(mat4 *) camera_get_pv_matrix(cam), pv);
+    const float inv_far = 1.0f / cam->far_clip;
+    for (uint32_t i = 0; i < cb->count; ++i) {
+        cb->keys[i] = make_key(&cb->commands[i], pv, inv_far);
+        cb->order[i] = i;
+    }
+    const uint32_t *sorted = radix_sort(cb->keys, cb->order, cb->count, cb->sort_capacity);
+    TracyCZoneEnd(stage_sort);
+
+    TracyCZoneN(stage_execute, "ExecuteDraws", true);
+    bool tiles_flushed = false;
+    for (uint32_t i = 0; i < cb->count;) {
+        draw_command *cmd = &cb->commands[sorted[i]];
+
+        // Sorted by pipeline: every RASTER command is binned by now
+        if (cmd->pipeline != RENDER_PIPELINE_RASTER && !tiles_flushed) {
+            renderer_flush_tiles(buff);
+            tiles_flushed = true;
+        }
+
+        uint32_t run = 1;
+        while (i + run < cb->count && can_merge(cmd, &cb->commands[sorted[i + run]])) {
+            ++run;
+        }
+
+        if (run > 1 && reserve_merged(cb, run)) {
+            execute_merged(cb, sorted, i, run, cam, buff);
+        } else {
+            for (uint32_t k = 0; k < run; ++k) {
+                execute(&cb->commands[sorted[i + k]], cam, buff);
+            }
+        }
+        i += run;
+    }
+    TracyCZoneEnd(stage_execute);
+
+    cb->count = 0;
+    TracyCZoneEnd(command_submit_tracy);
+}
@@ -0,0 +1,68 @@
+#ifndef MYC23PROJECT_COMMAND_BUFFER_H
+#define MYC23PROJECT_COMMAND_BUFFER_H
+
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "renderer.h"
+
+// Which render_obj* entry point a command is executed with. Also the most significant part
+// of the sort key, so filled geometry goes first and fills the depth buffer. Lines are drawn
+// straight into the framebuffer, so submit rasterizes the binned tiles before the first of them.
+typedef enum {
+    RENDER_PIPELINE_RASTER, // render_obj_raster / render_obj_raster_instanced
+    RENDER_PIPELINE_OUTLINE, // render_obj
+    RENDER_PIPELINE_WIRE, // render_obj_wire
+} render_pipeline;
+
+// Sort key layout, most significant first:
+// [63..60] pipeline | [59..36] view depth, near to far | [35..20] material | [19..0] unused
+#define DRAW_KEY_PIPELINE_SHIFT 60
+#define DRAW_KEY_DEPTH_SHIFT 36
+#define DRAW_KEY_DEPTH_BITS 24
+#define DRAW_KEY_MATERIAL_SHIFT 20
+
+// One recorded draw. Models and instance arrays are referenced, not copied, and must stay
+// alive until command_buffer_submit.
+typedef struct {
+    versor rotation;
+    vec3 position;
+    vec3 scale;
+    const model *mesh;
+    const instance_data *instances; // Set for instanced draws, position/rotation/scale unused
+    uint32_t instance_count;
+    render_pipeline pipeline;
+    uint16_t material;
+} draw_command;
+
+// Draws recorded during a frame. Recording needs no camera or framebuffer, so it can happen on
+// a different thread from submission; keys are built when the frame is submitted.
+typedef struct {
+    draw_command *commands;
+    uint32_t count;
+    uint32_t capacity;
+
+    // Sort scratch, sized with the commands
+    uint64_t *keys;
+    uint32_t *order;
+    uint32_t sort_capacity;
+
+    // Instance arrays for merged raster draws, 10 components per instance
+    float *merged;
+    uint32_t merged_capacity;
+} command_buffer;
+
+void command_buffer_draw(command_buffer *restrict cb, render_pipeline pipeline, uint16_t material,
+                         const model *mesh, vec3 pos, versor rot, vec3 scale);
+
+// Always uses RENDER_PIPELINE_RASTER. Sorted by its nearest instance.
+void command_buffer_draw_instanced(command_buffer *restrict cb, uint16_t material, const model *mesh,
+                                   const instance_data *instances, uint32_t instance_count);
+
+// Sorts the recorded draws by key and executes them in one pass, then empties the buffer.
+// Consecutive raster draws of the same model are merged into a single instanced draw.
+void command_buffer_submit(command_buffer *restrict cb, camera *restrict cam, graphics_buffer *restrict buff);
+
+void command_buffer_free(command_buffer *cb);
+
+#endif //MYC23PROJECT_COMMAND_BUFFER_H
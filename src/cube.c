@@ -0,0 +1,50 @@
+#include "cube.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracy/TracyC.h"
+
+void init_cube_mesh(model *cube_model) {
+    TracyCZone(init_cube_mesh, true);
+
+    constexpr uint32_t UNIQUE_VERTEX_COUNT = 8;
+    const vec4 unique_vertices[UNIQUE_VERTEX_COUNT] = {
+        {-0.5f, -0.5f, 0.5f, 1.0f}, {0.5f, -0.5f, 0.5f, 1.0f}, {0.5f, 0.5f, 0.5f, 1.0f}, {-0.5f, 0.5f, 0.5f, 1.0f},
+        {-0.5f, -0.5f, -0.5f, 1.0f}, {0.5f, -0.5f, -0.5f, 1.0f}, {0.5f, 0.5f, -0.5f, 1.0f}, {-0.5f, 0.5f, -0.5f, 1.0f}
+    };
+    constexpr uint32_t CUBE_INDEX_COUNT = 36;
+    const uint32_t cube_indices[CUBE_INDEX_COUNT] = {
+        0, 2, 1, 0, 3, 2, 5, 7, 4, 5, 6, 7, 4, 3, 0, 4, 7, 3,
+        5, 2, 6, 5, 1, 2, 3, 6, 2, 3, 7, 6, 0, 1, 5, 0, 5, 4
+    };
+
+    *cube_model = (model){0};
+    cube_model->vertex_count = UNIQUE_VERTEX_COUNT;
+    cube_model->index_count = CUBE_INDEX_COUNT;
+    cube_model->vertices = malloc(sizeof(vec4) * UNIQUE_VERTEX_COUNT);
+    cube_model->indices = malloc(sizeof(uint32_t) * CUBE_INDEX_COUNT);
+    TracyCAlloc(cube_model->vertices, sizeof(vec4) * UNIQUE_VERTEX_COUNT);
+    TracyCAlloc(cube_model->indices, sizeof(uint32_t) * CUBE_INDEX_COUNT);
+    memcpy(cube_model->vertices, unique_vertices, sizeof(vec4) * UNIQUE_VERTEX_COUNT);
+    memcpy(cube_model->indices, cube_indices, sizeof(uint32_t) * CUBE_INDEX_COUNT);
+
+    // Call the pre-processing function
+    model_build_unique_edges(cube_model);
+    model_build_bounds(cube_model);
+
+    TracyCZoneEnd(init_cube_mesh);
+}
+
+void init_camera_for_cube(camera *cam, float window_width, float window_height) {
+    constexpr vec3 cam_pos = {5.0f, 5.0f, 5.0f};
+    memcpy(cam->position, cam_pos, sizeof(vec3));
+    glm_quat_forp(cam_pos, GLM_VEC3_ZERO, ((vec3){0.0f, 0.0f, 1.0f}), cam->rotation);
+
+    cam->FOV = 45.0f;
+    cam->aspect = window_width / window_height;
+    cam->near_clip = 0.1f;
+    cam->far_clip = 100.0f;
+    cam->projection_is_dirty = true;
+    cam->view_is_dirty = true;
+}
@@ -0,0 +1,11 @@
+#ifndef MYC23PROJECT_CUBE_H
+#define MYC23PROJECT_CUBE_H
+
+#include "renderer.h"
+
+// Shared demo content, used by every platform layer so they all render the same scene.
+void init_cube_mesh(model *cube_model);
+
+void init_camera_for_cube(camera *cam, float window_width, float window_height);
+
+#endif //MYC23PROJECT_CUBE_H
@@ -0,0 +1,167 @@
+#include "instance_stage.h"
+
+#include <math.h>
+
+#include "simde/x86/avx2.h"
+#include "tracy/TracyC.h"
+
+void instance_stage_model_bounds(const model *restrict m, vec4 dest) {
+    if (m->has_bounds) {
+        glm_vec4_copy((float *) m->bounds, dest);
+        return;
+    }
+    if (m->vertex_count == 0) {
+        glm_vec4_zero(dest);
+        return;
+    }
+
+    // Center of the AABB, then the farthest vertex from it. Not minimal, but tight enough for
+    // culling and a single extra pass over the vertices.
+    vec3 lo, hi;
+    glm_vec3_copy(m->vertices[0], lo);
+    glm_vec3_copy(m->vertices[0], hi);
+    for (uint32_t i = 1; i < m->vertex_count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = fminf(lo[k], m->vertices[i][k]);
+            hi[k] = fmaxf(hi[k], m->vertices[i][k]);
+        }
+    }
+
+    vec3 center;
+    glm_vec3_center(lo, hi, center);
+
+    float radius_sq = 0.0f;
+    for (uint32_t i = 0; i < m->vertex_count; ++i) {
+        radius_sq = fmaxf(radius_sq, glm_vec3_distance2(center, m->vertices[i]));
+    }
+
+    dest[0] = center[0];
+    dest[1] = center[1];
+    dest[2] = center[2];
+    dest[3] = sqrtf(radius_sq);
+}
+
+// Loads 8 instance values starting at first. A partial batch is padded with pad so the
+// unused lanes hold a harmless transform.
+static inline simde__m256 load_lanes(const float *restrict values, const uint32_t first, const uint32_t count,
+                                     const float pad) {
+    if (count == INSTANCE_STAGE_BATCH_SIZE) {
+        return simde_mm256_loadu_ps(values + first);
+    }
+
+    float lanes[INSTANCE_STAGE_BATCH_SIZE];
+    for (uint32_t i = 0; i < INSTANCE_STAGE_BATCH_SIZE; ++i) {
+        lanes[i] = i < count ? values[first + i] : pad;
+    }
+    return simde_mm256_loadu_ps(lanes);
+}
+
+static inline simde__m256 madd(const simde__m256 a, const simde__m256 b, const simde__m256 c) {
+    return simde_mm256_add_ps(simde_mm256_mul_ps(a, b), c);
+}
+
+static inline simde__m256 abs_ps(const simde__m256 a) {
+    return simde_mm256_andnot_ps(simde_mm256_set1_ps(-0.0f), a);
+}
+
+void instance_stage_batch(const mat4 pv, const vec4 planes[6], const vec4 bounds,
+                          const instance_data *restrict instances, const uint32_t first, const uint32_t count,
+                          instance_batch *restrict out) {
+    TracyCZoneN(instance_batch_tracy, "InstanceBatch", true);
+
+    const simde__m256 px = load_lanes(instances->position_x, first, count, 0.0f);
+    const simde__m256 py = load_lanes(instances->position_y, first, count, 0.0f);
+    const simde__m256 pz = load_lanes(instances->position_z, first, count, 0.0f);
+    const simde__m256 qx = load_lanes(instances->rotation_x, first, count, 0.0f);
+    const simde__m256 qy = load_lanes(instances->rotation_y, first, count, 0.0f);
+    const simde__m256 qz = load_lanes(instances->rotation_z, first, count, 0.0f);
+    const simde__m256 qw = load_lanes(instances->rotation_w, first, count, 1.0f);
+    const simde__m256 sx = load_lanes(instances->scale_x, first, count, 1.0f);
+    const simde__m256 sy = load_lanes(instances->scale_y, first, count, 1.0f);
+    const simde__m256 sz = load_lanes(instances->scale_z, first, count, 1.0f);
+
+    // --- Model matrix, T * R * S ---
+    // Same rotation as glm_quat_mat4, with s = 2 / |q|^2 so slightly denormalized
+    // quaternions still give a pure rotation.
+    const simde__m256 one = simde_mm256_set1_ps(1.0f);
+    const simde__m256 norm_sq = madd(qx, qx, madd(qy, qy, madd(qz, qz, simde_mm256_mul_ps(qw, qw))));
+    const simde__m256 s = simde_mm256_div_ps(simde_mm256_set1_ps(2.0f), norm_sq);
+
+    const simde__m256 xs = simde_mm256_mul_ps(qx, s);
+    const simde__m256 ys = simde_mm256_mul_ps(qy, s);
+    const simde__m256 zs = simde_mm256_mul_ps(qz, s);
+    const simde__m256 xx = simde_mm256_mul_ps(qx, xs), yy = simde_mm256_mul_ps(qy, ys);
+    const simde__m256 zz = simde_mm256_mul_ps(qz, zs), xy = simde_mm256_mul_ps(qx, ys);
+    const simde__m256 yz = simde_mm256_mul_ps(qy, zs), xz = simde_mm256_mul_ps(qx, zs);
+    const simde__m256 wx = simde_mm256_mul_ps(qw, xs), wy = simde_mm256_mul_ps(qw, ys);
+    const simde__m256 wz = simde_mm256_mul_ps(qw, zs);
+
+    // model[c][r] for the upper 3x3, columns scaled by the matching scale component
+    simde__m256 model[3][3];
+    model[0][0] = simde_mm256_mul_ps(simde_mm256_sub_ps(one, simde_mm256_add_ps(yy, zz)), sx);
+    model[0][1] = simde_mm256_mul_ps(simde_mm256_add_ps(xy, wz), sx);
+    model[0][2] = simde_mm256_mul_ps(simde_mm256_sub_ps(xz, wy), sx);
+    model[1][0] = simde_mm256_mul_ps(simde_mm256_sub_ps(xy, wz), sy);
+    model[1][1] = simde_mm256_mul_ps(simde_mm256_sub_ps(one, simde_mm256_add_ps(xx, zz)), sy);
+    model[1][2] = simde_mm256_mul_ps(simde_mm256_add_ps(yz, wx), sy);
+    model[2][0] = simde_mm256_mul_ps(simde_mm256_add_ps(xz, wy), sz);
+    model[2][1] = simde_mm256_mul_ps(simde_mm256_sub_ps(yz, wx), sz);
+    model[2][2] = simde_mm256_mul_ps(simde_mm256_sub_ps(one, simde_mm256_add_ps(xx, yy)), sz);
+    const simde__m256 translation[3] = {px, py, pz};
+
+    // --- Bounding sphere cull ---
+    // World center is model * (center, 1); the radius grows with the largest scale axis.
+    simde__m256 center[3];
+    for (int r = 0; r < 3; ++r) {
+        center[r] = madd(model[0][r], simde_mm256_set1_ps(bounds[0]),
+                         madd(model[1][r], simde_mm256_set1_ps(bounds[1]),
+                              madd(model[2][r], simde_mm256_set1_ps(bounds[2]), translation[r])));
+    }
+    const simde__m256 max_scale = simde_mm256_max_ps(abs_ps(sx), simde_mm256_max_ps(abs_ps(sy), abs_ps(sz)));
+    const simde__m256 neg_radius = simde_mm256_mul_ps(max_scale, simde_mm256_set1_ps(-bounds[3]));
+
+    simde__m256 outside = simde_mm256_setzero_ps();
+    for (int p = 0; p < 6; ++p) {
+        const simde__m256 distance = madd(center[0], simde_mm256_set1_ps(planes[p][0]),
+                                          madd(center[1], simde_mm256_set1_ps(planes[p][1]),
+                                               madd(center[2], simde_mm256_set1_ps(planes[p][2]),
+                                                    simde_mm256_set1_ps(planes[p][3]))));
+        outside = simde_mm256_or_ps(outside, simde_mm256_cmp_ps(distance, neg_radius, SIMDE_CMP_LT_OQ));
+    }
+
+    const uint32_t lane_mask = (1u << count) - 1u;
+    out->visible_mask = ~(uint32_t) simde_mm256_movemask_ps(outside) & lane_mask;
+    if (out->visible_mask == 0) {
+        TracyCZoneEnd(instance_batch_tracy);
+        return;
+    }
+
+    // --- MVP = PV * model ---
+    // The model matrix's last row is (0, 0, 0, 1), so the upper columns only need 3 terms.
+    float mvp[4][4][INSTANCE_STAGE_BATCH_SIZE];
+    for (int r = 0; r < 4; ++r) {
+        const simde__m256 pv0 = simde_mm256_set1_ps(pv[0][r]);
+        const simde__m256 pv1 = simde_mm256_set1_ps(pv[1][r]);
+        const simde__m256 pv2 = simde_mm256_set1_ps(pv[2][r]);
+        for (int c = 0; c < 3; ++c) {
+            simde_mm256_storeu_ps(mvp[c][r], madd(pv0, model[c][0],
+                                                  madd(pv1, model[c][1], simde_mm256_mul_ps(pv2, model[c][2]))));
+        }
+        simde_mm256_storeu_ps(mvp[3][r], madd(pv0, px, madd(pv1, py, madd(pv2, pz, simde_mm256_set1_ps(pv[3][r])))));
+    }
+
+    // Transpose back to one mat4 per visible instance for vertex_stage_transform
+    for (uint32_t lane = 0; lane < count; ++lane) {
+        if (!(out->visible_mask & (1u << lane))) {
+            continue;
+        }
+
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                out->mvp[lane][c][r] = mvp[c][r][lane];
+            }
+        }
+    }
+
+    TracyCZoneEnd(instance_batch_tracy);
+}
@@ -0,0 +1,28 @@
+#ifndef MYC23PROJECT_INSTANCE_STAGE_H
+#define MYC23PROJECT_INSTANCE_STAGE_H
+
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "renderer.h"
+
+// Instances per instance_stage_batch call, one per SIMD lane.
+#define INSTANCE_STAGE_BATCH_SIZE 8
+
+typedef struct {
+    mat4 mvp[INSTANCE_STAGE_BATCH_SIZE]; // Only written for visible instances
+    uint32_t visible_mask; // Bit i set when instance first + i may be on screen
+} instance_batch;
+
+// Bounding sphere of the model's vertices in model space: center xyz, radius w. m->bounds when
+// the model has them, otherwise computed with a pass over the vertices.
+void instance_stage_model_bounds(const model *restrict m, vec4 dest);
+
+// Builds the MVPs of instances [first, first + count), count <= INSTANCE_STAGE_BATCH_SIZE,
+// 8 at a time, and tests their bounding spheres against the frustum planes of pv
+// (glm_frustum_planes order, normalized). Culled instances get no matrix.
+void instance_stage_batch(const mat4 pv, const vec4 planes[6], const vec4 bounds,
+                          const instance_data *restrict instances, uint32_t first, uint32_t count,
+                          instance_batch *restrict out);
+
+#endif //MYC23PROJECT_INSTANCE_STAGE_H
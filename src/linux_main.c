@@ -0,0 +1,776 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cglm/cglm.h"
+#include "renderer.h"
+#include "command_buffer.h"
+#include "cube.h"
+#include "instance_stage.h"
+#include "mesh_file.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "obj_import.h"
+#include "render_world.h"
+#include "scene.h"
+#include "swapchain.h"
+#include "texture.h"
+#include "linux_platform.h"
+#include "tracy/TracyC.h"
+
+typedef enum {
+    SHADING_FLAT,
+    SHADING_GOURAUD, // Vertex colors from the model-space position
+    SHADING_CHECKER, // Position attributes and a 3D checker shader
+    SHADING_TEXTURE, // UVs from the position, mipmapped bilinear texture
+    SHADING_TEXTURE_POINT, // Same, point sampled
+} shading;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_count;
+    uint32_t thread_count;
+    bool immediate; // Skip binning, fill triangles as they are submitted
+    raster_path path;
+    bool no_depth;
+    uint32_t dump_every; // 0 = only the last frame
+    const char *dump_prefix; // 0 = no dumps
+    bool use_hugepages;
+    uint32_t crowd_count; // 0 = the single bouncing cube
+    bool deferred; // Record into a command buffer and submit once per frame
+    const char *mesh_path; // 0 = the built-in cube
+    bool meshlets; // Cluster the mesh and cull whole meshlets before the vertex stage
+    bool lods; // Simplify the mesh and draw the level its screen size calls for
+    uint32_t scene_count; // 0 = no scene; otherwise a field of N objects culled through the BVH
+    bool occlusion; // With -s: add walls to the field and cull what they hide
+    shading shading;
+    bool wire; // Wireframe overlay of the single mesh, after the solid render
+    bool antialiased_lines;
+    bool full_clear; // Clear the whole frame instead of only the tiles drawn last frame
+    uint32_t image_count; // Swapchain images, 2 or 3
+    uint32_t entity_count; // 0 = no entities; otherwise N bouncing meshes run through render_world
+} headless_options;
+
+static void print_usage(const char *exe) {
+    fprintf(stderr,
+            "usage: %s [-w width] [-h height] [-n frames] [-t threads] [-i] [-p scalar|simd] [-Z] [-o ppm_prefix]\n"
+            "          [-e dump_every] [-H] [-c crowd_count] [-d] [-m mesh] [-C] [-L] [-s scene_count] [-O]\n"
+            "          [-g flat|gouraud|checker|texture|texture-point] [-W] [-A] [-F] [-B images] [-E entities]\n"
+            "  -w, -h   backbuffer resolution (default 1280x720)\n"
+            "  -n       number of frames to render (default 1000)\n"
+            "  -t       raster threads including the main thread (default: online CPUs)\n"
+            "  -i       immediate mode: no tile binning, single threaded\n"
+            "  -p       triangle fill inner loop (default simd)\n"
+            "  -Z       no depth buffer\n"
+            "  -o       write frames to <prefix>_<frame>.ppm\n"
+            "  -e       with -o, dump every Nth frame instead of only the last one\n"
+            "  -H       back the framebuffer with huge pages\n"
+            "  -c       draw a grid of N spinning cubes with one instanced call instead of the bouncing cube\n"
+            "  -d       record draws into a sorted command buffer; with -c, one command per cube\n"
+            "  -m       draw a .obj or a mesh_convert output instead of the cube, scaled to the cube's size\n"
+            "  -C       split the mesh into meshlets and cull them before the vertex stage\n"
+            "  -L       build simplified levels of the mesh and draw the coarsest whose error stays under\n"
+            "           a pixel, for the bouncing mesh, -s and -E\n"
+            "  -s       draw a field of N objects, mostly off-screen, through the scene BVH; 1 in 8 spin\n"
+            "  -O       with -s, add walls across the view and occlusion-cull the field behind them\n"
+            "  -g       interpolate per-vertex attributes: colors from the position, a checker shader, or\n"
+            "           a mipmapped test texture\n"
+            "  -W       overlay the mesh's wireframe on the bouncing mesh\n"
+            "  -A       antialiased (Wu) lines for -W\n"
+            "  -F       clear the whole frame every frame instead of tracking dirty tiles\n"
+            "  -B       swapchain images, 2 or 3 (default 3); frames are dumped on the present thread\n"
+            "  -E       simulate N bouncing copies of the mesh as flecs entities, moved, culled and recorded\n"
+            "           on -t flecs worker threads\n",
+            exe);
+}
+
+static bool parse_options(const int argc, char **argv, headless_options *options) {
+    *options = (headless_options){
+        .width = 1280,
+        .height = 720,
+        .frame_count = 1000,
+        .thread_count = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN),
+        .path = RASTER_PATH_SIMD,
+        .image_count = 3,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:h:n:t:ip:Zo:e:Hc:dm:CLs:Og:WAFB:E:")) != -1) {
+        switch (opt) {
+            case 'w': options->width = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'h': options->height = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'n': options->frame_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 't': options->thread_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'i': options->immediate = true;
+                break;
+            case 'p':
+                if (strcmp(optarg, "scalar") == 0) {
+                    options->path = RASTER_PATH_SCALAR;
+                } else if (strcmp(optarg, "simd") == 0) {
+                    options->path = RASTER_PATH_SIMD;
+                } else {
+                    return false;
+                }
+                break;
+            case 'Z': options->no_depth = true;
+                break;
+            case 'o': options->dump_prefix = optarg;
+                break;
+            case 'e': options->dump_every = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'H': options->use_hugepages = true;
+                break;
+            case 'c': options->crowd_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'd': options->deferred = true;
+                break;
+            case 'm': options->mesh_path = optarg;
+                break;
+            case 'C': options->meshlets = true;
+                break;
+            case 'L': options->lods = true;
+                break;
+            case 's': options->scene_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'O': options->occlusion = true;
+                break;
+            case 'W': options->wire = true;
+                break;
+            case 'A': options->antialiased_lines = true;
+                break;
+            case 'F': options->full_clear = true;
+                break;
+            case 'B': options->image_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'E': options->entity_count = (uint32_t) strtoul(optarg, 0, 10);
+                break;
+            case 'g':
+                if (strcmp(optarg, "flat") == 0) {
+                    options->shading = SHADING_FLAT;
+                } else if (strcmp(optarg, "gouraud") == 0) {
+                    options->shading = SHADING_GOURAUD;
+                } else if (strcmp(optarg, "checker") == 0) {
+                    options->shading = SHADING_CHECKER;
+                } else if (strcmp(optarg, "texture") == 0) {
+                    options->shading = SHADING_TEXTURE;
+                } else if (strcmp(optarg, "texture-point") == 0) {
+                    options->shading = SHADING_TEXTURE_POINT;
+                } else {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return options->width > 0 && options->height > 0;
+}
+
+// 3 attributes per vertex: the model-space position remapped to [0, 1] over the model's bounds.
+// Read as r, g, b by the Gouraud fill.
+static float *position_attributes(const model *m) {
+    float *attributes = malloc(sizeof(float) * 3 * m->vertex_count);
+    if (!attributes) {
+        return 0;
+    }
+    TracyCAlloc(attributes, sizeof(float) * 3 * m->vertex_count);
+
+    vec3 lo, hi;
+    glm_vec3_copy(m->vertices[0], lo);
+    glm_vec3_copy(m->vertices[0], hi);
+    for (uint32_t v = 1; v < m->vertex_count; ++v) {
+        glm_vec3_minv(lo, m->vertices[v], lo);
+        glm_vec3_maxv(hi, m->vertices[v], hi);
+    }
+    for (uint32_t v = 0; v < m->vertex_count; ++v) {
+        for (int a = 0; a < 3; ++a) {
+            const float extent = hi[a] - lo[a];
+            attributes[v * 3 + a] = extent > 0.0f ? (m->vertices[v][a] - lo[a]) / extent : 0.5f;
+        }
+    }
+    return attributes;
+}
+
+// 8 cells per axis over the [0, 1] position attributes, offset so that flat faces at 0 or 1
+// fall in the middle of a cell rather than on a border. Straight cell borders on screen are
+// what shows the interpolation is perspective-correct.
+static void checker_shader(const raster_fragments *restrict fragments, const uint32_t attribute_count,
+                           const void *user, uint32_t colors[8]) {
+    (void) attribute_count;
+    (void) user;
+    for (int lane = 0; lane < 8; ++lane) {
+        const int cell = (int) floorf(fragments->values[0][lane] * 7.5f + 0.25f) +
+                         (int) floorf(fragments->values[1][lane] * 7.5f + 0.25f) +
+                         (int) floorf(fragments->values[2][lane] * 7.5f + 0.25f);
+        colors[lane] = cell & 1 ? 0x00E0E0E0 : 0x00304080;
+    }
+}
+
+// 2 attributes per vertex from position_attributes, in place: UVs that tile the texture twice
+// across the model and are not constant on any axis-aligned face.
+static void position_to_uv(float *attributes, const uint32_t vertex_count) {
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        const float *p = attributes + v * 3;
+        const float uv[2] = {2.0f * (p[0] + p[2]), 2.0f * (p[1] + p[2])};
+        attributes[v * 2] = uv[0];
+        attributes[v * 2 + 1] = uv[1];
+    }
+}
+
+// 256x256: a coarse checker with a color ramp and a fine grid, which aliases visibly when
+// sampled without mips.
+#define TEST_TEXTURE_SIZE 256
+
+static bool make_test_texture(texture *t, const texture_filter filter) {
+    uint32_t *pixels = malloc(sizeof(uint32_t) * TEST_TEXTURE_SIZE * TEST_TEXTURE_SIZE);
+    if (!pixels) {
+        return false;
+    }
+    for (uint32_t y = 0; y < TEST_TEXTURE_SIZE; ++y) {
+        for (uint32_t x = 0; x < TEST_TEXTURE_SIZE; ++x) {
+            uint32_t color = ((x >> 5) ^ (y >> 5)) & 1 ? x << 16 | y << 8 | 0xC0 : 0x00202020;
+            if (x % 16 == 0 || y % 16 == 0) {
+                color = 0x00FFFFFF;
+            }
+            pixels[y * TEST_TEXTURE_SIZE + x] = color;
+        }
+    }
+    const bool ok = texture_init(t, pixels, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, filter);
+    free(pixels);
+    return ok;
+}
+
+static void texture_shader(const raster_fragments *restrict fragments, const uint32_t attribute_count,
+                           const void *user, uint32_t colors[8]) {
+    (void) attribute_count;
+    const texture *t = user;
+    const float lod = texture_lod(t, fragments->ddx[0], fragments->ddx[1], fragments->ddy[0], fragments->ddy[1]);
+    texture_sample(t, fragments->values[0], fragments->values[1], lod, colors);
+}
+
+// A cube grid around the origin for the instanced path, one array per component.
+typedef struct {
+    float *components; // Backing storage for every array below
+    float *position[3];
+    float *rotation[4];
+    float *scale[3];
+    uint32_t count;
+} crowd;
+
+static bool crowd_init(crowd *c, const uint32_t count, const float model_scale) {
+    *c = (crowd){.count = count};
+    c->components = malloc(sizeof(float) * count * 10);
+    if (!c->components) {
+        return false;
+    }
+
+    float *next = c->components;
+    for (int k = 0; k < 3; ++k, next += count) c->position[k] = next;
+    for (int k = 0; k < 4; ++k, next += count) c->rotation[k] = next;
+    for (int k = 0; k < 3; ++k, next += count) c->scale[k] = next;
+
+    const uint32_t side = (uint32_t) ceilf(cbrtf((float) count));
+    const float spacing = 6.0f / (float) side;
+    for (uint32_t i = 0; i < count; ++i) {
+        c->position[0][i] = ((float) (i % side) + 0.5f) * spacing - 3.0f;
+        c->position[1][i] = ((float) (i / side % side) + 0.5f) * spacing - 3.0f;
+        c->position[2][i] = ((float) (i / (side * side)) + 0.5f) * spacing - 3.0f;
+        for (int k = 0; k < 3; ++k) {
+            c->scale[k][i] = 0.5f * spacing * model_scale;
+        }
+    }
+    return true;
+}
+
+static void crowd_spin(const crowd *c, const float angle) {
+    for (uint32_t i = 0; i < c->count; ++i) {
+        versor q;
+        glm_quat(q, angle + (float) i * 0.1f, 0.3f, 1.0f, (float) (i % 5) * 0.2f);
+        for (int k = 0; k < 4; ++k) {
+            c->rotation[k][i] = q[k];
+        }
+    }
+}
+
+// A square field of objects in the plane below the cube, spaced so a large field reaches far
+// outside the view.
+static bool field_init(scene *s, const model *mesh, const uint32_t count, const float model_scale) {
+    const uint32_t mesh_id = scene_add_mesh(s, mesh);
+    if (mesh_id == SCENE_INVALID_ID) {
+        return false;
+    }
+
+    const uint32_t side = (uint32_t) ceilf(sqrtf((float) count));
+    const float spacing = 2.5f;
+    for (uint32_t i = 0; i < count; ++i) {
+        vec3 pos = {
+            ((float) (i % side) - 0.5f * (float) (side - 1)) * spacing,
+            ((float) (i / side) - 0.5f * (float) (side - 1)) * spacing,
+            -2.0f,
+        };
+        versor rot = GLM_QUAT_IDENTITY_INIT;
+        vec3 scale = {model_scale, model_scale, model_scale};
+        if (scene_add_object(s, mesh_id, pos, rot, scale) == SCENE_INVALID_ID) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Slabs across the view diagonal, facing the camera and wider with distance, marked as
+// occluders. Added after the field, so field object ids are unchanged.
+static bool field_add_walls(scene *s, const model *cube) {
+    const uint32_t mesh_id = scene_add_mesh(s, cube);
+    if (mesh_id == SCENE_INVALID_ID) {
+        return false;
+    }
+
+    const float distances[] = {-1.0f, -12.0f, -30.0f};
+    for (size_t i = 0; i < sizeof(distances) / sizeof(distances[0]); ++i) {
+        const float d = distances[i];
+        vec3 pos = {d, d, -1.0f};
+        versor rot;
+        glm_quat(rot, GLM_PI_4, 0.0f, 0.0f, 1.0f);
+        vec3 scale = {0.5f, 6.0f - 1.5f * d, 3.0f};
+        const uint32_t wall = scene_add_object(s, mesh_id, pos, rot, scale);
+        if (wall == SCENE_INVALID_ID) {
+            return false;
+        }
+        s->objects[wall].is_occluder = true;
+    }
+    return true;
+}
+
+// Spins every 8th of the first count objects, which refits only the BVH paths above them.
+static void field_spin(scene *s, const uint32_t count, const float angle) {
+    for (uint32_t i = 0; i < count; i += 8) {
+        scene_object *object = &s->objects[i];
+        versor rot;
+        glm_quat(rot, angle + (float) i * 0.1f, 0.3f, 1.0f, 0.5f);
+        scene_set_transform(s, i, object->position, rot, object->scale);
+    }
+}
+
+// count copies of the mesh scattered through the bounce box, each with its own velocity and
+// spin, from a fixed seed so runs are comparable
+static bool entities_init(render_world *w, const model *mesh, const uint32_t count, const float model_scale,
+                          const uint32_t thread_count) {
+    if (!render_world_init(w, thread_count)) {
+        return false;
+    }
+    w->bounce_extent = 3.0f;
+
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < count; ++i) {
+        float r[9];
+        for (int k = 0; k < 9; ++k) {
+            seed = seed * 1664525u + 1013904223u;
+            r[k] = (float) (seed >> 8) / (float) (1u << 24) * 2.0f - 1.0f;
+        }
+        vec3 pos = {r[0] * 3.0f, r[1] * 3.0f, r[2] * 3.0f};
+        vec3 linear = {r[3], r[4], r[5]};
+        vec3 angular = {r[6] * 2.0f, r[7] * 2.0f, r[8] * 2.0f};
+        const float s = 0.1f * model_scale;
+        render_world_spawn(w, mesh, pos, GLM_QUAT_IDENTITY, (vec3){s, s, s}, linear, angular);
+    }
+    return true;
+}
+
+// OBJ files are imported, anything else is mapped as a mesh_convert output
+static bool load_mesh(const char *path, mesh_file *mapped, model *imported) {
+    const size_t length = strlen(path);
+    if (length >= 4 && strcmp(path + length - 4, ".obj") == 0) {
+        return obj_import(path, imported);
+    }
+    return mesh_file_open(path, mapped);
+}
+
+static void dump_frame(const graphics_buffer *buffer, const char *prefix, const uint32_t frame) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s_%05u.ppm", prefix, frame);
+    if (!linux_write_ppm(buffer, path)) {
+        fprintf(stderr, "failed to write %s\n", path);
+    }
+}
+
+// The headless present: write the frame out if -o/-e ask for it
+static void present_frame(void *user, const graphics_buffer *image, const ivec4 *rects, const uint32_t rect_count,
+                          const uint64_t frame) {
+    (void) rects;
+    (void) rect_count;
+    const headless_options *options = user;
+    if (!options->dump_prefix) {
+        return;
+    }
+
+    const bool is_last = frame + 1 == options->frame_count;
+    if (is_last || (options->dump_every && frame % options->dump_every == 0)) {
+        dump_frame(image, options->dump_prefix, (uint32_t) frame);
+    }
+}
+
+static void add_stats(renderer_stats *total, const renderer_stats *frame) {
+    total->triangles_in += frame->triangles_in;
+    total->meshlets_culled += frame->meshlets_culled;
+    total->triangles_frustum_culled += frame->triangles_frustum_culled;
+    total->triangles_clipped += frame->triangles_clipped;
+    total->triangles_backface_culled += frame->triangles_backface_culled;
+    total->triangles_setup_culled += frame->triangles_setup_culled;
+    total->triangles_rasterized += frame->triangles_rasterized;
+    total->triangles_dropped += frame->triangles_dropped;
+    total->pixels_tested += frame->pixels_tested;
+    total->pixels_written += frame->pixels_written;
+    total->overdraw += frame->overdraw;
+}
+
+static void resize_image(graphics_buffer *image, const uint32_t width, const uint32_t height, void *user) {
+    const headless_options *options = user;
+    linux_resize_buffer(image, width, height, options->use_hugepages);
+}
+
+static void release_image(graphics_buffer *image, void *user) {
+    (void) user;
+    linux_free_buffer(image);
+}
+
+int main(const int argc, char **argv) {
+    TracyCZone(main_tracy, true);
+
+    headless_options options;
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // The first image is acquired up front, its size sets up depth, tiles and the camera
+    const swapchain_desc chain_desc = {
+        .image_count = options.image_count,
+        .width = options.width,
+        .height = options.height,
+        .track_dirty = !options.full_clear,
+        .resize_image = resize_image,
+        .release_image = release_image,
+        .present = present_frame,
+        .user = &options,
+    };
+    swapchain *chain = swapchain_create(&chain_desc);
+    if (!chain) {
+        fprintf(stderr, "failed to start the present thread\n");
+        return 1;
+    }
+    graphics_buffer backbuffer = {0};
+    swapchain_acquire(chain, &backbuffer);
+    if (!backbuffer.memory) {
+        fprintf(stderr, "failed to allocate a %ux%u backbuffer\n", options.width, options.height);
+        return 1;
+    }
+
+    renderer_set_raster_path(options.path);
+    if (!options.no_depth) {
+        renderer_depth_init(&backbuffer);
+    }
+    if (!options.immediate) {
+        renderer_tiles_init(&backbuffer);
+        renderer_set_thread_count(options.thread_count);
+    }
+
+    model my_cube;
+    init_cube_mesh(&my_cube);
+
+    // -m replaces the cube, rescaled so its bounding sphere matches the cube's
+    mesh_file mapped_mesh = {0};
+    model imported_mesh = {0};
+    model *mesh = &my_cube;
+    float mesh_scale = 1.0f;
+    vec3 mesh_offset = GLM_VEC3_ZERO_INIT;
+    if (options.mesh_path) {
+        const double load_start = linux_get_seconds();
+        if (!load_mesh(options.mesh_path, &mapped_mesh, &imported_mesh)) {
+            fprintf(stderr, "failed to load %s\n", options.mesh_path);
+            return 1;
+        }
+        mesh = mapped_mesh.mapping ? &mapped_mesh.mesh : &imported_mesh;
+        printf("loaded %s in %.3f s: %u vertices, %u triangles\n", options.mesh_path,
+               linux_get_seconds() - load_start, mesh->vertex_count, mesh->index_count / 3);
+
+        vec4 bounds;
+        instance_stage_model_bounds(mesh, bounds);
+        if (bounds[3] > 0.0f) {
+            mesh_scale = 0.866f / bounds[3];
+        }
+        glm_vec3_scale(bounds, -mesh_scale, mesh_offset);
+    }
+
+    // Before the meshlets, which copy the attributes
+    float *shading_attributes = 0;
+    if (options.shading != SHADING_FLAT && mesh->vertex_count) {
+        shading_attributes = position_attributes(mesh);
+        if (!shading_attributes) {
+            fprintf(stderr, "failed to allocate the vertex attributes\n");
+            return 1;
+        }
+        mesh->attributes = shading_attributes;
+        mesh->attribute_count = 3;
+        renderer_set_shader(options.shading == SHADING_CHECKER ? checker_shader : 0, 0);
+    }
+    texture test_texture = {0};
+    if (options.shading == SHADING_TEXTURE || options.shading == SHADING_TEXTURE_POINT) {
+        if (!make_test_texture(&test_texture, options.shading == SHADING_TEXTURE ? TEXTURE_FILTER_BILINEAR
+                                                                                   : TEXTURE_FILTER_POINT)) {
+            fprintf(stderr, "failed to create the test texture\n");
+            return 1;
+        }
+        position_to_uv(shading_attributes, mesh->vertex_count);
+        mesh->attribute_count = 2;
+        renderer_set_shader(texture_shader, &test_texture);
+    }
+
+    // Mapped meshes may come without edges; edges built here are freed with the mapping
+    model_edge *built_edges = 0;
+    if (options.wire && !mesh->edges) {
+        model_build_unique_edges(mesh);
+        built_edges = mapped_mesh.mapping ? mesh->edges : 0;
+    }
+    renderer_set_line_mode(options.antialiased_lines ? LINE_MODE_ANTIALIASED : LINE_MODE_ALIASED);
+
+    if (options.meshlets) {
+        const double build_start = linux_get_seconds();
+        if (!model_build_meshlets(mesh)) {
+            fprintf(stderr, "failed to build meshlets\n");
+            return 1;
+        }
+        printf("built %u meshlets in %.3f s: %u meshlet vertices for %u vertices\n", mesh->meshlets->meshlet_count,
+               linux_get_seconds() - build_start, mesh->meshlets->vertex_count, mesh->vertex_count);
+    }
+
+    // After the attributes and meshlets, which the levels get copies of
+    if (options.lods) {
+        const double build_start = linux_get_seconds();
+        if (!model_build_lods(mesh)) {
+            fprintf(stderr, "failed to build LODs\n");
+            return 1;
+        }
+        printf("built %u LOD levels in %.3f s:", mesh->lods->level_count, linux_get_seconds() - build_start);
+        for (uint32_t l = 0; l < mesh->lods->level_count; ++l) {
+            const model *level = model_lod(mesh, l);
+            printf(" %u/%u (%.2g)", level->index_count / 3, level->vertex_count, mesh->lods->errors[l] * mesh_scale);
+        }
+        printf(" triangles/vertices (error)\n");
+    }
+    uint32_t mesh_lod = 0;
+
+    mat4 cube_rot = GLM_MAT4_IDENTITY_INIT;
+
+    vec3 cube_pos = GLM_VEC3_ZERO_INIT;
+    vec3 velocity = {0.001f, 0.001f, 0.001f};
+
+    camera my_camera;
+    init_camera_for_cube(&my_camera, backbuffer.width, backbuffer.height);
+
+    command_buffer commands = {0};
+    crowd cubes = {0};
+    if (options.crowd_count && !crowd_init(&cubes, options.crowd_count, mesh_scale)) {
+        fprintf(stderr, "failed to allocate %u instances\n", options.crowd_count);
+        return 1;
+    }
+    scene field;
+    scene_init(&field);
+    if (options.scene_count && !field_init(&field, mesh, options.scene_count, mesh_scale)) {
+        fprintf(stderr, "failed to allocate %u scene objects\n", options.scene_count);
+        return 1;
+    }
+    render_world entities = {0};
+    if (options.entity_count &&
+        !entities_init(&entities, mesh, options.entity_count, mesh_scale, options.thread_count)) {
+        fprintf(stderr, "failed to create the entity world\n");
+        return 1;
+    }
+    if (options.lods) {
+        entities.viewport_height = backbuffer.height;
+    }
+    occlusion_buffer occlusion = {0};
+    if (options.scene_count && options.occlusion) {
+        if (!field_add_walls(&field, &my_cube)) {
+            fprintf(stderr, "failed to allocate the walls\n");
+            return 1;
+        }
+        occlusion_buffer_init(&occlusion, backbuffer.width / 4, backbuffer.height / 4);
+        field.occlusion = &occlusion;
+    }
+    uint64_t occluded_total = 0;
+    uint64_t visible_total = 0;
+    renderer_stats stats_total = {0};
+
+    const instance_data cube_instances = {
+        cubes.position[0], cubes.position[1], cubes.position[2],
+        cubes.rotation[0], cubes.rotation[1], cubes.rotation[2], cubes.rotation[3],
+        cubes.scale[0], cubes.scale[1], cubes.scale[2],
+    };
+
+    // Same simulation as WinMain, minus the message pump; presenting is dumping.
+    const double start = linux_get_seconds();
+    for (uint32_t frame = 0; frame < options.frame_count; ++frame) {
+        TracyCFrameMarkStart("main");
+
+        if (frame > 0) {
+            swapchain_acquire(chain, &backbuffer);
+        }
+
+        if (cube_pos[0] > 3.0f || cube_pos[0] < -3.0f) {
+            velocity[0] = -velocity[0];
+        }
+        if (cube_pos[1] > 3.0f || cube_pos[1] < -3.0f) {
+            velocity[1] = -velocity[1];
+        }
+        if (cube_pos[2] > 3.0f || cube_pos[2] < -3.0f) {
+            velocity[2] = -velocity[2];
+        }
+
+        glm_rotate_y(cube_rot, 0.001f, cube_rot);
+        glm_rotate_x(cube_rot, 0.001f, cube_rot);
+
+        // The bouncing mesh
+        versor rot;
+        glm_mat4_quat(cube_rot, rot);
+        vec3 pos, scale = {mesh_scale, mesh_scale, mesh_scale};
+        glm_vec3_add(cube_pos, mesh_offset, pos);
+
+        clean_buff(&backbuffer);
+        renderer_begin_frame(&backbuffer);
+
+        if (field.object_count) {
+            field_spin(&field, options.scene_count, (float) frame * 0.01f);
+            if (options.deferred) {
+                scene_cull(&field, &my_camera);
+                for (uint32_t i = 0; i < field.visible_count; ++i) {
+                    scene_object *object = &field.objects[field.visible[i]];
+                    const model *object_mesh = field.meshes[object->mesh].mesh;
+                    object->lod = (uint8_t) lod_select(object_mesh, &my_camera, backbuffer.height, object->position,
+                                                       object->rotation, object->scale, object->lod);
+                    command_buffer_draw(&commands, RENDER_PIPELINE_RASTER, 0, model_lod(object_mesh, object->lod),
+                                        object->position, object->rotation, object->scale);
+                }
+            } else {
+                scene_render(&field, &my_camera, &backbuffer);
+            }
+            visible_total += field.visible_count;
+            occluded_total += field.occluded_count;
+        } else if (entities.ecs) {
+            // Fixed steps, so every run moves the entities the same way
+            visible_total += render_world_progress(&entities, &my_camera, 1.0f / 60.0f);
+            render_world_submit(&entities, &my_camera, &backbuffer);
+        } else if (cubes.count) {
+            crowd_spin(&cubes, (float) frame * 0.01f);
+            if (options.deferred) {
+                for (uint32_t i = 0; i < cubes.count; ++i) {
+                    vec3 pos = {cubes.position[0][i], cubes.position[1][i], cubes.position[2][i]};
+                    versor rot = {cubes.rotation[0][i], cubes.rotation[1][i], cubes.rotation[2][i], cubes.rotation[3][i]};
+                    vec3 scale = {cubes.scale[0][i], cubes.scale[1][i], cubes.scale[2][i]};
+                    command_buffer_draw(&commands, RENDER_PIPELINE_RASTER, 0, mesh, pos, rot, scale);
+                }
+            } else {
+                render_obj_raster_instanced(mesh, &cube_instances, cubes.count, &my_camera, &backbuffer);
+            }
+        } else {
+            mesh_lod = lod_select(mesh, &my_camera, backbuffer.height, pos, rot, scale, mesh_lod);
+            if (options.deferred) {
+                command_buffer_draw(&commands, RENDER_PIPELINE_RASTER, 0, model_lod(mesh, mesh_lod), pos, rot, scale);
+                if (options.wire) {
+                    command_buffer_draw(&commands, RENDER_PIPELINE_WIRE, 0, mesh, pos, rot, scale);
+                }
+            } else {
+                render_obj_raster(*model_lod(mesh, mesh_lod), pos, rot, scale, &my_camera, &backbuffer);
+                if (options.wire) {
+                    // Lines go straight to the framebuffer, so the tiles binned so far go first
+                    renderer_flush_tiles(&backbuffer);
+                    render_obj_wire(*mesh, pos, rot, scale, &my_camera, &backbuffer);
+                }
+            }
+        }
+        command_buffer_submit(&commands, &my_camera, &backbuffer);
+
+        renderer_end_frame(&backbuffer);
+
+        renderer_stats frame_stats;
+        renderer_get_stats(&frame_stats);
+        add_stats(&stats_total, &frame_stats);
+
+        glm_vec3_add(cube_pos, velocity, cube_pos);
+
+        swapchain_submit(chain);
+
+        TracyCFrameMarkEnd("main");
+    }
+    // Includes the dumps still queued
+    swapchain_destroy(chain);
+    const double elapsed = linux_get_seconds() - start;
+
+    printf("%u frames at %ux%u in %.3f s: %.4f ms/frame (%.1f fps)\n",
+           options.frame_count, backbuffer.width, backbuffer.height, elapsed,
+           options.frame_count ? elapsed * 1000.0 / options.frame_count : 0.0,
+           elapsed > 0.0 ? options.frame_count / elapsed : 0.0);
+
+    if (options.frame_count) {
+        const double frames = options.frame_count;
+        printf("pipeline per frame: %.0f triangles in, %.0f meshlets culled, %.0f frustum culled, %.0f clipped,\n"
+               "  %.0f backface culled, %.0f setup culled, %.0f rasterized; %.0f pixels tested, %.0f written,\n"
+               "  overdraw %.2f\n",
+               stats_total.triangles_in / frames, stats_total.meshlets_culled / frames,
+               stats_total.triangles_frustum_culled / frames, stats_total.triangles_clipped / frames,
+               stats_total.triangles_backface_culled / frames, stats_total.triangles_setup_culled / frames,
+               stats_total.triangles_rasterized / frames, stats_total.pixels_tested / frames,
+               stats_total.pixels_written / frames, stats_total.overdraw / frames);
+        if (stats_total.triangles_dropped) {
+            printf("  %llu triangles dropped, out of binning memory\n",
+                   (unsigned long long) stats_total.triangles_dropped);
+        }
+    }
+
+    if (field.object_count && options.frame_count) {
+        printf("scene: %u objects, %.1f visible and %.1f occluded per frame\n", field.object_count,
+               (double) visible_total / options.frame_count, (double) occluded_total / options.frame_count);
+    }
+
+    if (entities.ecs && options.frame_count) {
+        printf("entities: %u, %.1f visible per frame\n", options.entity_count,
+               (double) visible_total / options.frame_count);
+    }
+
+    render_world_free(&entities);
+    occlusion_buffer_free(&occlusion);
+    scene_free(&field);
+    command_buffer_free(&commands);
+    if (shading_attributes) {
+        // Not owned by the model, and mapped meshes are never model_free'd
+        mesh->attributes = 0;
+        mesh->attribute_count = 0;
+        TracyCFree(shading_attributes);
+        free(shading_attributes);
+    }
+    texture_free(&test_texture);
+    if (built_edges) {
+        mapped_mesh.mesh.edges = 0;
+        TracyCFree(built_edges);
+        free(built_edges);
+    }
+    model_free_meshlets(&mapped_mesh.mesh);
+    model_free_lods(&mapped_mesh.mesh);
+    mesh_file_close(&mapped_mesh);
+    model_free(&imported_mesh);
+    model_free(&my_cube);
+    free(cubes.components);
+    renderer_set_thread_count(1);
+    renderer_tiles_free(&backbuffer);
+    renderer_depth_free(&backbuffer);
+
+    TracyCZoneEnd(main_tracy);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#define _GNU_SOURCE
+#include "linux_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "tracy/TracyC.h"
+
+#define HUGE_PAGE_SIZE (2u * 1024u * 1024u)
+
+static void *map_pages(const size_t size, const bool use_hugepages, size_t *mapped_size) {
+    if (use_hugepages) {
+        // Explicit hugetlb pages need the length rounded to the huge page size.
+        const size_t huge_size = (size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+        void *memory = mmap(0, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            *mapped_size = huge_size;
+            return memory;
+        }
+    }
+
+    void *memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        *mapped_size = 0;
+        return 0;
+    }
+
+    if (use_hugepages) {
+        // No reserved hugetlb pool, ask for transparent huge pages instead.
+        madvise(memory, size, MADV_HUGEPAGE);
+    }
+
+    *mapped_size = size;
+    return memory;
+}
+
+void linux_resize_buffer(graphics_buffer *buffer, const uint32_t width, const uint32_t height,
+                         const bool use_hugepages) {
+    linux_free_buffer(buffer);
+
+    buffer->width = width;
+    buffer->height = height;
+
+    const uint32_t bytes_per_pixel = 4;
+    buffer->pitch = width * bytes_per_pixel;
+
+    buffer->memory = map_pages((size_t) buffer->pitch * height, use_hugepages, &buffer->memory_size);
+    TracyCAlloc(buffer->memory, buffer->memory_size);
+}
+
+void linux_free_buffer(graphics_buffer *buffer) {
+    if (buffer->memory) {
+        TracyCFree(buffer->memory);
+        munmap(buffer->memory, buffer->memory_size);
+    }
+
+    buffer->memory = 0;
+    buffer->memory_size = 0;
+}
+
+bool linux_write_ppm(const graphics_buffer *buffer, const char *path) {
+    TracyCZone(linux_write_ppm_tracy, true);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        TracyCZoneEnd(linux_write_ppm_tracy);
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", buffer->width, buffer->height);
+
+    uint8_t *rgb_row = malloc((size_t) buffer->width * 3);
+    const uint8_t *row = buffer->memory;
+    bool ok = rgb_row != 0;
+    for (uint32_t y = 0; ok && y < buffer->height; ++y) {
+        const uint32_t *pixel = (const uint32_t *) row;
+        for (uint32_t x = 0; x < buffer->width; ++x) {
+            rgb_row[x * 3 + 0] = (uint8_t) (pixel[x] >> 16);
+            rgb_row[x * 3 + 1] = (uint8_t) (pixel[x] >> 8);
+            rgb_row[x * 3 + 2] = (uint8_t) pixel[x];
+        }
+        ok = fwrite(rgb_row, 3, buffer->width, file) == buffer->width;
+        row += buffer->pitch;
+    }
+
+    free(rgb_row);
+    ok = (fclose(file) == 0) && ok;
+
+    TracyCZoneEnd(linux_write_ppm_tracy);
+    return ok;
+}
+
+double linux_get_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,21 @@
+#ifndef MYC23PROJECT_LINUX_PLATFORM_H
+#define MYC23PROJECT_LINUX_PLATFORM_H
+
+#include "renderer.h"
+
+// Headless counterpart of win32_platform: there is no window, the backbuffer is plain
+// anonymous memory and "presenting" a frame means optionally writing it to disk.
+
+// (Re)allocates the backbuffer with mmap. When use_hugepages is set the mapping is first
+// attempted with explicit 2MB pages, then falls back to regular pages with a THP hint.
+void linux_resize_buffer(graphics_buffer *buffer, uint32_t width, uint32_t height, bool use_hugepages);
+
+void linux_free_buffer(graphics_buffer *buffer);
+
+// Writes the 0x00RRGGBB backbuffer as a binary PPM (P6). Returns false on I/O failure.
+bool linux_write_ppm(const graphics_buffer *buffer, const char *path);
+
+// Monotonic clock in seconds, for frame timing.
+double linux_get_seconds(void);
+
+#endif //MYC23PROJECT_LINUX_PLATFORM_H
@@ -0,0 +1,806 @@
+#include "lod.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "instance_stage.h"
+#include "meshlet.h"
+#include "tracy/TracyC.h"
+
+// Planes along open borders count this much more than the surface around them
+#define LOD_BORDER_WEIGHT 10.0
+
+// Sum of squared distances to a set of planes, weighted by triangle area: error(p) = p^T Q p
+// over the symmetric 4x4 Q, stored as its upper triangle. weight is the summed area, so
+// error / weight is a mean squared distance.
+typedef struct {
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+    double weight;
+} quadric;
+
+static void quadric_add_plane(quadric *restrict q, const double n[3], const double d, const double w) {
+    q->a2 += w * n[0] * n[0];
+    q->ab += w * n[0] * n[1];
+    q->ac += w * n[0] * n[2];
+    q->ad += w * n[0] * d;
+    q->b2 += w * n[1] * n[1];
+    q->bc += w * n[1] * n[2];
+    q->bd += w * n[1] * d;
+    q->c2 += w * n[2] * n[2];
+    q->cd += w * n[2] * d;
+    q->d2 += w * d * d;
+}
+
+static void quadric_add(quadric *restrict q, const quadric *restrict other) {
+    q->a2 += other->a2;
+    q->ab += other->ab;
+    q->ac += other->ac;
+    q->ad += other->ad;
+    q->b2 += other->b2;
+    q->bc += other->bc;
+    q->bd += other->bd;
+    q->c2 += other->c2;
+    q->cd += other->cd;
+    q->d2 += other->d2;
+    q->weight += other->weight;
+}
+
+// Mean squared distance of p to the planes of q0 + q1
+static double quadric_pair_error(const quadric *restrict q0, const quadric *restrict q1, const float *restrict p) {
+    const double x = p[0], y = p[1], z = p[2];
+    const double a2 = q0->a2 + q1->a2, ab = q0->ab + q1->ab, ac = q0->ac + q1->ac, ad = q0->ad + q1->ad;
+    const double b2 = q0->b2 + q1->b2, bc = q0->bc + q1->bc, bd = q0->bd + q1->bd;
+    const double c2 = q0->c2 + q1->c2, cd = q0->cd + q1->cd, d2 = q0->d2 + q1->d2;
+    const double error = a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * (ab * x * y + ac * x * z + bc * y * z) +
+                         2.0 * (ad * x + bd * y + cd * z) + d2;
+    const double weight = q0->weight + q1->weight;
+    return error > 0.0 && weight > 0.0 ? error / weight : 0.0;
+}
+
+// Collapse of vertex from onto vertex to
+typedef struct {
+    float cost; // Mean squared distance the collapse moves the surface by
+    uint32_t from;
+    uint32_t to;
+} collapse;
+
+// LSD radix sort on cost, 11 bits a pass. Costs are never negative, so their bit patterns
+// sort like the floats. Sorted into items, scratch is as long.
+static void sort_collapses(collapse *restrict items, collapse *restrict scratch, const size_t count) {
+    static_assert(sizeof(float) == sizeof(uint32_t));
+    collapse *source = items;
+    collapse *dest = scratch;
+    for (uint32_t shift = 0; shift < 33; shift += 11) {
+        size_t offsets[2048] = {0};
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t bits;
+            memcpy(&bits, &source[i].cost, sizeof(bits));
+            offsets[(bits >> shift) & 2047]++;
+        }
+        size_t total = 0;
+        for (uint32_t b = 0; b < 2048; ++b) {
+            const size_t n = offsets[b];
+            offsets[b] = total;
+            total += n;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t bits;
+            memcpy(&bits, &source[i].cost, sizeof(bits));
+            dest[offsets[(bits >> shift) & 2047]++] = source[i];
+        }
+        collapse *swap = source;
+        source = dest;
+        dest = swap;
+    }
+    // Three passes leave the result in scratch
+    memcpy(items, source, sizeof(collapse) * count);
+}
+
+// Simplifier state. Vertices are the welded ones: weld[v] is the first model vertex at v's
+// position, and only those appear in corners_welded, quadrics and the triangle lists. A welded
+// vertex on an attribute seam has several wedges, one per side.
+typedef struct {
+    const model *m;
+    uint32_t triangle_count;
+    uint32_t live_count; // Triangles not collapsed away
+
+    uint32_t *weld;
+    uint32_t *wedge;
+    uint32_t *corners; // Wedge of each corner, what the levels index
+    uint32_t *corners_welded; // Welded vertex of each corner
+    bool *triangle_dead;
+
+    quadric *quadrics;
+    bool *border; // On an open border, only collapses along it
+    bool *vertex_dead;
+    uint32_t **triangles; // Triangles using each welded vertex, may include dead ones
+    uint32_t *triangle_counts;
+    bool *locked; // Target or source of a collapse in the current pass
+
+    uint32_t *mark; // Per vertex, == mark_value when visited by the current neighbour walk
+    uint32_t mark_value;
+    uint32_t *neighbours;
+    uint32_t neighbour_capacity;
+
+    collapse *collapses; // Candidates of the current pass, one per live corner
+    collapse *scratch;
+    arena lists; // Triangle lists, a collapse allocates the merged list of its target
+} simplifier;
+
+static inline uint64_t hash_u64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static size_t table_size(const size_t count) {
+    size_t size = 64;
+    while (size < count * 2) {
+        size *= 2;
+    }
+    return size;
+}
+
+static uint64_t hash_floats(const float *restrict values, const uint32_t count, uint64_t h) {
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &values[i], sizeof(bits));
+        h = hash_u64(h ^ bits);
+    }
+    return h;
+}
+
+// Bits of xyz with -0 as +0: both are common around poles and axes, and must weld
+static void position_key(const float *restrict p, uint32_t key[3]) {
+    memcpy(key, p, sizeof(uint32_t) * 3);
+    for (int k = 0; k < 3; ++k) {
+        key[k] = key[k] & 0x7FFFFFFFu ? key[k] : 0;
+    }
+}
+
+static bool same_position(const float *restrict a, const float *restrict b) {
+    uint32_t ka[3], kb[3];
+    position_key(a, ka);
+    position_key(b, kb);
+    return ka[0] == kb[0] && ka[1] == kb[1] && ka[2] == kb[2];
+}
+
+// weld[v]: the first vertex with the same xyz. wedge[v]: the first with the same xyz and
+// bit-identical attributes, so that copies only made for a seam elsewhere count as one vertex.
+static bool weld_vertices(simplifier *restrict s) {
+    const model *m = s->m;
+    const uint32_t attribute_count = m->attributes ? m->attribute_count : 0;
+    const size_t size = table_size(m->vertex_count);
+    uint32_t *positions = malloc(sizeof(uint32_t) * size);
+    uint32_t *wedges = malloc(sizeof(uint32_t) * size);
+    if (!positions || !wedges) {
+        free(positions);
+        free(wedges);
+        return false;
+    }
+    memset(positions, 0xFF, sizeof(uint32_t) * size);
+    memset(wedges, 0xFF, sizeof(uint32_t) * size);
+
+    for (uint32_t v = 0; v < m->vertex_count; ++v) {
+        const float *attributes = attribute_count ? m->attributes + (size_t) v * attribute_count : 0;
+        uint32_t key[3];
+        position_key(m->vertices[v], key);
+        const uint64_t h = hash_u64(hash_u64(((uint64_t) key[0] << 32) | key[1]) ^ key[2]);
+
+        size_t slot = h & (size - 1);
+        while (positions[slot] != UINT32_MAX && !same_position(m->vertices[positions[slot]], m->vertices[v])) {
+            slot = (slot + 1) & (size - 1);
+        }
+        if (positions[slot] == UINT32_MAX) {
+            positions[slot] = v;
+        }
+        s->weld[v] = positions[slot];
+
+        slot = hash_floats(attributes, attribute_count, h) & (size - 1);
+        for (;;) {
+            const uint32_t other = wedges[slot];
+            if (other == UINT32_MAX) {
+                wedges[slot] = v;
+                s->wedge[v] = v;
+                break;
+            }
+            if (same_position(m->vertices[other], m->vertices[v]) &&
+                (!attribute_count || memcmp(m->attributes + (size_t) other * attribute_count, attributes,
+                                            sizeof(float) * attribute_count) == 0)) {
+                s->wedge[v] = other;
+                break;
+            }
+            slot = (slot + 1) & (size - 1);
+        }
+    }
+
+    free(positions);
+    free(wedges);
+    return true;
+}
+
+// Unnormalized face normal, twice the area long
+static void triangle_normal(const float *restrict p0, const float *restrict p1, const float *restrict p2,
+                            double n[3]) {
+    const double e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const double e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+// Vertex -> triangles, each list in its own run of one arena allocation
+static bool build_triangle_lists(simplifier *restrict s) {
+    const uint32_t vertex_count = s->m->vertex_count;
+    for (uint32_t i = 0; i < s->triangle_count * 3; ++i) {
+        if (!s->triangle_dead[i / 3]) {
+            s->triangle_counts[s->corners_welded[i]]++;
+        }
+    }
+
+    uint32_t *storage = arena_alloc_array(&s->lists, uint32_t, (size_t) s->live_count * 3 + 1);
+    if (!storage) {
+        return false;
+    }
+    uint32_t offset = 0;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        s->triangles[v] = storage + offset;
+        offset += s->triangle_counts[v];
+        s->triangle_counts[v] = 0;
+    }
+    for (uint32_t t = 0; t < s->triangle_count; ++t) {
+        if (s->triangle_dead[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = s->corners_welded[t * 3 + k];
+            s->triangles[v][s->triangle_counts[v]++] = t;
+        }
+    }
+    return true;
+}
+
+static inline bool triangle_has(const simplifier *restrict s, const uint32_t t, const uint32_t v) {
+    const uint32_t *tri = &s->corners_welded[t * 3];
+    return tri[0] == v || tri[1] == v || tri[2] == v;
+}
+
+// Whether a live triangle other than t uses the edge a-b, false on open borders
+static bool edge_has_twin(const simplifier *restrict s, const uint32_t t, const uint32_t a, const uint32_t b) {
+    for (uint32_t i = 0; i < s->triangle_counts[a]; ++i) {
+        const uint32_t other = s->triangles[a][i];
+        if (other != t && !s->triangle_dead[other] && triangle_has(s, other, b)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Face planes into the quadrics of their corners, and along open borders the plane through
+// the edge perpendicular to its one triangle, into the quadrics of the border's ends
+static void build_quadrics(simplifier *restrict s) {
+    const vec4 *vertices = s->m->vertices;
+    for (uint32_t t = 0; t < s->triangle_count; ++t) {
+        if (s->triangle_dead[t]) {
+            continue;
+        }
+        const uint32_t *tri = &s->corners_welded[t * 3];
+        double n[3];
+        triangle_normal(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], n);
+        const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0) {
+            const double area = length * 0.5;
+            const double unit[3] = {n[0] / length, n[1] / length, n[2] / length};
+            const float *p = vertices[tri[0]];
+            const double d = -(unit[0] * p[0] + unit[1] * p[1] + unit[2] * p[2]);
+            for (int k = 0; k < 3; ++k) {
+                quadric_add_plane(&s->quadrics[tri[k]], unit, d, area);
+                s->quadrics[tri[k]].weight += area;
+            }
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v0 = tri[k];
+            const uint32_t v1 = tri[(k + 1) % 3];
+            if (edge_has_twin(s, t, v0, v1)) {
+                continue;
+            }
+            s->border[v0] = true;
+            s->border[v1] = true;
+
+            const float *p0 = vertices[v0];
+            const float *p1 = vertices[v1];
+            const double e[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            double plane[3] = {e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0]};
+            const double plane_length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            if (plane_length == 0.0) {
+                continue;
+            }
+            plane[0] /= plane_length;
+            plane[1] /= plane_length;
+            plane[2] /= plane_length;
+            const double d = -(plane[0] * p0[0] + plane[1] * p0[1] + plane[2] * p0[2]);
+            const double w = (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]) * LOD_BORDER_WEIGHT;
+            quadric_add_plane(&s->quadrics[v0], plane, d, w);
+            quadric_add_plane(&s->quadrics[v1], plane, d, w);
+        }
+    }
+}
+
+// Distinct vertices sharing a live triangle with v, into s->neighbours. Leaves them marked.
+static bool gather_neighbours(simplifier *restrict s, const uint32_t v, uint32_t *restrict count) {
+    s->mark_value++;
+    s->mark[v] = s->mark_value;
+    *count = 0;
+    for (uint32_t i = 0; i < s->triangle_counts[v]; ++i) {
+        const uint32_t t = s->triangles[v][i];
+        if (s->triangle_dead[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t n = s->corners_welded[t * 3 + k];
+            if (s->mark[n] == s->mark_value) {
+                continue;
+            }
+            s->mark[n] = s->mark_value;
+            if (*count == s->neighbour_capacity) {
+                const uint32_t capacity = s->neighbour_capacity ? s->neighbour_capacity * 2 : 64;
+                uint32_t *neighbours = realloc(s->neighbours, sizeof(uint32_t) * capacity);
+                if (!neighbours) {
+                    return false;
+                }
+                s->neighbours = neighbours;
+                s->neighbour_capacity = capacity;
+            }
+            s->neighbours[(*count)++] = n;
+        }
+    }
+    return true;
+}
+
+// The wedges of from and to in the triangles on the edge, which says which wedge of to takes
+// over each wedge of from. Returns how many triangles use the edge; pairs has room for two.
+static uint32_t edge_wedges(const simplifier *restrict s, const uint32_t from, const uint32_t to,
+                            uint32_t pairs[2][2]) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < s->triangle_counts[from]; ++i) {
+        const uint32_t t = s->triangles[from][i];
+        if (s->triangle_dead[t] || !triangle_has(s, t, to)) {
+            continue;
+        }
+        if (count < 2) {
+            for (int k = 0; k < 3; ++k) {
+                if (s->corners_welded[t * 3 + k] == from) {
+                    pairs[count][0] = s->corners[t * 3 + k];
+                } else if (s->corners_welded[t * 3 + k] == to) {
+                    pairs[count][1] = s->corners[t * 3 + k];
+                }
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+static inline int32_t find_wedge(const uint32_t pairs[2][2], const uint32_t pair_count, const uint32_t wedge) {
+    for (uint32_t p = 0; p < pair_count; ++p) {
+        if (pairs[p][0] == wedge) {
+            return (int32_t) p;
+        }
+    }
+    return -1;
+}
+
+// Whether moving from onto to keeps the mesh manifold, keeps every remaining triangle within
+// 75 degrees of the way it faced, and keeps borders and attribute seams: a border vertex only
+// moves along its border, and every wedge of from needs a wedge of to on its side, so a seam
+// vertex only moves along its seam.
+static bool collapse_is_valid(simplifier *restrict s, const uint32_t from, const uint32_t to) {
+    uint32_t pairs[2][2];
+    const uint32_t shared = edge_wedges(s, from, to, pairs);
+    if (shared == 0 || shared > 2) {
+        return false; // No longer an edge, or not a manifold one
+    }
+    // Its border planes alone would not hold a short border in place
+    if (s->border[from] && shared != 1) {
+        return false;
+    }
+
+    const vec4 *vertices = s->m->vertices;
+    for (uint32_t i = 0; i < s->triangle_counts[from]; ++i) {
+        const uint32_t t = s->triangles[from][i];
+        if (s->triangle_dead[t] || triangle_has(s, t, to)) {
+            continue;
+        }
+
+        const uint32_t *tri = &s->corners_welded[t * 3];
+        double before[3], after[3];
+        triangle_normal(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], before);
+        const float *p[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = vertices[tri[k] == from ? to : tri[k]];
+            if (tri[k] == from && find_wedge(pairs, shared, s->corners[t * 3 + k]) < 0) {
+                return false;
+            }
+        }
+        triangle_normal(p[0], p[1], p[2], after);
+        const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        const double lengths = sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                                    (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+        if (dot <= 0.25 * lengths) {
+            return false;
+        }
+    }
+
+    // Link condition: the two ends may only have the opposite corners of the removed
+    // triangles as common neighbours, or the collapse would fold two triangles onto each other
+    uint32_t count;
+    if (!gather_neighbours(s, from, &count)) {
+        return false;
+    }
+    const uint32_t from_mark = s->mark_value;
+    const uint32_t common_mark = ++s->mark_value;
+    uint32_t common = 0;
+    for (uint32_t i = 0; i < s->triangle_counts[to]; ++i) {
+        const uint32_t t = s->triangles[to][i];
+        if (s->triangle_dead[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t n = s->corners_welded[t * 3 + k];
+            if (n != from && n != to && s->mark[n] == from_mark) {
+                s->mark[n] = common_mark;
+                common++;
+            }
+        }
+    }
+    return common == shared;
+}
+
+// Moves from onto to: removes the triangles on the edge and points from's other triangles at to
+static bool apply_collapse(simplifier *restrict s, const uint32_t from, const uint32_t to) {
+    // collapse_is_valid found a wedge of to for every wedge of from
+    uint32_t pairs[2][2];
+    const uint32_t pair_count = edge_wedges(s, from, to, pairs);
+    for (uint32_t i = 0; i < s->triangle_counts[from]; ++i) {
+        const uint32_t t = s->triangles[from][i];
+        if (!s->triangle_dead[t] && triangle_has(s, t, to)) {
+            s->triangle_dead[t] = true;
+            s->live_count--;
+        }
+    }
+
+    const uint32_t merged_capacity = s->triangle_counts[from] + s->triangle_counts[to];
+    uint32_t *merged = arena_alloc_array(&s->lists, uint32_t, merged_capacity);
+    if (!merged) {
+        return false;
+    }
+    uint32_t merged_count = 0;
+    for (uint32_t i = 0; i < s->triangle_counts[to]; ++i) {
+        const uint32_t t = s->triangles[to][i];
+        if (!s->triangle_dead[t]) {
+            merged[merged_count++] = t;
+        }
+    }
+    for (uint32_t i = 0; i < s->triangle_counts[from]; ++i) {
+        const uint32_t t = s->triangles[from][i];
+        if (s->triangle_dead[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            if (s->corners_welded[t * 3 + k] != from) {
+                continue;
+            }
+            s->corners_welded[t * 3 + k] = to;
+            s->corners[t * 3 + k] = pairs[find_wedge(pairs, pair_count, s->corners[t * 3 + k])][1];
+        }
+        merged[merged_count++] = t;
+    }
+
+    s->triangles[to] = merged;
+    s->triangle_counts[to] = merged_count;
+    s->triangle_counts[from] = 0;
+    s->vertex_dead[from] = true;
+    quadric_add(&s->quadrics[to], &s->quadrics[from]);
+    return true;
+}
+
+// Collapses edges, cheapest first, until target triangles are left or nothing can collapse.
+// Works in passes: every live edge is scored in its cheaper direction and the pass collapses
+// in that order, skipping edges whose ends an earlier collapse of the pass touched. The cost of
+// an untouched edge only depends on its two quadrics, so it is still exact when its turn comes.
+// Raises max_cost to the largest cost taken, a mean squared distance.
+static bool simplify_to(simplifier *restrict s, const uint32_t target, double *restrict max_cost) {
+    const vec4 *vertices = s->m->vertices;
+    while (s->live_count > target) {
+        // Interior edges from the triangle where they run from the lower vertex, borders from
+        // their only triangle
+        size_t count = 0;
+        for (uint32_t t = 0; t < s->triangle_count; ++t) {
+            if (s->triangle_dead[t]) {
+                continue;
+            }
+            const uint32_t *tri = &s->corners_welded[t * 3];
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t a = tri[k];
+                const uint32_t b = tri[(k + 1) % 3];
+                if (a > b && edge_has_twin(s, t, a, b)) {
+                    continue;
+                }
+                const double into_b = quadric_pair_error(&s->quadrics[a], &s->quadrics[b], vertices[b]);
+                const double into_a = quadric_pair_error(&s->quadrics[a], &s->quadrics[b], vertices[a]);
+                s->collapses[count++] = into_b <= into_a ? (collapse){(float) into_b, a, b}
+                                                         : (collapse){(float) into_a, b, a};
+            }
+        }
+        sort_collapses(s->collapses, s->scratch, count);
+
+        // Collapses remove two triangles each. Past the cost of the collapse that would reach the
+        // target, leave some slack for the edges this pass updates before ending it.
+        const size_t goal = (s->live_count - target) / 2;
+        const float cost_limit = goal < count ? s->collapses[goal].cost * 1.5f : FLT_MAX;
+
+        uint32_t collapsed = 0;
+        memset(s->locked, 0, sizeof(bool) * s->m->vertex_count);
+        for (size_t i = 0; i < count && s->live_count > target; ++i) {
+            const collapse c = s->collapses[i];
+            if (c.cost > cost_limit) {
+                break;
+            }
+            if (s->locked[c.from] || s->locked[c.to] || !collapse_is_valid(s, c.from, c.to)) {
+                continue;
+            }
+            if (!apply_collapse(s, c.from, c.to)) {
+                return false;
+            }
+            s->locked[c.from] = true;
+            s->locked[c.to] = true;
+            if (c.cost > *max_cost) {
+                *max_cost = c.cost;
+            }
+            collapsed++;
+        }
+        if (collapsed == 0) {
+            break;
+        }
+    }
+    return true;
+}
+
+static void free_simplifier(simplifier *restrict s) {
+    free(s->weld);
+    free(s->wedge);
+    free(s->corners);
+    free(s->corners_welded);
+    free(s->triangle_dead);
+    free(s->quadrics);
+    free(s->border);
+    free(s->vertex_dead);
+    free(s->triangles);
+    free(s->triangle_counts);
+    free(s->mark);
+    free(s->neighbours);
+    free(s->locked);
+    free(s->collapses);
+    free(s->scratch);
+    arena_free(&s->lists);
+}
+
+static bool init_simplifier(simplifier *restrict s, const model *m) {
+    *s = (simplifier){.m = m, .triangle_count = m->index_count / 3};
+    arena_init(&s->lists, (size_t) 4 * 1024 * 1024);
+
+    const uint32_t vertex_count = m->vertex_count;
+    const size_t corner_count = (size_t) s->triangle_count * 3;
+    s->weld = malloc(sizeof(uint32_t) * vertex_count);
+    s->wedge = malloc(sizeof(uint32_t) * vertex_count);
+    s->corners = malloc(sizeof(uint32_t) * corner_count);
+    s->corners_welded = malloc(sizeof(uint32_t) * corner_count);
+    s->triangle_dead = calloc(s->triangle_count, sizeof(bool));
+    s->quadrics = calloc(vertex_count, sizeof(quadric));
+    s->border = calloc(vertex_count, sizeof(bool));
+    s->vertex_dead = calloc(vertex_count, sizeof(bool));
+    s->triangles = malloc(sizeof(uint32_t *) * vertex_count);
+    s->triangle_counts = calloc(vertex_count, sizeof(uint32_t));
+    s->mark = calloc(vertex_count, sizeof(uint32_t));
+    s->locked = malloc(sizeof(bool) * (vertex_count ? vertex_count : 1));
+    s->collapses = malloc(sizeof(collapse) * (corner_count ? corner_count : 1));
+    s->scratch = malloc(sizeof(collapse) * (corner_count ? corner_count : 1));
+    if (!s->weld || !s->wedge || !s->corners || !s->corners_welded || !s->triangle_dead || !s->quadrics || !s->border ||
+        !s->vertex_dead || !s->triangles || !s->triangle_counts || !s->mark ||
+        !s->locked || !s->collapses || !s->scratch || !weld_vertices(s)) {
+        return false;
+    }
+
+    // Triangles that welding made degenerate never take part
+    for (uint32_t t = 0; t < s->triangle_count; ++t) {
+        uint32_t *tri = &s->corners_welded[t * 3];
+        for (int k = 0; k < 3; ++k) {
+            s->corners[t * 3 + k] = s->wedge[m->indices[t * 3 + k]];
+            tri[k] = s->weld[m->indices[t * 3 + k]];
+        }
+        s->triangle_dead[t] = tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0];
+        s->live_count += !s->triangle_dead[t];
+    }
+
+    if (!build_triangle_lists(s)) {
+        return false;
+    }
+    build_quadrics(s);
+    return true;
+}
+
+// The live triangles as a level of their own: only the vertices they use, in first-use order,
+// so a coarse level also does less vertex work. remap is scratch, one entry per model vertex.
+static bool emit_level(const simplifier *restrict s, uint32_t *restrict remap, model *restrict level) {
+    const model *m = s->m;
+    const uint32_t attribute_count = m->attributes ? m->attribute_count : 0;
+    *level = (model){.has_bounds = true};
+    // The level's vertices are a subset of the model's, its sphere still contains them
+    glm_vec4_copy(m->lods->bounds, level->bounds);
+
+    memset(remap, 0xFF, sizeof(uint32_t) * m->vertex_count);
+    uint32_t vertex_count = 0;
+    for (uint32_t t = 0; t < s->triangle_count; ++t) {
+        if (s->triangle_dead[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = s->corners[t * 3 + k];
+            if (remap[v] == UINT32_MAX) {
+                remap[v] = vertex_count++;
+            }
+        }
+    }
+
+    level->indices = malloc(sizeof(uint32_t) * s->live_count * 3);
+    level->vertices = malloc(sizeof(vec4) * vertex_count);
+    level->attributes = attribute_count ? malloc(sizeof(float) * attribute_count * vertex_count) : 0;
+    if (!level->indices || !level->vertices || (attribute_count && !level->attributes)) {
+        free(level->indices);
+        free(level->vertices);
+        free(level->attributes);
+        *level = (model){0};
+        return false;
+    }
+    TracyCAlloc(level->indices, sizeof(uint32_t) * s->live_count * 3);
+    TracyCAlloc(level->vertices, sizeof(vec4) * vertex_count);
+    if (level->attributes) {
+        TracyCAlloc(level->attributes, sizeof(float) * attribute_count * vertex_count);
+    }
+    level->vertex_count = vertex_count;
+    level->attribute_count = attribute_count;
+
+    for (uint32_t v = 0; v < m->vertex_count; ++v) {
+        const uint32_t to = remap[v];
+        if (to == UINT32_MAX) {
+            continue;
+        }
+        glm_vec4_copy(m->vertices[v], level->vertices[to]);
+        if (attribute_count) {
+            memcpy(level->attributes + (size_t) to * attribute_count, m->attributes + (size_t) v * attribute_count,
+                   sizeof(float) * attribute_count);
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t t = 0; t < s->triangle_count; ++t) {
+        if (!s->triangle_dead[t]) {
+            for (int k = 0; k < 3; ++k) {
+                level->indices[count++] = remap[s->corners[t * 3 + k]];
+            }
+        }
+    }
+    level->index_count = count;
+
+    // Levels of a clustered model are clustered too, or switching level would lose the culling
+    return !m->meshlets || model_build_meshlets(level);
+}
+
+bool model_build_lods(model *m) {
+    TracyCZone(build_lods_tracy, true);
+    model_free_lods(m);
+
+    model_lods *lods = calloc(1, sizeof(model_lods));
+    if (!lods) {
+        TracyCZoneEnd(build_lods_tracy);
+        return false;
+    }
+    lods->level_count = 1;
+    instance_stage_model_bounds(m, lods->bounds);
+    m->lods = lods;
+
+    simplifier s;
+    bool ok = init_simplifier(&s, m);
+    uint32_t *remap = ok ? malloc(sizeof(uint32_t) * m->vertex_count) : 0;
+    ok = ok && remap;
+    double max_cost = 0.0;
+    uint32_t previous = s.live_count;
+    while (ok && lods->level_count < LOD_MAX_LEVELS && previous / 2 >= LOD_MIN_TRIANGLES) {
+        ok = simplify_to(&s, previous / 2, &max_cost);
+        // A level that barely simplifies is not worth switching to: stop at the first stall
+        if (!ok || s.live_count > previous - previous / 4) {
+            break;
+        }
+        model *level = &lods->levels[lods->level_count];
+        ok = emit_level(&s, remap, level);
+        if (ok) {
+            lods->errors[lods->level_count] = (float) sqrt(max_cost);
+            lods->level_count++;
+            previous = s.live_count;
+        } else {
+            model_free(level);
+        }
+    }
+    free(remap);
+    free_simplifier(&s);
+
+    if (!ok) {
+        model_free_lods(m);
+    }
+    TracyCZoneEnd(build_lods_tracy);
+    return ok;
+}
+
+void model_free_lods(model *m) {
+    model_lods *lods = m->lods;
+    if (!lods) {
+        return;
+    }
+
+    for (uint32_t l = 1; l < lods->level_count; ++l) {
+        model_free(&lods->levels[l]);
+    }
+    free(lods);
+    m->lods = 0;
+}
+
+const model *model_lod(const model *m, const uint32_t level) {
+    if (!m->lods || level == 0) {
+        return m;
+    }
+    return &m->lods->levels[level < m->lods->level_count ? level : m->lods->level_count - 1];
+}
+
+uint32_t lod_select(const model *m, camera *restrict cam, const uint32_t viewport_height, vec3 pos, versor rot,
+                    vec3 scale, const uint32_t current) {
+    const model_lods *lods = m->lods;
+    if (!lods || lods->level_count < 2) {
+        return 0;
+    }
+
+    // Sphere in world space, radius and errors grown by the largest scale axis
+    const float max_scale = fmaxf(fabsf(scale[0]), fmaxf(fabsf(scale[1]), fabsf(scale[2])));
+    vec3 center;
+    glm_vec3_mul((float *) lods->bounds, scale, center);
+    glm_quat_rotatev(rot, center, center);
+    glm_vec3_add(center, pos, center);
+
+    // Pixels per world unit at the nearest point of the sphere, the projection's y scale
+    // mapping one unit at distance 1 to half the viewport height
+    camera_get_pv_matrix(cam);
+    const float distance = glm_vec3_distance(cam->position, center) - lods->bounds[3] * max_scale;
+    if (distance <= cam->near_clip) {
+        return 0;
+    }
+    const float pixels = cam->proj_mat[1][1] * 0.5f * (float) viewport_height / distance * max_scale;
+
+    uint32_t level = 0;
+    for (uint32_t l = 1; l < lods->level_count; ++l) {
+        const float threshold = LOD_ERROR_PIXELS * (l <= current ? 1.0f + LOD_HYSTERESIS : 1.0f - LOD_HYSTERESIS);
+        if (lods->errors[l] * pixels > threshold) {
+            break;
+        }
+        level = l;
+    }
+    return level;
+}
@@ -0,0 +1,53 @@
+#ifndef MYC23PROJECT_LOD_H
+#define MYC23PROJECT_LOD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "renderer.h"
+
+#define LOD_MAX_LEVELS 8
+
+// Each level aims for half the triangles of the one before; the chain stops below this.
+#define LOD_MIN_TRIANGLES 32
+
+// A level is drawn once its error projects below this many pixels. Switching to a coarser
+// level takes (1 - LOD_HYSTERESIS) of it, back to a finer one (1 + LOD_HYSTERESIS), so an
+// object hovering at a threshold does not flicker between two levels.
+#define LOD_ERROR_PIXELS 1.0f
+#define LOD_HYSTERESIS 0.25f
+
+// Simplified versions of a model. Every collapse moves a vertex onto one of its neighbours, so a
+// level's vertices are a subset of the model's: each level owns a compacted copy of the ones it
+// still uses, with their attributes, so coarse levels also transform fewer vertices. Level 0 is
+// the model itself, levels[0] stays empty.
+struct model_lods {
+    model levels[LOD_MAX_LEVELS]; // Own vertices, indices and attributes, meshlets when the model has them, no edges
+    float errors[LOD_MAX_LEVELS]; // Model-space distance the level deviates from the model by
+    uint32_t level_count;
+    vec4 bounds; // Model-space bounding sphere, center xyz and radius w
+};
+
+// Builds m->lods by quadric error edge collapse (Garland and Heckbert), taking the cheapest
+// collapses first until each level's triangle budget is met. Vertices at the same position are
+// welded, so seams do not open; vertices on attribute seams and open borders only collapse
+// along them. Set m->attributes and build m->meshlets first: the levels copy the attributes,
+// and get meshlets of their own when the model has them. Returns false when out of memory; a
+// mesh that cannot be simplified gets a single level. Meant for load time: a few seconds per
+// million triangles.
+bool model_build_lods(model *m);
+
+void model_free_lods(model *m);
+
+// The model to draw for a level, m itself for level 0 or models without LODs.
+const model *model_lod(const model *m, uint32_t level);
+
+// Level of m to draw at this transform for a viewport viewport_height pixels high: the coarsest
+// whose error, scaled like the model and projected at the nearest point of its bounding
+// sphere, stays under LOD_ERROR_PIXELS. current is the level drawn last frame, for the
+// hysteresis. 0 for models without LODs, or when the camera is inside the bounds.
+uint32_t lod_select(const model *m, camera *restrict cam, uint32_t viewport_height, vec3 pos, versor rot,
+                    vec3 scale, uint32_t current);
+
+#endif //MYC23PROJECT_LOD_H
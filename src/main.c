@@ -2,32 +2,74 @@
 #include <windows.h>
 #include "cglm/cglm.h"
 #include "renderer.h"
+#include "cube.h"
+#include "render_world.h"
+#include "swapchain.h"
 #include "win32_platform.h"
 #include "tracy/TracyC.h"
 
 static bool g_running = false;
-static graphics_buffer g_backbuffer;
+static graphics_buffer g_backbuffer; // Color memory borrowed from g_swapchain's current image
+static swapchain *g_swapchain;
+
+// Runs on the swapchain's present thread, the only one drawing to the window
+static void present_to_window(void *user, const graphics_buffer *image, const ivec4 *rects,
+                              const uint32_t rect_count, const uint64_t frame) {
+    (void) frame;
+    HWND window = user;
+
+    RECT rect;
+    GetClientRect(window, &rect);
+    HDC dc = GetDC(window);
+    win32_display_buffer_rects(
+        image,
+        dc,
+        rect.right - rect.left,
+        rect.bottom - rect.top,
+        rects,
+        rect_count
+    );
+    ReleaseDC(window, dc);
+}
+
+static void resize_image(graphics_buffer *image, const uint32_t width, const uint32_t height, void *user) {
+    (void) user;
+    win32_resize_dib_section(image, width, height);
+}
+
+static void release_image(graphics_buffer *image, void *user) {
+    (void) user;
+    win32_free_buffer(image);
+}
+
+static void acquire_backbuffer(void) {
+    if (swapchain_acquire(g_swapchain, &g_backbuffer)) {
+        renderer_depth_init(&g_backbuffer);
+        renderer_tiles_init(&g_backbuffer);
+    }
+}
 
 LRESULT CALLBACK main_window_proc(HWND wnd, const UINT msg, const WPARAM w_param, const LPARAM l_param) {
     switch (msg) {
         case WM_SIZE: {
-            RECT rect;
-            GetClientRect(wnd, &rect);
-            win32_resize_dib_section(&g_backbuffer, rect.right - rect.left, rect.bottom - rect.top);
+            // Sent once from CreateWindowExA, before the swapchain exists. Later sizes apply
+            // to each image as it is next acquired, the one being presented is not touched.
+            if (g_swapchain) {
+                RECT rect;
+                GetClientRect(wnd, &rect);
+                swapchain_resize(g_swapchain, rect.right - rect.left, rect.bottom - rect.top);
+            }
             return 0;
         }
         case WM_PAINT: {
+            // The present thread owns the window's pixels: validate, and have it repaint all
+            // of the next frame
             PAINTSTRUCT ps;
-            HDC hdc = BeginPaint(wnd, &ps);
-            RECT rect;
-            GetClientRect(wnd, &rect);
-            win32_display_buffer(
-                &g_backbuffer,
-                hdc,
-                rect.right - rect.left,
-                rect.bottom - rect.top
-            );
+            BeginPaint(wnd, &ps);
             EndPaint(wnd, &ps);
+            if (g_swapchain) {
+                swapchain_invalidate(g_swapchain);
+            }
             return 0;
         }
         case WM_CLOSE:
@@ -41,48 +83,6 @@ LRESULT CALLBACK main_window_proc(HWND wnd, const UINT msg, const WPARAM w_param
     }
 }
 
-void init_cube_mesh(model *cube_model) {
-    TracyCZone(init_cube_mesh, true);
-
-    constexpr uint32_t UNIQUE_VERTEX_COUNT = 8;
-    const vec4 unique_vertices[UNIQUE_VERTEX_COUNT] = {
-        {-0.5f, -0.5f, 0.5f, 1.0f}, {0.5f, -0.5f, 0.5f, 1.0f}, {0.5f, 0.5f, 0.5f, 1.0f}, {-0.5f, 0.5f, 0.5f, 1.0f},
-        {-0.5f, -0.5f, -0.5f, 1.0f}, {0.5f, -0.5f, -0.5f, 1.0f}, {0.5f, 0.5f, -0.5f, 1.0f}, {-0.5f, 0.5f, -0.5f, 1.0f}
-    };
-    constexpr uint32_t CUBE_INDEX_COUNT = 36;
-    const uint32_t cube_indices[CUBE_INDEX_COUNT] = {
-        0, 2, 1, 0, 3, 2, 5, 7, 4, 5, 6, 7, 4, 3, 0, 4, 7, 3,
-        5, 2, 6, 5, 1, 2, 3, 6, 2, 3, 7, 6, 0, 1, 5, 0, 5, 4
-    };
-
-    cube_model->vertex_count = UNIQUE_VERTEX_COUNT;
-    cube_model->index_count = CUBE_INDEX_COUNT;
-    cube_model->vertices = malloc(sizeof(vec4) * UNIQUE_VERTEX_COUNT);
-    cube_model->indices = malloc(sizeof(uint32_t) * CUBE_INDEX_COUNT);
-    TracyCAlloc(cube_model->vertices, sizeof(vec4) * UNIQUE_VERTEX_COUNT);
-    TracyCAlloc(cube_model->indices, sizeof(uint32_t) * CUBE_INDEX_COUNT);
-    memcpy(cube_model->vertices, unique_vertices, sizeof(vec4) * UNIQUE_VERTEX_COUNT);
-    memcpy(cube_model->indices, cube_indices, sizeof(uint32_t) * CUBE_INDEX_COUNT);
-
-    // Call the pre-processing function
-    model_build_unique_edges(cube_model);
-
-    TracyCZoneEnd(init_cube_mesh);
-}
-
-void init_camera_for_cube(camera *cam, float window_width, float window_height) {
-    constexpr vec3 cam_pos = {5.0f, 5.0f, 5.0f};
-    memcpy(cam->position, cam_pos, sizeof(vec3));
-    glm_quat_forp(cam_pos, GLM_VEC3_ZERO, ((vec3){0.0f, 0.0f, 1.0f}), cam->rotation);
-
-    cam->FOV = 45.0f;
-    cam->aspect = window_width / window_height;
-    cam->near_clip = 0.1f;
-    cam->far_clip = 100.0f;
-    cam->projection_is_dirty = true;
-    cam->view_is_dirty = true;
-}
-
 int WINAPI WinMain(
     HINSTANCE instance,
     HINSTANCE hPrevInstance,
@@ -113,17 +113,47 @@ int WINAPI WinMain(
         return 1;
     }
 
+    RECT client_rect;
+    GetClientRect(window, &client_rect);
+    const swapchain_desc chain_desc = {
+        .image_count = 3,
+        .width = client_rect.right - client_rect.left,
+        .height = client_rect.bottom - client_rect.top,
+        .track_dirty = true,
+        .resize_image = resize_image,
+        .release_image = release_image,
+        .present = present_to_window,
+        .user = window,
+    };
+    g_swapchain = swapchain_create(&chain_desc);
+    if (!g_swapchain) {
+        return 1;
+    }
+
     g_running = true;
 
-    HDC hdc = GetDC(window);
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    renderer_set_thread_count(system_info.dwNumberOfProcessors);
 
     model my_cube;
     init_cube_mesh(&my_cube);
 
-    mat4 cube_rot = GLM_MAT4_IDENTITY_INIT;
+    // The cube is an entity: moved, culled and recorded by the world's systems on flecs'
+    // workers, which are idle while the tiles rasterize
+    render_world world;
+    if (!render_world_init(&world, system_info.dwNumberOfProcessors)) {
+        // Same teardown as the normal exit: joins the present thread and frees its images
+        swapchain_destroy(g_swapchain);
+        g_swapchain = 0;
+        model_free(&my_cube);
+        return 1;
+    }
+    world.bounce_extent = 3.0f;
+    render_world_spawn(&world, &my_cube, GLM_VEC3_ZERO, GLM_QUAT_IDENTITY, GLM_VEC3_ONE,
+                       (vec3){0.5f, 0.5f, 0.5f}, (vec3){0.5f, 0.5f, 0.0f});
 
-    vec3 cube_pos = GLM_VEC3_ZERO_INIT;
-    vec3 velocity = {0.001f, 0.001f, 0.001f};
+    acquire_backbuffer();
 
     camera my_camera;
     init_camera_for_cube(&my_camera, g_backbuffer.width, g_backbuffer.height);
@@ -143,40 +173,25 @@ int WINAPI WinMain(
             DispatchMessageA(&msg);
         }
 
-        if (cube_pos[0] > 3.0f || cube_pos[0] < -3.0f) {
-            velocity[0] = -velocity[0];
-        }
-        if (cube_pos[1] > 3.0f || cube_pos[1] < -3.0f) {
-            velocity[1] = -velocity[1];
-        }
-        if (cube_pos[2] > 3.0f || cube_pos[2] < -3.0f) {
-            velocity[2] = -velocity[2];
-        }
-
-        glm_rotate_y(cube_rot, 0.001f, cube_rot);
-        glm_rotate_x(cube_rot, 0.001f, cube_rot);
+        // Frame time measured by flecs
+        render_world_progress(&world, &my_camera, 0.0f);
 
         clean_buff(&g_backbuffer);
+        renderer_begin_frame(&g_backbuffer);
+        render_world_submit(&world, &my_camera, &g_backbuffer);
+        renderer_end_frame(&g_backbuffer);
 
-        versor rot;
-        glm_mat4_quat(cube_rot, rot);
-        render_obj_raster(my_cube, cube_pos, rot, GLM_VEC3_ONE, &my_camera, &g_backbuffer);
-
-        glm_vec3_add(cube_pos, velocity, cube_pos);
-
-        RECT rect;
-        GetClientRect(window, &rect);
-        win32_display_buffer(
-            &g_backbuffer,
-            hdc,
-            rect.right - rect.left,
-            rect.bottom - rect.top
-        );
-        ReleaseDC(window, hdc);
+        // Presented on the swapchain's thread while the next frame renders
+        swapchain_submit(g_swapchain);
+        acquire_backbuffer();
 
         TracyCFrameMarkEnd("main");
     }
 
+    swapchain_destroy(g_swapchain);
+    g_swapchain = 0;
+    render_world_free(&world);
+
     model mod;
     init_cube_mesh(&mod);
 
@@ -0,0 +1,251 @@
+#include "mesh_file.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "instance_stage.h"
+#include "tracy/TracyC.h"
+
+static void *map_file(const char *path, size_t *size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    LARGE_INTEGER length;
+    void *view = 0;
+    if (GetFileSizeEx(file, &length) && length.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping) {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // The view keeps the mapping alive
+        }
+        *size = (size_t) length.QuadPart;
+    }
+
+    CloseHandle(file);
+    return view;
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat info;
+    void *view = 0;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        view = mmap(0, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            view = 0;
+        }
+        *size = (size_t) info.st_size;
+    }
+
+    close(fd); // The mapping keeps the file alive
+    return view;
+#endif
+}
+
+static void unmap_file(void *view, const size_t size) {
+#ifdef _WIN32
+    (void) size;
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
+
+// Section [offset, offset + bytes) is aligned and inside the file
+static bool section_ok(const uint64_t offset, const uint64_t bytes, const size_t file_size) {
+    return offset % MESH_FILE_ALIGN == 0 && offset <= file_size && bytes <= file_size - offset;
+}
+
+bool mesh_file_open(const char *path, mesh_file *out) {
+    TracyCZone(mesh_file_open_tracy, true);
+
+    *out = (mesh_file){0};
+
+    size_t size = 0;
+    uint8_t *view = map_file(path, &size);
+    if (!view) {
+        TracyCZoneEnd(mesh_file_open_tracy);
+        return false;
+    }
+    out->mapping = view;
+    out->mapping_size = size;
+
+    const mesh_file_header *header = (const mesh_file_header *) view;
+    const bool header_ok = size >= sizeof(mesh_file_header) &&
+                           header->magic == MESH_FILE_MAGIC &&
+                           header->version == MESH_FILE_VERSION &&
+                           (header->index_size == 2 || header->index_size == 4) &&
+                           header->index_count % 3 == 0 &&
+                           section_ok(header->vertex_offset, (uint64_t) header->vertex_count * sizeof(vec4), size) &&
+                           section_ok(header->index_offset, (uint64_t) header->index_count * header->index_size, size) &&
+                           section_ok(header->edge_offset, (uint64_t) header->edge_count * sizeof(model_edge), size);
+    if (!header_ok) {
+        mesh_file_close(out);
+        TracyCZoneEnd(mesh_file_open_tracy);
+        return false;
+    }
+    out->header = *header;
+
+    // The renderer never writes through these, the mapping is read-only
+    model *m = &out->mesh;
+    m->vertices = (vec4 *) (view + header->vertex_offset);
+    m->vertex_count = header->vertex_count;
+    m->index_count = header->index_count;
+    m->edges = header->edge_count ? (model_edge *) (view + header->edge_offset) : 0;
+    m->edge_count = header->edge_count;
+    glm_vec4_copy(header->bounding_sphere, m->bounds);
+    m->has_bounds = true;
+
+    if (header->index_size == 4) {
+        m->indices = (uint32_t *) (view + header->index_offset);
+    } else {
+        out->widened_indices = malloc(sizeof(uint32_t) * header->index_count);
+        if (!out->widened_indices) {
+            mesh_file_close(out);
+            TracyCZoneEnd(mesh_file_open_tracy);
+            return false;
+        }
+        TracyCAlloc(out->widened_indices, sizeof(uint32_t) * header->index_count);
+
+        const uint16_t *narrow = (const uint16_t *) (view + header->index_offset);
+        bool indices_ok = true;
+        for (uint32_t i = 0; i < header->index_count; ++i) {
+            out->widened_indices[i] = narrow[i];
+            indices_ok &= narrow[i] < header->vertex_count;
+        }
+        for (uint32_t i = 0; i < m->edge_count; ++i) {
+            indices_ok &= m->edges[i].v0 < header->vertex_count && m->edges[i].v1 < header->vertex_count;
+        }
+        if (!indices_ok) {
+            mesh_file_close(out);
+            TracyCZoneEnd(mesh_file_open_tracy);
+            return false;
+        }
+        m->indices = out->widened_indices;
+    }
+
+    TracyCZoneEnd(mesh_file_open_tracy);
+    return true;
+}
+
+void mesh_file_close(mesh_file *file) {
+    if (file->widened_indices) {
+        TracyCFree(file->widened_indices);
+        free(file->widened_indices);
+    }
+    if (file->mapping) {
+        unmap_file(file->mapping, file->mapping_size);
+    }
+
+    *file = (mesh_file){0};
+}
+
+static bool write_section(FILE *file, const void *data, const size_t bytes, uint64_t *offset) {
+    // Pad up to the next section boundary
+    static const uint8_t zeros[MESH_FILE_ALIGN] = {0};
+    const uint64_t padding = (MESH_FILE_ALIGN - *offset % MESH_FILE_ALIGN) % MESH_FILE_ALIGN;
+    if (padding && fwrite(zeros, 1, padding, file) != padding) {
+        return false;
+    }
+    *offset += padding;
+
+    if (bytes && fwrite(data, 1, bytes, file) != bytes) {
+        return false;
+    }
+    *offset += bytes;
+    return true;
+}
+
+static uint64_t align_offset(const uint64_t offset) {
+    return (offset + MESH_FILE_ALIGN - 1) & ~(uint64_t) (MESH_FILE_ALIGN - 1);
+}
+
+bool mesh_file_write(const char *path, const model *m) {
+    TracyCZone(mesh_file_write_tracy, true);
+
+    mesh_file_header header = {
+        .magic = MESH_FILE_MAGIC,
+        .version = MESH_FILE_VERSION,
+        .vertex_count = m->vertex_count,
+        .index_count = m->index_count,
+        .index_size = m->vertex_count <= UINT16_MAX + 1u ? 2 : 4,
+        .edge_count = m->edges ? m->edge_count : 0,
+    };
+
+    // Files with 32-bit indices are trusted by mesh_file_open, so they are checked here
+    bool indices_ok = true;
+    for (uint32_t i = 0; i < header.index_count; ++i) {
+        indices_ok &= m->indices[i] < m->vertex_count;
+    }
+    for (uint32_t i = 0; i < header.edge_count; ++i) {
+        indices_ok &= m->edges[i].v0 < m->vertex_count && m->edges[i].v1 < m->vertex_count;
+    }
+    if (!indices_ok) {
+        TracyCZoneEnd(mesh_file_write_tracy);
+        return false;
+    }
+
+    vec4 sphere;
+    instance_stage_model_bounds(m, sphere);
+    memcpy(header.bounding_sphere, sphere, sizeof(header.bounding_sphere));
+    for (int k = 0; k < 3; ++k) {
+        header.aabb_min[k] = m->vertex_count ? m->vertices[0][k] : 0.0f;
+        header.aabb_max[k] = header.aabb_min[k];
+    }
+    for (uint32_t i = 1; i < m->vertex_count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            header.aabb_min[k] = fminf(header.aabb_min[k], m->vertices[i][k]);
+            header.aabb_max[k] = fmaxf(header.aabb_max[k], m->vertices[i][k]);
+        }
+    }
+
+    header.vertex_offset = align_offset(sizeof(mesh_file_header));
+    header.index_offset = align_offset(header.vertex_offset + (uint64_t) header.vertex_count * sizeof(vec4));
+    header.edge_offset = align_offset(header.index_offset + (uint64_t) header.index_count * header.index_size);
+
+    uint16_t *narrow = 0;
+    const void *index_data = m->indices;
+    if (header.index_size == 2) {
+        narrow = malloc(sizeof(uint16_t) * (header.index_count ? header.index_count : 1));
+        if (!narrow) {
+            TracyCZoneEnd(mesh_file_write_tracy);
+            return false;
+        }
+        for (uint32_t i = 0; i < header.index_count; ++i) {
+            narrow[i] = (uint16_t) m->indices[i];
+        }
+        index_data = narrow;
+    }
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file != 0;
+    uint64_t offset = 0;
+    ok = ok && write_section(file, &header, sizeof(header), &offset);
+    ok = ok && write_section(file, m->vertices, sizeof(vec4) * header.vertex_count, &offset);
+    ok = ok && write_section(file, index_data, (size_t) header.index_size * header.index_count, &offset);
+    ok = ok && write_section(file, m->edges, sizeof(model_edge) * header.edge_count, &offset);
+    if (file) {
+        ok = fclose(file) == 0 && ok;
+    }
+
+    free(narrow);
+    TracyCZoneEnd(mesh_file_write_tracy);
+    return ok;
+}
@@ -0,0 +1,63 @@
+#ifndef MYC23PROJECT_MESH_FILE_H
+#define MYC23PROJECT_MESH_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "renderer.h"
+
+// Binary mesh files, written offline by mesh_convert and memory-mapped at load time. Every
+// section starts on a MESH_FILE_ALIGN boundary and has the in-memory layout of the matching
+// model array, so a mapped file is used in place: no parsing, no copies.
+//
+// Layout: mesh_file_header | vertices (vec4) | indices (u16 or u32) | edges (model_edge)
+// All values are little-endian.
+
+#define MESH_FILE_MAGIC 0x4853454Du // "MESH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGN 64
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size; // 2 when every index fits in 16 bits, otherwise 4
+    uint32_t edge_count; // 0 when edges were not built
+    uint64_t vertex_offset; // Byte offsets from the start of the file
+    uint64_t index_offset;
+    uint64_t edge_offset;
+    float bounding_sphere[4]; // Center xyz, radius w, in model space
+    float aabb_min[3];
+    float aabb_max[3];
+    uint32_t reserved[10];
+} mesh_file_header;
+
+static_assert(sizeof(mesh_file_header) == 128, "mesh_file_header is part of the file format");
+static_assert(sizeof(model_edge) == 8, "model_edge is part of the file format");
+
+// A mapped mesh. mesh points into the mapping and stays valid until mesh_file_close.
+typedef struct {
+    model mesh;
+    mesh_file_header header;
+
+    void *mapping;
+    size_t mapping_size;
+    uint32_t *widened_indices; // 16-bit files only: the model wants u32, small enough to copy
+} mesh_file;
+
+// Maps path read-only and points mesh_file.mesh at it. Checks the header and that every
+// section lies inside the file. 16-bit files are read whole while widening anyway, so their
+// indices and edges are checked against vertex_count too. 32-bit index and edge values are
+// not: touching them would fault in the whole file, which is what mapping avoids, so
+// mesh_file_write refuses to write out-of-range ones instead.
+bool mesh_file_open(const char *path, mesh_file *out);
+
+void mesh_file_close(mesh_file *file);
+
+// Writes m, its edges (if built) and its bounds in the format above. Fails without writing
+// when an index or edge refers past vertex_count.
+bool mesh_file_write(const char *path, const model *m);
+
+#endif //MYC23PROJECT_MESH_FILE_H
@@ -0,0 +1,353 @@
+#include "meshlet.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracy/TracyC.h"
+
+// Vertex -> triangles adjacency in compressed rows: the triangles using vertex v are
+// triangles[offsets[v] .. offsets[v + 1]).
+typedef struct {
+    uint32_t *offsets;
+    uint32_t *triangles;
+} vertex_adjacency;
+
+static bool build_adjacency(const model *restrict m, vertex_adjacency *restrict adjacency) {
+    adjacency->offsets = calloc((size_t) m->vertex_count + 1, sizeof(uint32_t));
+    adjacency->triangles = malloc(sizeof(uint32_t) * (m->index_count ? m->index_count : 1));
+    if (!adjacency->offsets || !adjacency->triangles) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < m->index_count; ++i) {
+        adjacency->offsets[m->indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < m->vertex_count; ++v) {
+        adjacency->offsets[v + 1] += adjacency->offsets[v];
+    }
+
+    // Fill using offsets[v] as the write cursor, then shift the cursors back into offsets
+    for (uint32_t i = 0; i < m->index_count; ++i) {
+        adjacency->triangles[adjacency->offsets[m->indices[i]]++] = i / 3;
+    }
+    for (uint32_t v = m->vertex_count; v > 0; --v) {
+        adjacency->offsets[v] = adjacency->offsets[v - 1];
+    }
+    adjacency->offsets[0] = 0;
+    return true;
+}
+
+// Builder state for the meshlet being filled
+typedef struct {
+    uint32_t *stamp; // Per model vertex: meshlet number + 1 when it is in the current meshlet
+    uint8_t *local; // Per model vertex: its slot in the current meshlet
+    uint32_t vertices[MESHLET_MAX_VERTICES]; // Model vertex of each slot
+    uint8_t indices[MESHLET_MAX_TRIANGLES * 3];
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+    uint32_t number;
+} meshlet_builder;
+
+static inline uint32_t new_vertex_count(const meshlet_builder *restrict b, const uint32_t *restrict tri) {
+    return (b->stamp[tri[0]] != b->number + 1) + (b->stamp[tri[1]] != b->number + 1) +
+           (b->stamp[tri[2]] != b->number + 1);
+}
+
+static inline bool fits(const meshlet_builder *restrict b, const uint32_t *restrict tri) {
+    return b->triangle_count < MESHLET_MAX_TRIANGLES &&
+           b->vertex_count + new_vertex_count(b, tri) <= MESHLET_MAX_VERTICES;
+}
+
+static void add_triangle(meshlet_builder *restrict b, const uint32_t *restrict tri) {
+    for (int k = 0; k < 3; ++k) {
+        const uint32_t v = tri[k];
+        if (b->stamp[v] != b->number + 1) {
+            b->stamp[v] = b->number + 1;
+            b->local[v] = (uint8_t) b->vertex_count;
+            b->vertices[b->vertex_count++] = v;
+        }
+        b->indices[b->triangle_count * 3 + k] = b->local[v];
+    }
+    b->triangle_count++;
+}
+
+// Bounding sphere and normal cone of the builder's triangles, then copies it out.
+static void emit_meshlet(const model *restrict m, meshlet_builder *restrict b, model_meshlets *restrict out) {
+    meshlet *ml = &out->meshlets[out->meshlet_count++];
+    ml->vertex_offset = out->vertex_count;
+    ml->index_offset = out->index_count;
+    ml->vertex_count = b->vertex_count;
+    ml->triangle_count = b->triangle_count;
+
+    vec4 *restrict vertices = out->vertices + out->vertex_count;
+    for (uint32_t i = 0; i < b->vertex_count; ++i) {
+        glm_vec4_copy(m->vertices[b->vertices[i]], vertices[i]);
+    }
+    if (out->attributes) {
+        const uint32_t count = out->attribute_count;
+        float *restrict attributes = out->attributes + (size_t) out->vertex_count * count;
+        for (uint32_t i = 0; i < b->vertex_count; ++i) {
+            memcpy(attributes + i * count, m->attributes + (size_t) b->vertices[i] * count, count * sizeof(float));
+        }
+    }
+    memcpy(out->indices + out->index_count, b->indices, (size_t) b->triangle_count * 3);
+    out->vertex_count += b->vertex_count;
+    out->index_count += b->triangle_count * 3;
+
+    // Sphere around the AABB center
+    vec3 lo, hi, center;
+    glm_vec3_copy(vertices[0], lo);
+    glm_vec3_copy(vertices[0], hi);
+    for (uint32_t i = 1; i < b->vertex_count; ++i) {
+        glm_vec3_minv(lo, vertices[i], lo);
+        glm_vec3_maxv(hi, vertices[i], hi);
+    }
+    glm_vec3_center(lo, hi, center);
+    float radius_sq = 0.0f;
+    for (uint32_t i = 0; i < b->vertex_count; ++i) {
+        radius_sq = fmaxf(radius_sq, glm_vec3_distance2(center, vertices[i]));
+    }
+    glm_vec3_copy(center, ml->center);
+    ml->radius = sqrtf(radius_sq);
+
+    // Front faces are clockwise, so the outward normal is (v2 - v0) x (v1 - v0)
+    vec3 normals[MESHLET_MAX_TRIANGLES];
+    uint32_t normal_count = 0;
+    vec3 axis = GLM_VEC3_ZERO_INIT;
+    for (uint32_t t = 0; t < b->triangle_count; ++t) {
+        const uint8_t *tri = &b->indices[t * 3];
+        vec3 e1, e2;
+        glm_vec3_sub(vertices[tri[2]], vertices[tri[0]], e1);
+        glm_vec3_sub(vertices[tri[1]], vertices[tri[0]], e2);
+        glm_vec3_cross(e1, e2, normals[normal_count]);
+
+        const float length = glm_vec3_norm(normals[normal_count]);
+        if (length > 0.0f) {
+            glm_vec3_scale(normals[normal_count], 1.0f / length, normals[normal_count]);
+            glm_vec3_add(axis, normals[normal_count], axis);
+            normal_count++;
+        }
+    }
+
+    // Degenerate clusters and clusters whose normals span a hemisphere cannot be cone culled
+    ml->cone_cutoff = 2.0f;
+    glm_vec3_zero(ml->cone_axis);
+    const float axis_length = glm_vec3_norm(axis);
+    if (normal_count > 0 && axis_length > 0.0f) {
+        glm_vec3_scale(axis, 1.0f / axis_length, axis);
+
+        float min_dot = 1.0f;
+        for (uint32_t t = 0; t < normal_count; ++t) {
+            min_dot = fminf(min_dot, glm_vec3_dot(normals[t], axis));
+        }
+        if (min_dot > 0.0f) {
+            glm_vec3_copy(axis, ml->cone_axis);
+            ml->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+        }
+    }
+
+    b->vertex_count = 0;
+    b->triangle_count = 0;
+    b->number++;
+}
+
+// The adjacent, not yet emitted triangle that adds the fewest new vertices to the meshlet,
+// looking around the given vertices. UINT32_MAX when there is none.
+static uint32_t best_neighbor(const model *restrict m, const vertex_adjacency *restrict adjacency,
+                              const bool *restrict emitted, const meshlet_builder *restrict b,
+                              const uint32_t *restrict around, const uint32_t around_count) {
+    uint32_t best = UINT32_MAX;
+    uint32_t best_cost = UINT32_MAX;
+    for (uint32_t i = 0; i < around_count; ++i) {
+        const uint32_t v = around[i];
+        for (uint32_t a = adjacency->offsets[v]; a < adjacency->offsets[v + 1]; ++a) {
+            const uint32_t t = adjacency->triangles[a];
+            if (emitted[t]) {
+                continue;
+            }
+
+            const uint32_t cost = new_vertex_count(b, &m->indices[t * 3]);
+            if (cost < best_cost) {
+                best = t;
+                best_cost = cost;
+                if (cost == 0) {
+                    return best;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+bool model_build_meshlets(model *m) {
+    TracyCZone(build_meshlets_tracy, true);
+
+    model_free_meshlets(m);
+
+    const uint32_t triangle_count = m->index_count / 3;
+    if (triangle_count == 0) {
+        TracyCZoneEnd(build_meshlets_tracy);
+        return false;
+    }
+
+    vertex_adjacency adjacency = {0};
+    meshlet_builder *b = calloc(1, sizeof(meshlet_builder));
+    bool *emitted = calloc(triangle_count, sizeof(bool));
+    model_meshlets *out = calloc(1, sizeof(model_meshlets));
+    bool ok = b && emitted && out && build_adjacency(m, &adjacency);
+    if (ok) {
+        b->stamp = calloc(m->vertex_count, sizeof(uint32_t));
+        b->local = malloc(m->vertex_count);
+
+        // Worst cases: one triangle per meshlet, no shared vertices. Shrunk at the end.
+        out->meshlets = malloc(sizeof(meshlet) * triangle_count);
+        out->vertices = malloc(sizeof(vec4) * triangle_count * 3);
+        out->indices = malloc((size_t) triangle_count * 3);
+        ok = b->stamp && b->local && out->meshlets && out->vertices && out->indices;
+
+        if (ok && m->attributes && m->attribute_count) {
+            out->attribute_count = m->attribute_count;
+            out->attributes = malloc(sizeof(float) * m->attribute_count * triangle_count * 3);
+            ok = out->attributes != 0;
+        }
+    }
+
+    if (ok) {
+        uint32_t next_seed = 0; // Every triangle before it has been emitted
+        uint32_t emitted_count = 0;
+        uint32_t last = UINT32_MAX; // Last triangle added to the current meshlet
+
+        while (emitted_count < triangle_count) {
+            // Grow around the last triangle, then around the whole meshlet, then jump to the
+            // next triangle in index order.
+            uint32_t next = UINT32_MAX;
+            if (last != UINT32_MAX) {
+                next = best_neighbor(m, &adjacency, emitted, b, &m->indices[last * 3], 3);
+                if (next == UINT32_MAX) {
+                    next = best_neighbor(m, &adjacency, emitted, b, b->vertices, b->vertex_count);
+                }
+            }
+            if (next == UINT32_MAX) {
+                while (emitted[next_seed]) {
+                    next_seed++;
+                }
+                next = next_seed;
+            }
+
+            const uint32_t *tri = &m->indices[next * 3];
+            if (!fits(b, tri)) {
+                emit_meshlet(m, b, out);
+            }
+            add_triangle(b, tri);
+            emitted[next] = true;
+            emitted_count++;
+            last = next;
+        }
+        if (b->triangle_count) {
+            emit_meshlet(m, b, out);
+        }
+    }
+
+    if (b) {
+        free(b->stamp);
+        free(b->local);
+    }
+    free(b);
+    free(emitted);
+    free(adjacency.offsets);
+    free(adjacency.triangles);
+
+    if (!ok) {
+        if (out) {
+            free(out->meshlets);
+            free(out->vertices);
+            free(out->indices);
+            free(out->attributes);
+        }
+        free(out);
+        TracyCZoneEnd(build_meshlets_tracy);
+        return false;
+    }
+
+    // Give back the worst-case slack
+    meshlet *meshlets = realloc(out->meshlets, sizeof(meshlet) * out->meshlet_count);
+    vec4 *vertices = realloc(out->vertices, sizeof(vec4) * out->vertex_count);
+    uint8_t *indices = realloc(out->indices, out->index_count);
+    out->meshlets = meshlets ? meshlets : out->meshlets;
+    out->vertices = vertices ? vertices : out->vertices;
+    out->indices = indices ? indices : out->indices;
+    TracyCAlloc(out->meshlets, sizeof(meshlet) * out->meshlet_count);
+    TracyCAlloc(out->vertices, sizeof(vec4) * out->vertex_count);
+    TracyCAlloc(out->indices, out->index_count);
+    if (out->attributes) {
+        const size_t attribute_bytes = sizeof(float) * out->attribute_count * out->vertex_count;
+        float *attributes = realloc(out->attributes, attribute_bytes);
+        out->attributes = attributes ? attributes : out->attributes;
+        TracyCAlloc(out->attributes, attribute_bytes);
+    }
+
+    m->meshlets = out;
+    TracyCZoneEnd(build_meshlets_tracy);
+    return true;
+}
+
+void model_free_meshlets(model *m) {
+    model_meshlets *meshlets = m->meshlets;
+    if (!meshlets) {
+        return;
+    }
+
+    TracyCFree(meshlets->meshlets);
+    TracyCFree(meshlets->vertices);
+    TracyCFree(meshlets->indices);
+    free(meshlets->meshlets);
+    free(meshlets->vertices);
+    free(meshlets->indices);
+    if (meshlets->attributes) {
+        TracyCFree(meshlets->attributes);
+        free(meshlets->attributes);
+    }
+    free(meshlets);
+    m->meshlets = 0;
+}
+
+void meshlet_cull_view_from_mvp(const mat4 mvp, meshlet_cull_view *view) {
+    mat4 m;
+    glm_mat4_copy((vec4 *) mvp, m);
+    glm_frustum_planes(m, view->planes);
+
+    // A perspective projection maps the eye to the clip-space direction (0, 0, 1, 0), so the
+    // eye in model space is the third column of the inverse MVP, dehomogenized.
+    mat4 inverse;
+    glm_mat4_inv(m, inverse);
+    const float w = inverse[2][3];
+    view->has_eye = fabsf(w) > 1e-12f;
+    if (view->has_eye) {
+        glm_vec3_scale(inverse[2], 1.0f / w, view->eye);
+    }
+}
+
+bool meshlet_is_culled(const meshlet *restrict ml, const meshlet_cull_view *restrict view) {
+    for (int p = 0; p < 6; ++p) {
+        const float *plane = view->planes[p];
+        const float distance = plane[0] * ml->center[0] + plane[1] * ml->center[1] + plane[2] * ml->center[2] +
+                               plane[3];
+        if (distance < -ml->radius) {
+            return true;
+        }
+    }
+
+    // Every normal is within the cone, so every triangle faces away when the whole sphere sees
+    // the cone from behind: dot(c - eye, axis) >= cutoff * |c - eye| + radius.
+    if (ml->cone_cutoff <= 1.0f && view->has_eye) {
+        vec3 to_center;
+        glm_vec3_sub((float *) ml->center, (float *) view->eye, to_center);
+        const float distance = glm_vec3_norm(to_center);
+        if (glm_vec3_dot(to_center, (float *) ml->cone_axis) >= ml->cone_cutoff * distance + ml->radius) {
+            return true;
+        }
+    }
+
+    return false;
+}
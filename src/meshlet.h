@@ -0,0 +1,63 @@
+#ifndef MYC23PROJECT_MESHLET_H
+#define MYC23PROJECT_MESHLET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "renderer.h"
+
+// Cluster limits. 124 triangles keeps the local index data of a full meshlet at 372 bytes, and
+// 64 vertices is 8 iterations of the vertex stage.
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A small cluster of connected triangles with what is needed to reject it before any vertex
+// work: a bounding sphere for the frustum and a cone bounding the triangle normals.
+typedef struct {
+    float center[3];
+    float radius;
+    float cone_axis[3]; // Average outward normal, normalized
+    float cone_cutoff; // sin of the cone's half angle; > 1 when the normals span a hemisphere
+    uint32_t vertex_offset; // Into model_meshlets.vertices
+    uint32_t index_offset; // Into model_meshlets.indices, 3 per triangle
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+} meshlet;
+
+// Meshlet vertices are copies of the model's positions, stored contiguously per meshlet, so
+// a surviving meshlet goes through the vertex stage as-is. Vertices on cluster borders are
+// stored once per cluster that uses them. The model's attributes, if any, are copied the same way.
+struct model_meshlets {
+    meshlet *meshlets;
+    uint32_t meshlet_count;
+    vec4 *vertices;
+    uint32_t vertex_count;
+    uint8_t *indices; // Meshlet-local vertex numbers
+    uint32_t index_count;
+    float *attributes; // attribute_count per vertex, parallel to vertices. 0 when the model had none.
+    uint32_t attribute_count;
+};
+
+// Builds m->meshlets from its indices. Clusters grow through shared vertices, so they stay
+// compact even when the index buffer is not ordered spatially. Set m->attributes first: they
+// are copied into the meshlets at build time.
+bool model_build_meshlets(model *m);
+
+void model_free_meshlets(model *m);
+
+// Per-draw cluster culling. The frustum planes and eye position are in model space, taken from
+// the draw's MVP, so the same tests work for plain and instanced draws.
+typedef struct {
+    vec4 planes[6];
+    vec3 eye;
+    bool has_eye; // false for projections without a finite eye, which disables cone culling
+} meshlet_cull_view;
+
+void meshlet_cull_view_from_mvp(const mat4 mvp, meshlet_cull_view *view);
+
+// True when the meshlet is entirely outside the frustum or every triangle in it faces away
+// from the eye.
+bool meshlet_is_culled(const meshlet *restrict ml, const meshlet_cull_view *restrict view);
+
+#endif //MYC23PROJECT_MESHLET_H
@@ -0,0 +1,182 @@
+#include "obj_import.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tracy/TracyC.h"
+
+static bool grow(void **array, uint32_t *capacity, const uint32_t needed, const size_t element_size) {
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    uint32_t new_capacity = *capacity ? *capacity : 1024;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    void *grown = realloc(*array, element_size * new_capacity);
+    if (!grown) {
+        return false;
+    }
+
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Whole file, NUL terminated
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+
+    char *text = 0;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        const long length = ftell(file);
+        if (length >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            text = malloc((size_t) length + 1);
+            if (text && fread(text, 1, (size_t) length, file) == (size_t) length) {
+                text[length] = '\0';
+            } else {
+                free(text);
+                text = 0;
+            }
+        }
+    }
+
+    fclose(file);
+    return text;
+}
+
+static inline bool is_blank(const char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *skip_blanks(const char *p) {
+    while (is_blank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static inline const char *next_line(const char *p) {
+    while (*p && *p != '\n') {
+        ++p;
+    }
+    return *p ? p + 1 : p;
+}
+
+// Resolves a 1-based (or negative, relative) OBJ index. Returns false when out of range.
+static inline bool resolve_index(const long index, const uint32_t vertex_count, uint32_t *out) {
+    const long resolved = index > 0 ? index - 1 : (long) vertex_count + index;
+    if (index == 0 || resolved < 0 || resolved >= (long) vertex_count) {
+        return false;
+    }
+    *out = (uint32_t) resolved;
+    return true;
+}
+
+bool obj_import(const char *path, model *out) {
+    TracyCZone(obj_import_tracy, true);
+
+    *out = (model){0};
+
+    char *text = read_file(path);
+    if (!text) {
+        TracyCZoneEnd(obj_import_tracy);
+        return false;
+    }
+
+    vec4 *vertices = 0;
+    uint32_t vertex_count = 0, vertex_capacity = 0;
+    uint32_t *indices = 0;
+    uint32_t index_count = 0, index_capacity = 0;
+    bool ok = true;
+
+    for (const char *line = text; *line && ok; line = next_line(line)) {
+        const char *p = skip_blanks(line);
+
+        if (p[0] == 'v' && is_blank(p[1])) {
+            if (!grow((void **) &vertices, &vertex_capacity, vertex_count + 1, sizeof(vec4))) {
+                ok = false;
+                break;
+            }
+
+            char *end;
+            float *v = vertices[vertex_count++];
+            v[0] = strtof(p + 1, &end);
+            v[1] = strtof(end, &end);
+            v[2] = strtof(end, &end);
+            v[3] = 1.0f; // Homogeneous w in the file is for rational curves, not positions
+        } else if (p[0] == 'f' && is_blank(p[1])) {
+            // Fan around the first corner: (first, previous, current)
+            uint32_t first = 0, previous = 0;
+            uint32_t corner_count = 0;
+
+            p += 1;
+            for (;;) {
+                p = skip_blanks(p);
+                if (*p == '\n' || *p == '\0') {
+                    break;
+                }
+
+                char *end;
+                const long index = strtol(p, &end, 10);
+                if (end == p) {
+                    break;
+                }
+
+                uint32_t current;
+                if (!resolve_index(index, vertex_count, &current)) {
+                    ok = false;
+                    break;
+                }
+
+                // Skip the /texture/normal part of the corner
+                p = end;
+                while (*p && !is_blank(*p) && *p != '\n') {
+                    ++p;
+                }
+
+                if (corner_count == 0) {
+                    first = current;
+                } else if (corner_count >= 2) {
+                    if (!grow((void **) &indices, &index_capacity, index_count + 3, sizeof(uint32_t))) {
+                        ok = false;
+                        break;
+                    }
+                    indices[index_count++] = first;
+                    indices[index_count++] = current;
+                    indices[index_count++] = previous;
+                }
+                previous = current;
+                corner_count++;
+            }
+        }
+    }
+
+    free(text);
+
+    if (!ok || vertex_count == 0 || index_count == 0) {
+        free(vertices);
+        free(indices);
+        TracyCZoneEnd(obj_import_tracy);
+        return false;
+    }
+
+    // Give back the growth slack
+    vec4 *shrunk_vertices = realloc(vertices, sizeof(vec4) * vertex_count);
+    uint32_t *shrunk_indices = realloc(indices, sizeof(uint32_t) * index_count);
+    out->vertices = shrunk_vertices ? shrunk_vertices : vertices;
+    out->indices = shrunk_indices ? shrunk_indices : indices;
+    out->vertex_count = vertex_count;
+    out->index_count = index_count;
+    TracyCAlloc(out->vertices, sizeof(vec4) * vertex_count);
+    TracyCAlloc(out->indices, sizeof(uint32_t) * index_count);
+    model_build_bounds(out);
+
+    TracyCZoneEnd(obj_import_tracy);
+    return true;
+}
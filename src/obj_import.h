@@ -0,0 +1,14 @@
+#ifndef MYC23PROJECT_OBJ_IMPORT_H
+#define MYC23PROJECT_OBJ_IMPORT_H
+
+#include <stdbool.h>
+
+#include "renderer.h"
+
+// Reads the positions and faces of a Wavefront OBJ file into a heap-allocated model (free it
+// with model_free). Polygons are fanned into triangles and texture/normal references are
+// ignored. OBJ faces are counter-clockwise while the renderer's front faces are clockwise, so
+// every triangle is emitted with its winding reversed. Edges are not built.
+bool obj_import(const char *path, model *out);
+
+#endif //MYC23PROJECT_OBJ_IMPORT_H
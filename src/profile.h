@@ -0,0 +1,18 @@
+#ifndef MYC23PROJECT_PROFILE_H
+#define MYC23PROJECT_PROFILE_H
+
+#include "tracy/TracyC.h"
+
+// Zones opened once per triangle cost more than the stages they time when triangles are small,
+// so they are only compiled in with RENDERER_FINE_ZONES (the CMake option of the same name).
+// The default build keeps the per-draw and per-tile zones, and reports what each stage did
+// through renderer_get_stats and the Tracy plots instead.
+#ifdef RENDERER_FINE_ZONES
+#define PROFILE_FINE_ZONE(ctx, name) TracyCZoneN(ctx, name, true)
+#define PROFILE_FINE_ZONE_END(ctx) TracyCZoneEnd(ctx)
+#else
+#define PROFILE_FINE_ZONE(ctx, name)
+#define PROFILE_FINE_ZONE_END(ctx)
+#endif
+
+#endif //MYC23PROJECT_PROFILE_H
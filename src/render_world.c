@@ -0,0 +1,240 @@
+#include "render_world.h"
+
+#include <math.h>
+
+#include "instance_stage.h"
+#include "lod.h"
+#include "tracy/TracyC.h"
+
+ECS_COMPONENT_DECLARE(Transform);
+ECS_COMPONENT_DECLARE(Velocity);
+ECS_COMPONENT_DECLARE(Renderable);
+ECS_COMPONENT_DECLARE(Bounds);
+ECS_COMPONENT_DECLARE(WorldMatrix);
+
+static void integrate_system(ecs_iter_t *it) {
+    TracyCZoneN(integrate_tracy, "Integrate", true);
+
+    const render_world *w = it->ctx;
+    Transform *transforms = ecs_field(it, Transform, 0);
+    Velocity *velocities = ecs_field(it, Velocity, 1);
+    const float dt = it->delta_time;
+
+    for (int32_t i = 0; i < it->count; ++i) {
+        Transform *t = &transforms[i];
+        Velocity *v = &velocities[i];
+
+        glm_vec3_muladds(v->linear, dt, t->position);
+        if (w->bounce_extent > 0.0f) {
+            for (int k = 0; k < 3; ++k) {
+                if ((t->position[k] > w->bounce_extent && v->linear[k] > 0.0f) ||
+                    (t->position[k] < -w->bounce_extent && v->linear[k] < 0.0f)) {
+                    v->linear[k] = -v->linear[k];
+                }
+            }
+        }
+
+        const float speed = glm_vec3_norm(v->angular);
+        if (speed > 0.0f) {
+            versor step;
+            glm_quat(step, speed * dt, v->angular[0], v->angular[1], v->angular[2]);
+            glm_quat_mul(step, t->rotation, t->rotation);
+            glm_quat_normalize(t->rotation);
+        }
+    }
+
+    TracyCZoneEnd(integrate_tracy);
+}
+
+// T * R * S, the same model matrix the render_obj* functions build
+static void world_matrix_system(ecs_iter_t *it) {
+    TracyCZoneN(world_matrix_tracy, "WorldMatrix", true);
+
+    const Transform *transforms = ecs_field(it, Transform, 0);
+    WorldMatrix *matrices = ecs_field(it, WorldMatrix, 1);
+
+    for (int32_t i = 0; i < it->count; ++i) {
+        const Transform *t = &transforms[i];
+        mat4 *m = &matrices[i].matrix;
+
+        glm_quat_mat4((float *) t->rotation, *m);
+        glm_vec4_scale((*m)[0], t->scale[0], (*m)[0]);
+        glm_vec4_scale((*m)[1], t->scale[1], (*m)[1]);
+        glm_vec4_scale((*m)[2], t->scale[2], (*m)[2]);
+        glm_vec3_copy((float *) t->position, (*m)[3]);
+    }
+
+    TracyCZoneEnd(world_matrix_tracy);
+}
+
+// Same sphere test as instance_stage_batch: the world center against every plane, the radius
+// grown by the largest scale axis
+static void cull_system(ecs_iter_t *it) {
+    TracyCZoneN(cull_tracy, "Cull", true);
+
+    const render_world *w = it->ctx;
+    const Transform *transforms = ecs_field(it, Transform, 0);
+    const WorldMatrix *matrices = ecs_field(it, WorldMatrix, 1);
+    Bounds *bounds = ecs_field(it, Bounds, 2);
+
+    for (int32_t i = 0; i < it->count; ++i) {
+        const float *scale = transforms[i].scale;
+        const float max_scale = fmaxf(fabsf(scale[0]), fmaxf(fabsf(scale[1]), fabsf(scale[2])));
+        const float radius = bounds[i].sphere[3] * max_scale;
+
+        vec3 center;
+        glm_mat4_mulv3((vec4 *) matrices[i].matrix, bounds[i].sphere, 1.0f, center);
+
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; ++p) {
+            visible = glm_vec3_dot((float *) w->planes[p], center) + w->planes[p][3] >= -radius;
+        }
+        bounds[i].visible = visible;
+    }
+
+    TracyCZoneEnd(cull_tracy);
+}
+
+static void draw_system(ecs_iter_t *it) {
+    TracyCZoneN(draw_tracy, "Draw", true);
+
+    render_world *w = it->ctx;
+    Transform *transforms = ecs_field(it, Transform, 0);
+    Renderable *renderables = ecs_field(it, Renderable, 1);
+    const Bounds *bounds = ecs_field(it, Bounds, 2);
+
+    for (int32_t i = 0; i < it->count; ++i) {
+        if (!bounds[i].visible) {
+            continue;
+        }
+        Transform *t = &transforms[i];
+        Renderable *r = &renderables[i];
+        if (w->viewport_height > 0) {
+            r->lod = lod_select(r->mesh, w->cam, w->viewport_height, t->position, t->rotation, t->scale, r->lod);
+        }
+        command_buffer_draw(&w->commands, RENDER_PIPELINE_RASTER, 0, model_lod(r->mesh, r->lod), t->position,
+                            t->rotation, t->scale);
+        w->visible_count++;
+    }
+
+    TracyCZoneEnd(draw_tracy);
+}
+
+bool render_world_init(render_world *w, const uint32_t thread_count) {
+    TracyCZone(render_world_init_tracy, true);
+
+    *w = (render_world){0};
+    w->ecs = ecs_init();
+    if (!w->ecs) {
+        TracyCZoneEnd(render_world_init_tracy);
+        return false;
+    }
+
+    ECS_COMPONENT_DEFINE(w->ecs, Transform);
+    ECS_COMPONENT_DEFINE(w->ecs, Velocity);
+    ECS_COMPONENT_DEFINE(w->ecs, Renderable);
+    ECS_COMPONENT_DEFINE(w->ecs, Bounds);
+    ECS_COMPONENT_DEFINE(w->ecs, WorldMatrix);
+
+    ecs_system(w->ecs, {
+        .entity = ecs_entity(w->ecs, {.name = "Integrate", .add = ecs_ids(ecs_dependson(EcsOnUpdate))}),
+        .query.terms = {
+            {.id = ecs_id(Transform), .inout = EcsInOut},
+            {.id = ecs_id(Velocity), .inout = EcsInOut},
+        },
+        .callback = integrate_system,
+        .ctx = w,
+        .multi_threaded = true,
+    });
+
+    ecs_system(w->ecs, {
+        .entity = ecs_entity(w->ecs, {.name = "WorldMatrix", .add = ecs_ids(ecs_dependson(EcsPostUpdate))}),
+        .query.terms = {
+            {.id = ecs_id(Transform), .inout = EcsIn},
+            {.id = ecs_id(WorldMatrix), .inout = EcsOut},
+        },
+        .callback = world_matrix_system,
+        .multi_threaded = true,
+    });
+
+    ecs_system(w->ecs, {
+        .entity = ecs_entity(w->ecs, {.name = "Cull", .add = ecs_ids(ecs_dependson(EcsPreStore))}),
+        .query.terms = {
+            {.id = ecs_id(Transform), .inout = EcsIn},
+            {.id = ecs_id(WorldMatrix), .inout = EcsIn},
+            {.id = ecs_id(Bounds), .inout = EcsInOut},
+        },
+        .callback = cull_system,
+        .ctx = w,
+        .multi_threaded = true,
+    });
+
+    // Not multi_threaded: runs on the thread calling ecs_progress, after the workers are done
+    // with the phases above
+    ecs_system(w->ecs, {
+        .entity = ecs_entity(w->ecs, {.name = "Draw", .add = ecs_ids(ecs_dependson(EcsOnStore))}),
+        .query.terms = {
+            {.id = ecs_id(Transform), .inout = EcsIn},
+            {.id = ecs_id(Renderable), .inout = EcsInOut},
+            {.id = ecs_id(Bounds), .inout = EcsIn},
+        },
+        .callback = draw_system,
+        .ctx = w,
+    });
+
+    if (thread_count > 1) {
+        ecs_set_threads(w->ecs, (int32_t) thread_count);
+    }
+
+    TracyCZoneEnd(render_world_init_tracy);
+    return true;
+}
+
+void render_world_free(render_world *w) {
+    if (w->ecs) {
+        ecs_fini(w->ecs);
+    }
+    command_buffer_free(&w->commands);
+    *w = (render_world){0};
+}
+
+ecs_entity_t render_world_spawn(render_world *w, const model *mesh, vec3 pos, versor rot, vec3 scale,
+                                vec3 linear, vec3 angular) {
+    Transform transform;
+    glm_vec3_copy(pos, transform.position);
+    glm_quat_copy(rot, transform.rotation);
+    glm_vec3_copy(scale, transform.scale);
+
+    Velocity velocity;
+    glm_vec3_copy(linear, velocity.linear);
+    glm_vec3_copy(angular, velocity.angular);
+
+    Bounds bounds = {.visible = false};
+    instance_stage_model_bounds(mesh, bounds.sphere);
+
+    const ecs_entity_t e = ecs_new(w->ecs);
+    ecs_set_ptr(w->ecs, e, Transform, &transform);
+    ecs_set_ptr(w->ecs, e, Velocity, &velocity);
+    ecs_set(w->ecs, e, Renderable, {.mesh = mesh});
+    ecs_set_ptr(w->ecs, e, Bounds, &bounds);
+    ecs_add(w->ecs, e, WorldMatrix);
+    return e;
+}
+
+uint32_t render_world_progress(render_world *w, camera *restrict cam, const float delta_time) {
+    TracyCZone(render_world_progress_tracy, true);
+
+    mat4 pv;
+    glm_mat4_copy(*camera_get_pv_matrix(cam), pv);
+    glm_frustum_planes(pv, w->planes);
+    w->cam = cam;
+    w->visible_count = 0;
+    ecs_progress(w->ecs, delta_time);
+
+    TracyCZoneEnd(render_world_progress_tracy);
+    return w->visible_count;
+}
+
+void render_world_submit(render_world *w, camera *restrict cam, graphics_buffer *restrict buff) {
+    command_buffer_submit(&w->commands, cam, buff);
+}
@@ -0,0 +1,86 @@
+#ifndef MYC23PROJECT_RENDER_WORLD_H
+#define MYC23PROJECT_RENDER_WORLD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "command_buffer.h"
+#include "flecs.h"
+#include "renderer.h"
+
+// Components of drawable entities. Named like flecs components rather than like the renderer's
+// types: these names are what the flecs explorer and queries show.
+typedef struct {
+    vec3 position;
+    versor rotation;
+    vec3 scale;
+} Transform;
+
+typedef struct {
+    vec3 linear; // Units per second
+    vec3 angular; // World-space axis scaled by radians per second
+} Velocity;
+
+typedef struct {
+    const model *mesh; // Not owned, must outlive the entity
+    uint32_t lod; // Level of mesh Draw recorded last, see lod_select
+} Renderable;
+
+// Model-space bounding sphere, and what the Cull system made of it this frame
+typedef struct {
+    vec4 sphere; // Center xyz, radius w, from instance_stage_model_bounds
+    bool visible;
+} Bounds;
+
+// Model to world, built from Transform every frame by the WorldMatrix system
+typedef struct {
+    mat4 matrix;
+} WorldMatrix;
+
+extern ECS_COMPONENT_DECLARE(Transform);
+extern ECS_COMPONENT_DECLARE(Velocity);
+extern ECS_COMPONENT_DECLARE(Renderable);
+extern ECS_COMPONENT_DECLARE(Bounds);
+extern ECS_COMPONENT_DECLARE(WorldMatrix);
+
+// A flecs world whose pipeline moves, culls and records the draws of its entities:
+//   Integrate    OnUpdate    Transform += Velocity * dt, bouncing off the bounce box
+//   WorldMatrix  PostUpdate  WorldMatrix from Transform
+//   Cull         PreStore    Bounds.visible from the world-space sphere and the frustum
+//   Draw         OnStore     command_buffer_draw for every visible entity, at its LOD
+// The first three run on flecs' worker threads, split over the matched entities. Draw runs on
+// the thread calling render_world_progress, since draws are recorded from one thread. The
+// systems keep a pointer to the render_world: it must not move after render_world_init.
+typedef struct {
+    ecs_world_t *ecs;
+    command_buffer commands; // Recorded by Draw, executed by render_world_submit
+    float bounce_extent; // > 0: entities bounce inside the [-extent, extent] cube
+    uint32_t viewport_height; // > 0: Draw picks levels of meshes with LODs for this many pixels
+
+    // Per frame, read by the systems
+    camera *cam; // Given to render_world_progress
+    vec4 planes[6]; // Its frustum
+    uint32_t visible_count; // Entities Draw recorded
+} render_world;
+
+// Creates the world, its components and systems, with thread_count worker threads (1 = run
+// every system on the calling thread).
+bool render_world_init(render_world *w, uint32_t thread_count);
+
+void render_world_free(render_world *w);
+
+// A drawable entity. Its Bounds come from instance_stage_model_bounds: the mesh's cached
+// model.bounds, or a pass over its vertices for models without them.
+ecs_entity_t render_world_spawn(render_world *w, const model *mesh, vec3 pos, versor rot, vec3 scale,
+                                vec3 linear, vec3 angular);
+
+// Runs the pipeline once: delta_time seconds of movement (0 = measured by flecs), then culling
+// against cam and recording. Returns the number of draws recorded.
+uint32_t render_world_progress(render_world *w, camera *restrict cam, float delta_time);
+
+// Executes the draws recorded by the last render_world_progress. Between renderer_begin_frame
+// and renderer_end_frame, like any render_obj* call.
+void render_world_submit(render_world *w, camera *restrict cam, graphics_buffer *restrict buff);
+
+#endif //MYC23PROJECT_RENDER_WORLD_H
@@ -1,27 +1,21 @@
 ﻿#include "renderer.h"
 
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include "tracy/TracyC.h"
-
-#define OUTCODE_RIGHT  1  // 000001
-#define OUTCODE_LEFT   2  // 000010
-#define OUTCODE_TOP    4  // 000100
-#define OUTCODE_BOTTOM 8  // 001000
-#define OUTCODE_FAR    16 // 010000
-#define OUTCODE_NEAR   32 // 100000
-
-static inline int32_t compute_outcode(const vec3 v) {
-    int code = 0;
-    if (v[0] > 1.0f) code |= OUTCODE_RIGHT;
-    if (v[0] < -1.0f) code |= OUTCODE_LEFT;
-    if (v[1] > 1.0f) code |= OUTCODE_TOP;
-    if (v[1] < -1.0f) code |= OUTCODE_BOTTOM;
-    if (v[2] > 1.0f) code |= OUTCODE_FAR;
-    if (v[2] < -1.0f) code |= OUTCODE_NEAR;
+#include "arena.h"
+#include "clip_stage.h"
+#include "instance_stage.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "profile.h"
+#include "thread_pool.h"
+#include "vertex_stage.h"
+#include "simde/x86/avx2.h"
 
-    return code;
-}
+#include "tracy/TracyC.h"
 
 #define max(a,b)             \
 ({                           \
@@ -37,86 +31,1018 @@ __typeof__ (b) _b = (b); \
 _a < _b ? _a : _b;       \
 })
 
-static inline void get_raster_triangle_AABB(const vec3 vone, const vec3 vtwo, const vec3 vthree, ivec4 dest) {
-    const int32_t x0 = (int32_t) (vone[0] + 0.5f);
-    const int32_t y0 = (int32_t) (vone[1] + 0.5f);
-    const int32_t x1 = (int32_t) (vtwo[0] + 0.5f);
-    const int32_t y1 = (int32_t) (vtwo[1] + 0.5f);
-    const int32_t x2 = (int32_t) (vthree[0] + 0.5f);
-    const int32_t y2 = (int32_t) (vthree[1] + 0.5f);
+// --- Fixed-point coverage ---
+// Vertices are snapped to 28.4 fixed point (RASTER_SUBPIXEL_BITS) and pixels are sampled at
+// their centers, so coverage no longer depends on where the float coordinates were truncated.
+// Edge functions of 28.4 inputs are 24.8 values that can exceed 32 bits for large triangles,
+// so they are evaluated in 64-bit once per Hi-Z block. Inside a block everything steps in
+// 32-bit: an edge that straddles the block varies by at most 8 pixels' worth of steps there,
+// and an edge that contains the whole block is dropped from the per-pixel test entirely.
+//
+// Ties follow the top-left rule: a pixel center exactly on an edge belongs to the triangle only
+// if that is a top or left edge. Non top-left edges get a bias of -1, which turns their
+// "w == 0" into "outside", so pixels on an edge shared by two triangles are written once.
+
+#define RASTER_SUBPIXEL_ONE (1 << RASTER_SUBPIXEL_BITS)
+#define RASTER_SUBPIXEL_HALF (RASTER_SUBPIXEL_ONE / 2)
+
+static inline int32_t to_fixed(const float screen) {
+    return (int32_t) lrintf(screen * (float) RASTER_SUBPIXEL_ONE);
+}
 
-    dest[0] = min(x0, min(x1, x2)); // xmin
-    dest[1] = min(y0, min(y1, y2)); // ymin
-    dest[2] = max(x0, max(x1, x2)); // xmax
-    dest[3] = max(y0, max(y1, y2)); // ymax
+// Pixel index -> fixed-point coordinate of its center
+static inline int64_t pixel_center(const int32_t pixel) {
+    return (int64_t) pixel * RASTER_SUBPIXEL_ONE + RASTER_SUBPIXEL_HALF;
 }
 
-static inline int32_t get_determinant(const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1,
-                                      const int32_t xp, const int32_t yp) {
+static inline int64_t get_determinant(const int64_t x0, const int64_t y0, const int64_t x1, const int64_t y1,
+                                      const int64_t xp, const int64_t yp) {
     return (x1 - x0) * (yp - y0) - (y1 - y0) * (xp - x0);
 }
 
+// Edge function constants shared by both fill loops, in fixed point.
+// Edge 0: v0 -> v1, Edge 1: v1 -> v2, Edge 2: v2 -> v0
+// Moving one pixel RIGHT subtracts dy * ONE, moving one pixel DOWN adds dx * ONE.
+typedef struct {
+    int32_t dx[3];
+    int32_t dy[3];
+    int32_t bias[3]; // 0 on top-left edges, -1 otherwise
+} triangle_edges;
+
+static inline int32_t top_left_bias(const int32_t dx, const int32_t dy) {
+    // With y pointing down and inside meaning w >= 0, left edges go up the screen and top
+    // edges are horizontal going right.
+    const bool is_top_left = dy < 0 || (dy == 0 && dx > 0);
+    return is_top_left ? 0 : -1;
+}
+
+static inline void setup_edges(const raster_triangle *restrict tri, triangle_edges *restrict edges) {
+    edges->dx[0] = tri->v1[0] - tri->v0[0];
+    edges->dy[0] = tri->v1[1] - tri->v0[1];
+    edges->dx[1] = tri->v2[0] - tri->v1[0];
+    edges->dy[1] = tri->v2[1] - tri->v1[1];
+    edges->dx[2] = tri->v0[0] - tri->v2[0];
+    edges->dy[2] = tri->v0[1] - tri->v2[1];
+
+    for (int e = 0; e < 3; ++e) {
+        edges->bias[e] = top_left_bias(edges->dx[e], edges->dy[e]);
+    }
+}
+
+// Biased edge functions at the center of pixel (x, y), full precision
+static inline void eval_edges(const raster_triangle *restrict tri, const triangle_edges *restrict edges,
+                              const int32_t x, const int32_t y, int64_t w[3]) {
+    const int64_t px = pixel_center(x);
+    const int64_t py = pixel_center(y);
+    w[0] = get_determinant(tri->v0[0], tri->v0[1], tri->v1[0], tri->v1[1], px, py) + edges->bias[0];
+    w[1] = get_determinant(tri->v1[0], tri->v1[1], tri->v2[0], tri->v2[1], px, py) + edges->bias[1];
+    w[2] = get_determinant(tri->v2[0], tri->v2[1], tri->v0[0], tri->v0[1], px, py) + edges->bias[2];
+}
+
+// --- Hierarchical Z ---
+// Each RASTER_HIZ_BLOCK_SIZE^2 block keeps a conservative [min, max] of the depths it holds.
+// A triangle whose nearest z is not closer than a block's max cannot pass the depth test
+// anywhere in it, and one whose farthest z is closer than the block's min passes everywhere.
+// Blocks align with tiles, so a tile worker only ever touches its own blocks.
+
+typedef enum {
+    BLOCK_OUTSIDE,
+    BLOCK_PARTIAL,
+    BLOCK_FULL, // Every pixel of the (clipped) block is inside the triangle
+} block_coverage;
+
+typedef struct {
+    int32_t x0, y0, x1, y1; // Block clipped to the fill rect
+    uint32_t hiz_index;
+    block_coverage coverage;
+    bool is_whole_block; // Clipping left the full RASTER_HIZ_BLOCK_SIZE^2 block
+    bool needs_depth_test; // false when Hi-Z proves every pixel passes
+
+    // 32-bit edge stepping local to the block, starting at (start_x, y0). Edges that contain
+    // the whole block are 0 with 0 steps, so they always pass.
+    int32_t w[3];
+    int32_t step_x[3];
+    int32_t step_y[3];
+} raster_block;
+
+// Clips one block to rect, classifies it and sets up its local edge stepping from start_x.
+// Returns false when the block is outside the triangle. Edge functions are linear, so a block
+// is outside an edge when all 4 corners are, and fully inside the triangle when all corners
+// are inside every edge.
+static inline bool classify_block(const raster_triangle *restrict tri, const triangle_edges *restrict edges,
+                                  const ivec4 rect, const int32_t bx, const int32_t by,
+                                  const bool start_at_block_x, raster_block *restrict block) {
+    block->x0 = max(bx, rect[0]);
+    block->y0 = max(by, rect[1]);
+    block->x1 = min(bx + RASTER_HIZ_BLOCK_SIZE - 1, rect[2]);
+    block->y1 = min(by + RASTER_HIZ_BLOCK_SIZE - 1, rect[3]);
+    block->is_whole_block = block->x0 == bx && block->y0 == by &&
+                            block->x1 == bx + RASTER_HIZ_BLOCK_SIZE - 1 &&
+                            block->y1 == by + RASTER_HIZ_BLOCK_SIZE - 1;
+
+    const int32_t start_x = start_at_block_x ? bx : block->x0;
+    int64_t w[3];
+    eval_edges(tri, edges, start_x, block->y0, w);
+
+    bool all_inside = true;
+    for (int e = 0; e < 3; ++e) {
+        const int64_t step_x = -(int64_t) edges->dy[e] * RASTER_SUBPIXEL_ONE;
+        const int64_t step_y = (int64_t) edges->dx[e] * RASTER_SUBPIXEL_ONE;
+        const int64_t c00 = w[e] + step_x * (block->x0 - start_x);
+        const int64_t c10 = c00 + step_x * (block->x1 - block->x0);
+        const int64_t c01 = c00 + step_y * (block->y1 - block->y0);
+        const int64_t c11 = c10 + step_y * (block->y1 - block->y0);
+
+        if ((c00 & c10 & c01 & c11) < 0) {
+            return false;
+        }
+
+        if ((c00 | c10 | c01 | c11) >= 0) {
+            block->w[e] = 0;
+            block->step_x[e] = 0;
+            block->step_y[e] = 0;
+        } else {
+            // Straddles the block: |w| is bounded by a few pixels of steps, 32 bits is plenty
+            all_inside = false;
+            block->w[e] = (int32_t) w[e];
+            block->step_x[e] = (int32_t) step_x;
+            block->step_y[e] = (int32_t) step_y;
+        }
+    }
+
+    block->coverage = all_inside ? BLOCK_FULL : BLOCK_PARTIAL;
+    return true;
+}
+
+// Hi-Z test, then classify_block. Returns false when nothing in the block can be written.
+static inline bool begin_block(const graphics_buffer *restrict buff, const raster_triangle *restrict tri,
+                               const triangle_edges *restrict edges, const ivec4 rect,
+                               const int32_t bx, const int32_t by, const bool start_at_block_x,
+                               raster_block *restrict block) {
+    block->hiz_index = 0;
+    block->needs_depth_test = false;
+
+    if (buff->depth) {
+        block->hiz_index = (by / RASTER_HIZ_BLOCK_SIZE) * buff->hiz_width + bx / RASTER_HIZ_BLOCK_SIZE;
+        if (tri->z_min >= buff->hiz_max[block->hiz_index]) {
+            return false;
+        }
+        block->needs_depth_test = tri->z_max >= buff->hiz_min[block->hiz_index];
+    }
+
+    return classify_block(tri, edges, rect, bx, by, start_at_block_x, block);
+}
+
+static inline void end_block(const graphics_buffer *restrict buff, const raster_triangle *restrict tri,
+                             const raster_block *restrict block, const bool any_written) {
+    if (!buff->depth || !any_written) {
+        return;
+    }
+
+    // Every written depth is >= z_min, and a fully covered block now holds nothing farther than z_max.
+    buff->hiz_min[block->hiz_index] = min(buff->hiz_min[block->hiz_index], tri->z_min);
+    if (block->coverage == BLOCK_FULL && block->is_whole_block) {
+        buff->hiz_max[block->hiz_index] = min(buff->hiz_max[block->hiz_index], tri->z_max);
+    }
+}
+
+// Fills run on the tile workers. Each thread counts into its own pixel counters, flushed into
+// the frame's totals once per tile, so the fills never share a cache line.
+typedef struct {
+    uint64_t tested;
+    uint64_t written;
+} pixel_counters;
+
+static thread_local pixel_counters t_pixels;
+static atomic_uint_fast64_t g_pixels_tested;
+static atomic_uint_fast64_t g_pixels_written;
+
+// Triangle counts of the frame in progress, from the submitting thread only, and the last
+// finished frame's totals
+static renderer_stats g_frame_stats;
+static renderer_stats g_last_stats;
+
+static void flush_pixel_counters(void) {
+    if (t_pixels.tested) {
+        atomic_fetch_add_explicit(&g_pixels_tested, t_pixels.tested, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_pixels_written, t_pixels.written, memory_order_relaxed);
+        t_pixels = (pixel_counters){0};
+    }
+}
+
+static inline uint32_t lane_count(const simde__m256i mask) {
+    return (uint32_t) __builtin_popcount(simde_mm256_movemask_ps(simde_mm256_castsi256_ps(mask)));
+}
 
 static void fill_triangle(const graphics_buffer *restrict buff,
-                          const ivec3 v0, const ivec3 v1, const ivec3 v2,
-                          const ivec4 aabb, // AABB is now [xmin, ymin, xmax, ymax]
-                          const uint8_t r, const uint8_t g, const uint8_t b) {
-    // 1. Setup constants for standard edge functions
-    // Edge 0: v0 -> v1
-    const int32_t dx0 = v1[0] - v0[0];
-    const int32_t dy0 = v1[1] - v0[1];
-    // Edge 1: v1 -> v2
-    const int32_t dx1 = v2[0] - v1[0];
-    const int32_t dy1 = v2[1] - v1[1];
-    // Edge 2: v2 -> v0
-    const int32_t dx2 = v0[0] - v2[0];
-    const int32_t dy2 = v0[1] - v2[1];
-
-    // 2. Calculate initial values for the starting pixel (xmin, ymin)
-    // We use the full formula ONCE here.
-    // Notice we are testing the CENTER of the pixel (x + 0.5, y + 0.5) implicitly
-    // by how we set up our edge functions (a common trick is 'top-left' fill convention,
-    // but for simplicity we'll stick to your current math).
-    int32_t row_w0 = get_determinant(v0[0], v0[1], v1[0], v1[1], aabb[0], aabb[1]);
-    int32_t row_w1 = get_determinant(v1[0], v1[1], v2[0], v2[1], aabb[0], aabb[1]);
-    int32_t row_w2 = get_determinant(v2[0], v2[1], v0[0], v0[1], aabb[0], aabb[1]);
-
-    // 3. Pre-calculate the packed color once
-    const uint32_t color = r << 16 | g << 8 | b;
-
-    for (int32_t y = aabb[1]; y <= aabb[3]; ++y) {
-        // Initialize working values for this row
-        int32_t w0 = row_w0;
-        int32_t w1 = row_w1;
-        int32_t w2 = row_w2;
-
-        // Calculate pointer to the start of this row in memory
-        // (Assumes we clipped AABB to screen bounds previously!)
-        uint32_t *restrict pixel_row = (uint32_t * restrict) buff->memory + (y * buff->width + aabb[0]);
-
-        for (int32_t x = aabb[0]; x <= aabb[2]; ++x) {
-            // The Critical Inner Loop: ONLY comparisons and additions now.
-            if ((w0 | w1 | w2) >= 0) {
-                *pixel_row = color;
-            }
-
-            // Move one pixel RIGHT: Add 'dy' component to determinants
-            // (Note: The sign might need flipping depending on your exact coordinate system
-            // Y-is-up vs Y-is-down, but the concept is: it's just an addition)
-            w0 -= dy0;
-            w1 -= dy1;
-            w2 -= dy2;
-
-            pixel_row++;
-        }
-
-        // Move one pixel DOWN for the next row: Add 'dx' component
-        row_w0 += dx0;
-        row_w1 += dx1;
-        row_w2 += dx2;
+                          const raster_triangle *restrict tri,
+                          const ivec4 rect) { // Pixels to cover: [xmin, ymin, xmax, ymax], inside tri->aabb
+    triangle_edges edges;
+    setup_edges(tri, &edges);
+
+    uint32_t tested = 0;
+    uint32_t written = 0;
+
+    const uint32_t color = tri->color;
+
+    // Walk the rect in Hi-Z blocks so whole blocks can be rejected before any per-pixel work
+    for (int32_t by = rect[1] & ~(RASTER_HIZ_BLOCK_SIZE - 1); by <= rect[3]; by += RASTER_HIZ_BLOCK_SIZE) {
+        for (int32_t bx = rect[0] & ~(RASTER_HIZ_BLOCK_SIZE - 1); bx <= rect[2]; bx += RASTER_HIZ_BLOCK_SIZE) {
+            raster_block block;
+            if (!begin_block(buff, tri, &edges, rect, bx, by, false, &block)) {
+                continue;
+            }
+
+            // Start from the block's first pixel, then only add from there
+            int32_t row_w0 = block.w[0];
+            int32_t row_w1 = block.w[1];
+            int32_t row_w2 = block.w[2];
+            bool any_written = false;
+
+            for (int32_t y = block.y0; y <= block.y1; ++y) {
+                // Initialize working values for this row
+                int32_t w0 = row_w0;
+                int32_t w1 = row_w1;
+                int32_t w2 = row_w2;
+
+                uint32_t *restrict pixel_row = (uint32_t * restrict) buff->memory + (y * buff->width + block.x0);
+                float *restrict depth_row = buff->depth ? buff->depth + y * buff->depth_pitch + block.x0 : 0;
+                const float row_z = tri->z_origin + tri->dzdy * (float) y;
+
+                for (int32_t x = block.x0; x <= block.x1; ++x) {
+                    // The Critical Inner Loop: ONLY comparisons and additions now.
+                    if ((w0 | w1 | w2) >= 0) {
+                        tested++;
+                        if (depth_row) {
+                            const float z = row_z + tri->dzdx * (float) x;
+                            if (!block.needs_depth_test || z < *depth_row) {
+                                *depth_row = z;
+                                *pixel_row = color;
+                                any_written = true;
+                                written++;
+                            }
+                        } else {
+                            *pixel_row = color;
+                            any_written = true;
+                            written++;
+                        }
+                    }
+
+                    // Move one pixel RIGHT
+                    w0 += block.step_x[0];
+                    w1 += block.step_x[1];
+                    w2 += block.step_x[2];
+
+                    pixel_row++;
+                    if (depth_row) {
+                        depth_row++;
+                    }
+                }
+
+                // Move one pixel DOWN for the next row
+                row_w0 += block.step_y[0];
+                row_w1 += block.step_y[1];
+                row_w2 += block.step_y[2];
+            }
+
+            end_block(buff, tri, &block, any_written);
+        }
     }
+
+    t_pixels.tested += tested;
+    t_pixels.written += written;
+}
+
+// Same edge functions as fill_triangle, one 8-wide row of a Hi-Z block per iteration.
+// Lanes outside the triangle or the rect are masked off, so the store never touches pixels
+// the scalar path would not write. simde maps this to AVX2 natively and to SSE/NEON pairs
+// elsewhere. The depth buffer is padded to whole blocks, so depth rows load/store unmasked.
+static_assert(RASTER_HIZ_BLOCK_SIZE == 8, "fill_triangle_simd processes one 8-pixel block row per iteration");
+
+static void fill_triangle_simd(const graphics_buffer *restrict buff,
+                               const raster_triangle *restrict tri,
+                               const ivec4 rect) {
+    triangle_edges edges;
+    setup_edges(tri, &edges);
+
+    const simde__m256i lane = simde_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const simde__m256 lane_f = simde_mm256_cvtepi32_ps(lane);
+
+    const simde__m256i color = simde_mm256_set1_epi32((int32_t) tri->color);
+    const simde__m256i minus_one = simde_mm256_set1_epi32(-1);
+    const simde__m256 dzdx = simde_mm256_set1_ps(tri->dzdx);
+
+    uint32_t tested = 0;
+    uint32_t written = 0;
+
+    for (int32_t by = rect[1] & ~(RASTER_HIZ_BLOCK_SIZE - 1); by <= rect[3]; by += RASTER_HIZ_BLOCK_SIZE) {
+        for (int32_t bx = rect[0] & ~(RASTER_HIZ_BLOCK_SIZE - 1); bx <= rect[2]; bx += RASTER_HIZ_BLOCK_SIZE) {
+            raster_block block;
+            if (!begin_block(buff, tri, &edges, rect, bx, by, true, &block)) {
+                continue;
+            }
+
+            // Per-lane offsets of the edge functions from the block's first column
+            const simde__m256i lane_w0 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[0]));
+            const simde__m256i lane_w1 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[1]));
+            const simde__m256i lane_w2 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[2]));
+
+            // Lanes are the block's 8 columns, keep only those inside the rect
+            const simde__m256i column = simde_mm256_add_epi32(simde_mm256_set1_epi32(bx), lane);
+            const simde__m256i column_mask = simde_mm256_andnot_si256(
+                simde_mm256_or_si256(simde_mm256_cmpgt_epi32(simde_mm256_set1_epi32(block.x0), column),
+                                     simde_mm256_cmpgt_epi32(column, simde_mm256_set1_epi32(block.x1))),
+                minus_one);
+
+            // Depth is evaluated as z(x, y) = (z_origin + dzdy * y) + dzdx * x, like the scalar loop
+            const simde__m256 column_z = simde_mm256_mul_ps(dzdx, simde_mm256_add_ps(
+                                                                simde_mm256_set1_ps((float) bx), lane_f));
+
+            int32_t row_w[3] = {block.w[0], block.w[1], block.w[2]};
+            int32_t written_mask = 0;
+
+            for (int32_t y = block.y0; y <= block.y1; ++y) {
+                const simde__m256i w0 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[0]), lane_w0);
+                const simde__m256i w1 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[1]), lane_w1);
+                const simde__m256i w2 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[2]), lane_w2);
+
+                // Inside when the sign bit of (w0 | w1 | w2) is clear, i.e. the OR is > -1
+                const simde__m256i w_or = simde_mm256_or_si256(simde_mm256_or_si256(w0, w1), w2);
+                simde__m256i mask = simde_mm256_and_si256(simde_mm256_cmpgt_epi32(w_or, minus_one), column_mask);
+                tested += lane_count(mask);
+
+                if (buff->depth && !simde_mm256_testz_si256(mask, mask)) {
+                    float *restrict depth_row = buff->depth + y * buff->depth_pitch + bx;
+                    const simde__m256 depth = simde_mm256_loadu_ps(depth_row);
+                    const simde__m256 z = simde_mm256_add_ps(simde_mm256_set1_ps(tri->z_origin + tri->dzdy * (float) y),
+                                                             column_z);
+                    if (block.needs_depth_test) {
+                        mask = simde_mm256_and_si256(
+                            mask, simde_mm256_castps_si256(simde_mm256_cmp_ps(z, depth, SIMDE_CMP_LT_OQ)));
+                    }
+                    simde_mm256_storeu_ps(depth_row,
+                                          simde_mm256_blendv_ps(depth, z, simde_mm256_castsi256_ps(mask)));
+                }
+
+                if (!simde_mm256_testz_si256(mask, mask)) {
+                    int32_t *restrict pixel_row = (int32_t * restrict) buff->memory + (y * buff->width + bx);
+                    simde_mm256_maskstore_epi32(pixel_row, mask, color);
+                    written_mask |= simde_mm256_movemask_ps(simde_mm256_castsi256_ps(mask));
+                    written += lane_count(mask);
+                }
+
+                row_w[0] += block.step_y[0];
+                row_w[1] += block.step_y[1];
+                row_w[2] += block.step_y[2];
+            }
+
+            end_block(buff, tri, &block, written_mask != 0);
+        }
+    }
+
+    t_pixels.tested += tested;
+    t_pixels.written += written;
 }
 
+// --- Attribute fill ---
+// Triangles with attributes interpolate them perspective-correctly: with e0..e2 the edge
+// functions, the screen-space barycentric of v0 is e1, of v1 e2 and of v2 e0 (up to the common
+// area factor), and l_i = e * (1 / w_i) are the barycentrics of attribute / w, which is affine
+// in screen space. Each attribute is then sum(l_i * a_i) / sum(l_i), so the area cancels too.
+// The l_i planes start from the exact int64 edge values at every block and step in float,
+// 8 pixels per row. Coverage, depth and Hi-Z are the same as in fill_triangle_simd.
+
+static_assert(CLIP_MAX_ATTRIBUTES == RASTER_MAX_ATTRIBUTES, "attributes go through the clipper unchanged");
+
+// Packs 8 Gouraud colors from r, g, b in [0, 1]
+static inline simde__m256i pack_rgb(const simde__m256 r, const simde__m256 g, const simde__m256 b) {
+    const simde__m256 zero = simde_mm256_setzero_ps();
+    const simde__m256 one = simde_mm256_set1_ps(1.0f);
+    const simde__m256 scale = simde_mm256_set1_ps(255.0f);
+    const simde__m256 half = simde_mm256_set1_ps(0.5f);
+
+    const simde__m256i ri = simde_mm256_cvttps_epi32(
+        simde_mm256_fmadd_ps(simde_mm256_min_ps(simde_mm256_max_ps(r, zero), one), scale, half));
+    const simde__m256i gi = simde_mm256_cvttps_epi32(
+        simde_mm256_fmadd_ps(simde_mm256_min_ps(simde_mm256_max_ps(g, zero), one), scale, half));
+    const simde__m256i bi = simde_mm256_cvttps_epi32(
+        simde_mm256_fmadd_ps(simde_mm256_min_ps(simde_mm256_max_ps(b, zero), one), scale, half));
+
+    return simde_mm256_or_si256(simde_mm256_or_si256(simde_mm256_slli_epi32(ri, 16), simde_mm256_slli_epi32(gi, 8)), bi);
+}
+
+// count and gouraud are compile-time constants at every call site, so each variant gets its own
+// unrolled attribute loop. gouraud keeps r, g, b in registers instead of calling the shader.
+[[gnu::always_inline]] static inline void fill_triangle_attributes_n(const graphics_buffer *restrict buff,
+                                                                     const raster_triangle *restrict tri,
+                                                                     const ivec4 rect, const uint32_t count,
+                                                                     const bool gouraud) {
+    const raster_attributes *restrict attributes = tri->attributes;
+
+    triangle_edges edges;
+    setup_edges(tri, &edges);
+
+    const simde__m256i lane = simde_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const simde__m256 lane_f = simde_mm256_cvtepi32_ps(lane);
+
+    const simde__m256i minus_one = simde_mm256_set1_epi32(-1);
+    const simde__m256 dzdx = simde_mm256_set1_ps(tri->dzdx);
+
+    // l_i steps, per pixel and per row. Vertex v's weight comes from the edge opposite to it.
+    float l_dx[3], l_dy[3];
+    for (int v = 0; v < 3; ++v) {
+        const int e = (v + 1) % 3;
+        l_dx[v] = -(float) edges.dy[e] * (float) RASTER_SUBPIXEL_ONE * attributes->inv_w[v];
+        l_dy[v] = (float) edges.dx[e] * (float) RASTER_SUBPIXEL_ONE * attributes->inv_w[v];
+    }
+    const simde__m256 lane_l0 = simde_mm256_mul_ps(lane_f, simde_mm256_set1_ps(l_dx[0]));
+    const simde__m256 lane_l1 = simde_mm256_mul_ps(lane_f, simde_mm256_set1_ps(l_dx[1]));
+    const simde__m256 lane_l2 = simde_mm256_mul_ps(lane_f, simde_mm256_set1_ps(l_dx[2]));
+
+    // Derivatives of sum(l_i * a_i), per attribute, for the shader's ddx/ddy
+    float n_dx[RASTER_MAX_ATTRIBUTES], n_dy[RASTER_MAX_ATTRIBUTES];
+    for (uint32_t a = 0; a < count && !gouraud; ++a) {
+        n_dx[a] = l_dx[0] * attributes->values[0][a] + l_dx[1] * attributes->values[1][a] +
+                  l_dx[2] * attributes->values[2][a];
+        n_dy[a] = l_dy[0] * attributes->values[0][a] + l_dy[1] * attributes->values[1][a] +
+                  l_dy[2] * attributes->values[2][a];
+    }
+    const float d_dx = l_dx[0] + l_dx[1] + l_dx[2];
+    const float d_dy = l_dy[0] + l_dy[1] + l_dy[2];
+
+    raster_fragments fragments;
+    alignas(32) uint32_t colors[8];
+    uint32_t tested = 0;
+    uint32_t written = 0;
+
+    for (int32_t by = rect[1] & ~(RASTER_HIZ_BLOCK_SIZE - 1); by <= rect[3]; by += RASTER_HIZ_BLOCK_SIZE) {
+        for (int32_t bx = rect[0] & ~(RASTER_HIZ_BLOCK_SIZE - 1); bx <= rect[2]; bx += RASTER_HIZ_BLOCK_SIZE) {
+            raster_block block;
+            if (!begin_block(buff, tri, &edges, rect, bx, by, true, &block)) {
+                continue;
+            }
+
+            const simde__m256i lane_w0 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[0]));
+            const simde__m256i lane_w1 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[1]));
+            const simde__m256i lane_w2 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[2]));
+
+            const simde__m256i column = simde_mm256_add_epi32(simde_mm256_set1_epi32(bx), lane);
+            const simde__m256i column_mask = simde_mm256_andnot_si256(
+                simde_mm256_or_si256(simde_mm256_cmpgt_epi32(simde_mm256_set1_epi32(block.x0), column),
+                                     simde_mm256_cmpgt_epi32(column, simde_mm256_set1_epi32(block.x1))),
+                minus_one);
+
+            const simde__m256 column_z = simde_mm256_mul_ps(dzdx, simde_mm256_add_ps(
+                                                                simde_mm256_set1_ps((float) bx), lane_f));
+
+            // Unbiased edge values at the block's first column, exact before the conversion
+            int64_t e[3];
+            eval_edges(tri, &edges, bx, block.y0, e);
+            float l_row[3];
+            for (int v = 0; v < 3; ++v) {
+                const int edge = (v + 1) % 3;
+                l_row[v] = (float) (e[edge] - edges.bias[edge]) * attributes->inv_w[v];
+            }
+
+            int32_t row_w[3] = {block.w[0], block.w[1], block.w[2]};
+            int32_t written_mask = 0;
+
+            for (int32_t y = block.y0; y <= block.y1; ++y) {
+                const simde__m256i w0 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[0]), lane_w0);
+                const simde__m256i w1 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[1]), lane_w1);
+                const simde__m256i w2 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[2]), lane_w2);
+
+                const simde__m256i w_or = simde_mm256_or_si256(simde_mm256_or_si256(w0, w1), w2);
+                simde__m256i mask = simde_mm256_and_si256(simde_mm256_cmpgt_epi32(w_or, minus_one), column_mask);
+                tested += lane_count(mask);
+
+                float *restrict depth_row = 0;
+                simde__m256 z = simde_mm256_setzero_ps();
+                if (buff->depth && !simde_mm256_testz_si256(mask, mask)) {
+                    depth_row = buff->depth + y * buff->depth_pitch + bx;
+                    z = simde_mm256_add_ps(simde_mm256_set1_ps(tri->z_origin + tri->dzdy * (float) y), column_z);
+                    if (block.needs_depth_test) {
+                        mask = simde_mm256_and_si256(
+                            mask, simde_mm256_castps_si256(
+                                simde_mm256_cmp_ps(z, simde_mm256_loadu_ps(depth_row), SIMDE_CMP_LT_OQ)));
+                    }
+                }
+
+                if (!simde_mm256_testz_si256(mask, mask)) {
+                    if (depth_row) {
+                        simde_mm256_storeu_ps(depth_row, simde_mm256_blendv_ps(simde_mm256_loadu_ps(depth_row), z,
+                                                                               simde_mm256_castsi256_ps(mask)));
+                    }
+
+                    // Normalized perspective-correct barycentrics of the 8 pixels
+                    const simde__m256 l0 = simde_mm256_add_ps(simde_mm256_set1_ps(l_row[0]), lane_l0);
+                    const simde__m256 l1 = simde_mm256_add_ps(simde_mm256_set1_ps(l_row[1]), lane_l1);
+                    const simde__m256 l2 = simde_mm256_add_ps(simde_mm256_set1_ps(l_row[2]), lane_l2);
+                    const simde__m256 inv_sum = simde_mm256_div_ps(simde_mm256_set1_ps(1.0f),
+                                                                   simde_mm256_add_ps(simde_mm256_add_ps(l0, l1), l2));
+                    const simde__m256 b0 = simde_mm256_mul_ps(l0, inv_sum);
+                    const simde__m256 b1 = simde_mm256_mul_ps(l1, inv_sum);
+                    const simde__m256 b2 = simde_mm256_mul_ps(l2, inv_sum);
+
+                    simde__m256i color;
+                    if (gouraud) {
+                        simde__m256 rgb[3];
+                        for (int a = 0; a < 3; ++a) {
+                            rgb[a] = simde_mm256_fmadd_ps(
+                                b0, simde_mm256_set1_ps(attributes->values[0][a]),
+                                simde_mm256_fmadd_ps(b1, simde_mm256_set1_ps(attributes->values[1][a]),
+                                                     simde_mm256_mul_ps(b2, simde_mm256_set1_ps(attributes->values[2][a]))));
+                        }
+                        color = pack_rgb(rgb[0], rgb[1], rgb[2]);
+                    } else {
+                        for (uint32_t a = 0; a < count; ++a) {
+                            simde_mm256_store_ps(fragments.values[a], simde_mm256_fmadd_ps(
+                                b0, simde_mm256_set1_ps(attributes->values[0][a]),
+                                simde_mm256_fmadd_ps(b1, simde_mm256_set1_ps(attributes->values[1][a]),
+                                                     simde_mm256_mul_ps(b2, simde_mm256_set1_ps(attributes->values[2][a])))));
+                        }
+
+                        // a = N / D with N and D affine, so da = (dN - a * dD) / D, at the span's center
+                        const float center = 0.5f * (RASTER_HIZ_BLOCK_SIZE - 1);
+                        const float d = l_row[0] + l_row[1] + l_row[2] + center * d_dx;
+                        const float inv_d = d != 0.0f ? 1.0f / d : 0.0f;
+                        for (uint32_t a = 0; a < count; ++a) {
+                            const float value = ((l_row[0] + center * l_dx[0]) * attributes->values[0][a] +
+                                                 (l_row[1] + center * l_dx[1]) * attributes->values[1][a] +
+                                                 (l_row[2] + center * l_dx[2]) * attributes->values[2][a]) * inv_d;
+                            fragments.ddx[a] = (n_dx[a] - value * d_dx) * inv_d;
+                            fragments.ddy[a] = (n_dy[a] - value * d_dy) * inv_d;
+                        }
+
+                        attributes->shader(&fragments, count, attributes->shader_data, colors);
+                        color = simde_mm256_load_si256((const simde__m256i *) colors);
+                    }
+
+                    int32_t *restrict pixel_row = (int32_t * restrict) buff->memory + (y * buff->width + bx);
+                    simde_mm256_maskstore_epi32(pixel_row, mask, color);
+                    written_mask |= simde_mm256_movemask_ps(simde_mm256_castsi256_ps(mask));
+                    written += lane_count(mask);
+                }
+
+                row_w[0] += block.step_y[0];
+                row_w[1] += block.step_y[1];
+                row_w[2] += block.step_y[2];
+                l_row[0] += l_dy[0];
+                l_row[1] += l_dy[1];
+                l_row[2] += l_dy[2];
+            }
+
+            end_block(buff, tri, &block, written_mask != 0);
+        }
+    }
+
+    t_pixels.tested += tested;
+    t_pixels.written += written;
+}
+
+static void fill_triangle_attributes(const graphics_buffer *restrict buff,
+                                     const raster_triangle *restrict tri,
+                                     const ivec4 rect) {
+    const raster_attributes *restrict attributes = tri->attributes;
+    if (!attributes->shader) {
+        fill_triangle_attributes_n(buff, tri, rect, 3, true);
+        return;
+    }
+
+    switch (attributes->count) {
+        case 1: fill_triangle_attributes_n(buff, tri, rect, 1, false); break;
+        case 2: fill_triangle_attributes_n(buff, tri, rect, 2, false); break;
+        case 3: fill_triangle_attributes_n(buff, tri, rect, 3, false); break;
+        case 4: fill_triangle_attributes_n(buff, tri, rect, 4, false); break;
+        default: fill_triangle_attributes_n(buff, tri, rect, attributes->count, false); break;
+    }
+}
+
+// --- Occlusion buffer ---
+// Masked occlusion culling (Hasselgren et al.) on Hi-Z blocks. Instead of per-pixel depth,
+// each block keeps a coverage mask and two layers: z_far bounds every pixel of the block and
+// z_mask bounds the pixels in the mask. Occluders only ever lower these bounds.
+//
+// The buffer is lower resolution than the framebuffer, so coverage is inner-conservative: a
+// pixel counts as covered only when its whole square (plus a subpixel of margin for snapping)
+// is inside the triangle, and the depth bound is taken over the covered squares. Any
+// framebuffer pixel center inside a covered square is then behind the bound.
+
+// Pixels of block (bx, by) that are inside the buffer
+static inline uint64_t occlusion_valid_mask(const occlusion_buffer *restrict ob, const int32_t bx,
+                                            const int32_t by) {
+    const int32_t columns = min((int32_t) ob->width - bx, RASTER_HIZ_BLOCK_SIZE);
+    const int32_t rows = min((int32_t) ob->height - by, RASTER_HIZ_BLOCK_SIZE);
+    const uint64_t row_mask = columns == RASTER_HIZ_BLOCK_SIZE ? 0xFF : (1u << columns) - 1u;
+
+    uint64_t mask = 0;
+    for (int32_t row = 0; row < rows; ++row) {
+        mask |= row_mask << (row * RASTER_HIZ_BLOCK_SIZE);
+    }
+    return mask;
+}
+
+// Adds coverage with farthest depth z. When the new coverage is much nearer than the working
+// layer, merging would push the layer back, so the layer is dropped and restarted; both are
+// conservative. A full mask becomes the new z_far.
+static inline void update_occlusion_block(occlusion_block *restrict block, const uint64_t valid,
+                                          const uint64_t mask, const float z) {
+    if (z >= block->z_far) {
+        return;
+    }
+
+    if (block->z_mask - z > block->z_far - block->z_mask) {
+        block->z_mask = 0.0f;
+        block->mask = 0;
+    }
+    block->z_mask = max(block->z_mask, z);
+    block->mask |= mask;
+
+    if ((block->mask & valid) == valid) {
+        block->z_far = block->z_mask;
+        block->z_mask = 0.0f;
+        block->mask = 0;
+    }
+}
+
+// Depth-only variant of fill_triangle_simd: each 8-wide block row becomes 8 bits of a coverage
+// mask instead of pixel writes.
+static void fill_occluder(occlusion_buffer *restrict ob, const raster_triangle *restrict tri) {
+    triangle_edges edges;
+    setup_edges(tri, &edges);
+
+    // Move every edge inward by the pixel's half extent along its normal, in edge units
+    for (int e = 0; e < 3; ++e) {
+        edges.bias[e] = -(abs(edges.dx[e]) + abs(edges.dy[e])) * (RASTER_SUBPIXEL_HALF + 1);
+    }
+
+    const simde__m256i lane = simde_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const simde__m256i minus_one = simde_mm256_set1_epi32(-1);
+
+    for (int32_t by = tri->aabb[1] & ~(RASTER_HIZ_BLOCK_SIZE - 1); by <= tri->aabb[3]; by += RASTER_HIZ_BLOCK_SIZE) {
+        for (int32_t bx = tri->aabb[0] & ~(RASTER_HIZ_BLOCK_SIZE - 1); bx <= tri->aabb[2]; bx += RASTER_HIZ_BLOCK_SIZE) {
+            occlusion_block *restrict target =
+                &ob->blocks[(by / RASTER_HIZ_BLOCK_SIZE) * ob->block_width + bx / RASTER_HIZ_BLOCK_SIZE];
+            if (tri->z_min >= target->z_far) {
+                continue;
+            }
+
+            raster_block block;
+            if (!classify_block(tri, &edges, tri->aabb, bx, by, true, &block)) {
+                continue;
+            }
+
+            const simde__m256i lane_w0 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[0]));
+            const simde__m256i lane_w1 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[1]));
+            const simde__m256i lane_w2 = simde_mm256_mullo_epi32(lane, simde_mm256_set1_epi32(block.step_x[2]));
+            const simde__m256i column = simde_mm256_add_epi32(simde_mm256_set1_epi32(bx), lane);
+            const simde__m256i column_mask = simde_mm256_andnot_si256(
+                simde_mm256_or_si256(simde_mm256_cmpgt_epi32(simde_mm256_set1_epi32(block.x0), column),
+                                     simde_mm256_cmpgt_epi32(column, simde_mm256_set1_epi32(block.x1))),
+                minus_one);
+
+            uint64_t mask = 0;
+            int32_t row_w[3] = {block.w[0], block.w[1], block.w[2]};
+            for (int32_t y = block.y0; y <= block.y1; ++y) {
+                const simde__m256i w0 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[0]), lane_w0);
+                const simde__m256i w1 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[1]), lane_w1);
+                const simde__m256i w2 = simde_mm256_add_epi32(simde_mm256_set1_epi32(row_w[2]), lane_w2);
+                const simde__m256i w_or = simde_mm256_or_si256(simde_mm256_or_si256(w0, w1), w2);
+                const simde__m256i inside = simde_mm256_and_si256(simde_mm256_cmpgt_epi32(w_or, minus_one), column_mask);
+
+                const uint64_t row_bits = (uint32_t) simde_mm256_movemask_ps(simde_mm256_castsi256_ps(inside));
+                mask |= row_bits << ((y - by) * RASTER_HIZ_BLOCK_SIZE);
+
+                row_w[0] += block.step_y[0];
+                row_w[1] += block.step_y[1];
+                row_w[2] += block.step_y[2];
+            }
+            if (!mask) {
+                continue;
+            }
+
+            // The plane is linear, so its maximum over the covered squares is at a corner of the
+            // clipped block grown by half a pixel
+            float z = tri->z_max;
+            float corner_max = 0.0f;
+            for (int corner = 0; corner < 4; ++corner) {
+                const float x = corner & 1 ? (float) block.x1 + 0.5f : (float) block.x0 - 0.5f;
+                const float y = corner & 2 ? (float) block.y1 + 0.5f : (float) block.y0 - 0.5f;
+                corner_max = max(corner_max, tri->z_origin + tri->dzdy * y + tri->dzdx * x);
+            }
+            z = min(z, corner_max);
+
+            update_occlusion_block(target, occlusion_valid_mask(ob, bx, by), mask, z);
+        }
+    }
+}
+
+static raster_path g_raster_path = RASTER_PATH_SIMD;
+
+void renderer_set_raster_path(const raster_path path) {
+    g_raster_path = path;
+}
+
+// Flags the tiles overlapping pixels [x0, x1] x [y0, y1], which must be inside the buffer.
+// Tile workers only ever mark their own tile, so the byte stores need no synchronization.
+static inline void mark_dirty(const graphics_buffer *restrict buff, const int32_t x0, const int32_t y0,
+                              const int32_t x1, const int32_t y1) {
+    if (!buff->dirty) {
+        return;
+    }
+
+    for (int32_t ty = y0 / RASTER_TILE_SIZE; ty <= y1 / RASTER_TILE_SIZE; ++ty) {
+        uint8_t *restrict row = buff->dirty + ty * buff->dirty_width;
+        for (int32_t tx = x0 / RASTER_TILE_SIZE; tx <= x1 / RASTER_TILE_SIZE; ++tx) {
+            row[tx] = RASTER_DIRTY_DRAWN | RASTER_DIRTY_CHANGED;
+        }
+    }
+}
+
+static raster_shader g_shader;
+static const void *g_shader_data;
+
+void renderer_set_shader(const raster_shader shader, const void *user) {
+    g_shader = shader;
+    g_shader_data = user;
+}
+
+static inline void rasterize_triangle(const graphics_buffer *restrict buff,
+                                      const raster_triangle *restrict tri,
+                                      const ivec4 rect) {
+    mark_dirty(buff, rect[0], rect[1], rect[2], rect[3]);
+
+    if (tri->attributes) {
+        fill_triangle_attributes(buff, tri, rect);
+        return;
+    }
+
+    switch (g_raster_path) {
+        case RASTER_PATH_SIMD:
+            fill_triangle_simd(buff, tri, rect);
+            break;
+        case RASTER_PATH_SCALAR:
+        default:
+            fill_triangle(buff, tri, rect);
+            break;
+    }
+}
+
+// --- Tile binning (sort-middle) ---
+// render_obj_raster copies set-up triangles into a pool and appends a pointer to every tile
+// their AABB touches. renderer_end_frame then rasterizes the tiles in parallel: each worker
+// owns a disjoint rectangle of the framebuffer, so no locking is needed, and the per-tile
+// lists keep submission order so the result matches the immediate path.
+//
+// All binning memory is per frame. Triangles come from a pool and tile lists are chained
+// chunks from a frame arena; both are reset in renderer_begin_frame and alternate between two
+// sets, so the steady-state frame loop does no heap allocation at all.
+
+static thread_pool *g_raster_pool;
+
+// 1 KiB per chunk
+#define TILE_BIN_CAPACITY 126
+
+struct tile_bin {
+    tile_bin *next;
+    uint32_t count;
+    const raster_triangle *triangles[TILE_BIN_CAPACITY];
+};
+
+static frame_arena g_bin_arena;
+static pool g_triangle_pools[2]; // Indexed like g_bin_arena.arenas
+static pool g_attribute_pools[2]; // raster_attributes of the binned triangles that have them
+
+static void bin_triangle(graphics_buffer *restrict buff, const raster_triangle *restrict tri) {
+    arena *restrict bins = &g_bin_arena.arenas[g_bin_arena.index];
+
+    // The pools and the arena grow, so these only fail when the heap is exhausted. The frame then
+    // renders with holes, counted so they do not go unnoticed.
+    raster_triangle *binned = pool_alloc(&g_triangle_pools[g_bin_arena.index]);
+    if (!binned) {
+        g_frame_stats.triangles_dropped++;
+        return;
+    }
+    *binned = *tri;
+
+    if (tri->attributes) {
+        raster_attributes *attributes = pool_alloc(&g_attribute_pools[g_bin_arena.index]);
+        if (!attributes) {
+            pool_release(&g_triangle_pools[g_bin_arena.index], binned);
+            g_frame_stats.triangles_dropped++;
+            return;
+        }
+        *attributes = *tri->attributes;
+        binned->attributes = attributes;
+    }
+
+    const int32_t tile_x0 = tri->aabb[0] / RASTER_TILE_SIZE;
+    const int32_t tile_y0 = tri->aabb[1] / RASTER_TILE_SIZE;
+    const int32_t tile_x1 = tri->aabb[2] / RASTER_TILE_SIZE;
+    const int32_t tile_y1 = tri->aabb[3] / RASTER_TILE_SIZE;
+
+    bool dropped = false;
+    for (int32_t ty = tile_y0; ty <= tile_y1; ++ty) {
+        Tile *restrict tile_row = buff->tiles + ty * buff->tile_count_x;
+        for (int32_t tx = tile_x0; tx <= tile_x1; ++tx) {
+            Tile *restrict tile = tile_row + tx;
+
+            tile_bin *bin = tile->last_bin;
+            if (!bin || bin->count == TILE_BIN_CAPACITY) {
+                tile_bin *next = arena_alloc_array(bins, tile_bin, 1);
+                if (!next) {
+                    dropped = true;
+                    continue;
+                }
+                next->next = 0;
+                next->count = 0;
+
+                if (bin) {
+                    bin->next = next;
+                } else {
+                    tile->first_bin = next;
+                }
+                tile->last_bin = bin = next;
+            }
+
+            bin->triangles[bin->count++] = binned;
+            tile->triangle_count++;
+        }
+    }
+    if (dropped) {
+        g_frame_stats.triangles_dropped++;
+    }
+}
+
+static void rasterize_tile_job(void *user, const uint32_t job_index, const uint32_t thread_index) {
+    (void) thread_index;
+    const graphics_buffer *restrict buff = user;
+    const Tile *restrict tile = &buff->tiles[job_index];
+
+    TracyCZoneN(tile_tracy, "RasterTile", true);
+    for (const tile_bin *bin = tile->first_bin; bin; bin = bin->next) {
+        for (uint32_t i = 0; i < bin->count; ++i) {
+            const raster_triangle *restrict tri = bin->triangles[i];
+
+            const ivec4 rect = {
+                max(tri->aabb[0], tile->x_min),
+                max(tri->aabb[1], tile->y_min),
+                min(tri->aabb[2], tile->x_max),
+                min(tri->aabb[3], tile->y_max),
+            };
+            rasterize_triangle(buff, tri, rect);
+        }
+    }
+    flush_pixel_counters();
+    TracyCZoneEnd(tile_tracy);
+}
+
+void renderer_tiles_free(graphics_buffer *buff) {
+    if (buff->tiles) {
+        TracyCFree(buff->tiles);
+        free(buff->tiles);
+    }
+
+    frame_arena_free(&g_bin_arena);
+    pool_free(&g_triangle_pools[0]);
+    pool_free(&g_triangle_pools[1]);
+    pool_free(&g_attribute_pools[0]);
+    pool_free(&g_attribute_pools[1]);
+
+    buff->tiles = 0;
+    buff->tile_count_x = 0;
+    buff->tile_count_y = 0;
+}
+
+void renderer_tiles_init(graphics_buffer *buff) {
+    renderer_tiles_free(buff);
+
+    buff->tile_count_x = (buff->width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    buff->tile_count_y = (buff->height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    const uint32_t tile_count = buff->tile_count_x * buff->tile_count_y;
+    if (tile_count == 0) {
+        return;
+    }
+
+    buff->tiles = calloc(tile_count, sizeof(Tile));
+    if (!buff->tiles) {
+        buff->tile_count_x = 0;
+        buff->tile_count_y = 0;
+        return;
+    }
+    TracyCAlloc(buff->tiles, sizeof(Tile) * tile_count);
+
+    for (uint32_t ty = 0; ty < buff->tile_count_y; ++ty) {
+        for (uint32_t tx = 0; tx < buff->tile_count_x; ++tx) {
+            Tile *tile = &buff->tiles[ty * buff->tile_count_x + tx];
+            tile->x_min = (int32_t) (tx * RASTER_TILE_SIZE);
+            tile->y_min = (int32_t) (ty * RASTER_TILE_SIZE);
+            tile->x_max = min((int32_t) ((tx + 1) * RASTER_TILE_SIZE), (int32_t) buff->width) - 1;
+            tile->y_max = min((int32_t) ((ty + 1) * RASTER_TILE_SIZE), (int32_t) buff->height) - 1;
+        }
+    }
+
+    // Room for one chunk per tile per block, and a few thousand triangles before the pools grow
+    frame_arena_init(&g_bin_arena, sizeof(tile_bin) * tile_count);
+    pool_init(&g_triangle_pools[0], sizeof(raster_triangle), 4096);
+    pool_init(&g_triangle_pools[1], sizeof(raster_triangle), 4096);
+    pool_init(&g_attribute_pools[0], sizeof(raster_attributes), 1024);
+    pool_init(&g_attribute_pools[1], sizeof(raster_attributes), 1024);
+}
+
+void renderer_set_thread_count(const uint32_t thread_count) {
+    if (g_raster_pool) {
+        thread_pool_destroy(g_raster_pool);
+        g_raster_pool = 0;
+    }
+
+    if (thread_count > 1) {
+        g_raster_pool = thread_pool_create(thread_count - 1);
+    }
+}
+
+void renderer_begin_frame(graphics_buffer *buff) {
+    g_frame_stats = (renderer_stats){0};
+    t_pixels = (pixel_counters){0};
+    atomic_store_explicit(&g_pixels_tested, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_pixels_written, 0, memory_order_relaxed);
+
+    frame_arena_begin(&g_bin_arena);
+    pool_reset(&g_triangle_pools[g_bin_arena.index]);
+    pool_reset(&g_attribute_pools[g_bin_arena.index]);
+
+    const uint32_t tile_count = buff->tile_count_x * buff->tile_count_y;
+    for (uint32_t i = 0; i < tile_count; ++i) {
+        buff->tiles[i].first_bin = 0;
+        buff->tiles[i].last_bin = 0;
+        buff->tiles[i].triangle_count = 0;
+    }
+}
+
+static void publish_stats(const graphics_buffer *buff) {
+    renderer_stats stats = g_frame_stats;
+    stats.pixels_tested = atomic_exchange_explicit(&g_pixels_tested, 0, memory_order_relaxed);
+    stats.pixels_written = atomic_exchange_explicit(&g_pixels_written, 0, memory_order_relaxed);
+    const uint64_t pixel_count = (uint64_t) buff->width * buff->height;
+    stats.overdraw = pixel_count ? (double) stats.pixels_written / (double) pixel_count : 0.0;
+
+    g_last_stats = stats;
+    g_frame_stats = (renderer_stats){0};
+
+    TracyCPlot("Triangles in", (double) stats.triangles_in);
+    TracyCPlot("Meshlets culled", (double) stats.meshlets_culled);
+    TracyCPlot("Frustum culled", (double) stats.triangles_frustum_culled);
+    TracyCPlot("Clipped", (double) stats.triangles_clipped);
+    TracyCPlot("Backface culled", (double) stats.triangles_backface_culled);
+    TracyCPlot("Setup culled", (double) stats.triangles_setup_culled);
+    TracyCPlot("Triangles rasterized", (double) stats.triangles_rasterized);
+    TracyCPlot("Triangles dropped", (double) stats.triangles_dropped);
+    TracyCPlot("Pixels tested", (double) stats.pixels_tested);
+    TracyCPlot("Pixels written", (double) stats.pixels_written);
+    TracyCPlot("Overdraw", stats.overdraw);
+}
+
+void renderer_flush_tiles(graphics_buffer *buff) {
+    if (!buff->tiles) {
+        return;
+    }
+
+    TracyCZoneN(raster_tiles_tracy, "RasterTiles", true);
+    const uint32_t tile_count = buff->tile_count_x * buff->tile_count_y;
+    thread_pool_run(g_raster_pool, tile_count, rasterize_tile_job, buff);
+
+    // The binned triangles stay in the pools until the next renderer_begin_frame, only the lists go
+    for (uint32_t i = 0; i < tile_count; ++i) {
+        buff->tiles[i].first_bin = 0;
+        buff->tiles[i].last_bin = 0;
+        buff->tiles[i].triangle_count = 0;
+    }
+    TracyCZoneEnd(raster_tiles_tracy);
+}
+
+void renderer_end_frame(graphics_buffer *buff) {
+    renderer_flush_tiles(buff);
+
+    // Immediate mode filled on this thread
+    flush_pixel_counters();
+    publish_stats(buff);
+}
+
+void renderer_get_stats(renderer_stats *stats) {
+    *stats = g_last_stats;
+}
+
+
+// Post-transform scratch shared by the render_obj* calls. Draws are submitted from one thread.
+static clip_vertices g_clip_vertices;
+
+static inline void gather_ndc(const clip_vertices *restrict verts, const uint32_t index, vec3 dest) {
+    const float inv_w = verts->inv_w[index];
+    dest[0] = verts->x[index] * inv_w;
+    dest[1] = verts->y[index] * inv_w;
+    dest[2] = verts->z[index] * inv_w;
+}
 
 static inline void get_cam_view_mat4(camera cam, mat4 dest) {
     mat4 rotation_mat = GLM_MAT4_IDENTITY_INIT;
@@ -137,55 +1063,196 @@ static inline void swap_int(int *a, int *b) {
     *b = temp;
 }
 
-void draw_line(
-    const graphics_buffer *restrict buff,
-    int x0, int y0,
-    int x1, int y1,
-    const uint8_t r,
-    const uint8_t g,
-    const uint8_t b
-) {
-    // --- Fast path for horizontal lines ---
-    if (y0 == y1) {
-        if (x0 > x1) swap_int(&x0, &x1);
-        for (int x = x0; x <= x1; x++) {
-            set_pixel(buff, x, y0, r, g, b);
+static line_mode g_line_mode = LINE_MODE_ALIASED;
+
+void renderer_set_line_mode(const line_mode mode) {
+    g_line_mode = mode;
+}
+
+// OUTCODE_* bits of a screen-space point against [0, x_max] x [0, y_max]. Screen y points
+// down, so OUTCODE_TOP is y < 0.
+static inline uint32_t screen_outcode(const float x, const float y, const float x_max, const float y_max) {
+    uint32_t code = 0;
+    if (x < 0.0f) code |= OUTCODE_LEFT;
+    if (x > x_max) code |= OUTCODE_RIGHT;
+    if (y < 0.0f) code |= OUTCODE_TOP;
+    if (y > y_max) code |= OUTCODE_BOTTOM;
+    return code;
+}
+
+// Cohen-Sutherland outcodes for the trivial cases, Liang-Barsky for the rest: one pass over the
+// four edges finds the parameter range of the segment inside the rect. Returns false when
+// nothing is left.
+static bool clip_line_to_rect(float p[4], const float x_max, const float y_max) {
+    const uint32_t code0 = screen_outcode(p[0], p[1], x_max, y_max);
+    const uint32_t code1 = screen_outcode(p[2], p[3], x_max, y_max);
+    if ((code0 | code1) == 0) {
+        return true;
+    }
+    if (code0 & code1) {
+        return false;
+    }
+
+    const float dx = p[2] - p[0];
+    const float dy = p[3] - p[1];
+    const float edge_p[4] = {-dx, dx, -dy, dy};
+    const float edge_q[4] = {p[0], x_max - p[0], p[1], y_max - p[1]};
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int e = 0; e < 4; ++e) {
+        if (edge_p[e] == 0.0f) {
+            // Parallel to the edge: inside or out entirely
+            if (edge_q[e] < 0.0f) {
+                return false;
+            }
+            continue;
+        }
+
+        const float t = edge_q[e] / edge_p[e];
+        if (edge_p[e] < 0.0f) {
+            t0 = max(t0, t);
+        } else {
+            t1 = min(t1, t);
+        }
+    }
+    if (t0 > t1) {
+        return false;
+    }
+
+    // Rounding can leave the new ends a hair outside, the clamps put them back
+    const float x0 = p[0], y0 = p[1];
+    p[0] = glm_clamp(x0 + t0 * dx, 0.0f, x_max);
+    p[1] = glm_clamp(y0 + t0 * dy, 0.0f, y_max);
+    p[2] = glm_clamp(x0 + t1 * dx, 0.0f, x_max);
+    p[3] = glm_clamp(y0 + t1 * dy, 0.0f, y_max);
+    return true;
+}
+
+static inline uint32_t blend_color(const uint32_t dst, const uint32_t color, const float coverage) {
+    const uint32_t w = (uint32_t) (coverage * 256.0f);
+    const uint32_t inv_w = 256 - w;
+    const uint32_t rb = ((dst & 0x00FF00FF) * inv_w + (color & 0x00FF00FF) * w) >> 8;
+    const uint32_t g = ((dst & 0x0000FF00) * inv_w + (color & 0x0000FF00) * w) >> 8;
+    return (rb & 0x00FF00FF) | (g & 0x0000FF00);
+}
+
+static inline void plot_coverage(const graphics_buffer *restrict buff, const int x, const int y,
+                                 const uint32_t color, const float coverage) {
+    if ((uint32_t) x < buff->width && (uint32_t) y < buff->height) {
+        uint32_t *restrict pixel = (uint32_t *) buff->memory + y * buff->width + x;
+        *pixel = blend_color(*pixel, color, coverage);
+    }
+}
+
+// Xiaolin Wu: two pixels per step across the minor axis, weighted by their distance to the
+// line. Endpoints are already clipped, only the second pixel of a pair can leave the buffer.
+static void draw_line_wu(const graphics_buffer *restrict buff, float x0, float y0, float x1, float y1,
+                         const uint32_t color) {
+    const bool steep = fabsf(y1 - y0) > fabsf(x1 - x0);
+    if (steep) {
+        float t = x0; x0 = y0; y0 = t;
+        t = x1; x1 = y1; y1 = t;
+    }
+    if (x0 > x1) {
+        float t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+    }
+
+    const float dx = x1 - x0;
+    const float gradient = dx > 0.0f ? (y1 - y0) / dx : 1.0f;
+
+    // Pixel centers are at +0.5, same as the solid lines' truncation
+    const int start = (int) floorf(x0);
+    const int end = (int) floorf(x1);
+    float y = y0 + gradient * ((float) start + 0.5f - x0) - 0.5f;
+    for (int x = start; x <= end; ++x) {
+        const float y_floor = floorf(y);
+        const int iy = (int) y_floor;
+        const float frac = y - y_floor;
+        if (steep) {
+            plot_coverage(buff, iy, x, color, 1.0f - frac);
+            plot_coverage(buff, iy + 1, x, color, frac);
+        } else {
+            plot_coverage(buff, x, iy, color, 1.0f - frac);
+            plot_coverage(buff, x, iy + 1, color, frac);
         }
+        y += gradient;
+    }
+}
+
+// Lines are clipped to the buffer first, so the writes below need no per-pixel checks.
+// Axis-aligned runs are plain span writes and everything else is Bresenham stepping a pixel
+// pointer: +-1 along x, +-width along y.
+static void draw_line(const graphics_buffer *restrict buff, const float x0, const float y0, const float x1,
+                      const float y1, const uint32_t color) {
+    if (buff->width == 0 || buff->height == 0) {
         return;
     }
 
-    // --- Fast path for vertical lines ---
-    if (x0 == x1) {
-        if (y0 > y1) swap_int(&y0, &y1);
-        for (int y = y0; y <= y1; y++) {
-            set_pixel(buff, x0, y, r, g, b);
+    // Truncation maps [0, width) to the pixels, so clip just short of width
+    float p[4] = {x0, y0, x1, y1};
+    if (!clip_line_to_rect(p, (float) buff->width - 1.0f / 256.0f, (float) buff->height - 1.0f / 256.0f)) {
+        return;
+    }
+
+    // Wu lines also touch the pixel after the last one across the minor axis
+    const int32_t pad = g_line_mode == LINE_MODE_ANTIALIASED;
+    mark_dirty(buff, max((int32_t) min(p[0], p[2]) - pad, 0), max((int32_t) min(p[1], p[3]) - pad, 0),
+               min((int32_t) max(p[0], p[2]) + pad, (int32_t) buff->width - 1),
+               min((int32_t) max(p[1], p[3]) + pad, (int32_t) buff->height - 1));
+
+    if (g_line_mode == LINE_MODE_ANTIALIASED) {
+        draw_line_wu(buff, p[0], p[1], p[2], p[3], color);
+        return;
+    }
+
+    int ix0 = (int) p[0], iy0 = (int) p[1];
+    int ix1 = (int) p[2], iy1 = (int) p[3];
+    uint32_t *restrict pixels = buff->memory;
+    const int pitch = (int) buff->width;
+
+    // --- Horizontal span ---
+    if (iy0 == iy1) {
+        if (ix0 > ix1) swap_int(&ix0, &ix1);
+        uint32_t *restrict row = pixels + iy0 * pitch;
+        for (int x = ix0; x <= ix1; x++) {
+            row[x] = color;
         }
         return;
     }
 
-    // --- Unified Bresenham's algorithm for all other cases ---
-    const int dx = iabs(x1 - x0);
-    const int dy = -iabs(y1 - y0); // dy is negative
-    const int incX = (x0 < x1) ? 1 : -1;
-    const int incY = (y0 < y1) ? 1 : -1;
-    int error = dx + dy; // Initial error value
+    // --- Vertical span ---
+    if (ix0 == ix1) {
+        if (iy0 > iy1) swap_int(&iy0, &iy1);
+        uint32_t *restrict pixel = pixels + iy0 * pitch + ix0;
+        for (int y = iy0; y <= iy1; y++, pixel += pitch) {
+            *pixel = color;
+        }
+        return;
+    }
 
-    while (1) {
-        set_pixel(buff, x0, y0, r, g, b);
+    // --- Bresenham for all other cases ---
+    const int dx = iabs(ix1 - ix0);
+    const int dy = -iabs(iy1 - iy0); // dy is negative
+    const int step_x = isgn(ix1 - ix0);
+    const int step_y = isgn(iy1 - iy0) * pitch;
+    int error = dx + dy;
 
-        // Check if the end point has been reached
-        if (x0 == x1 && y0 == y1) break;
+    uint32_t *restrict pixel = pixels + iy0 * pitch + ix0;
+    uint32_t *const last = pixels + iy1 * pitch + ix1;
+    for (;;) {
+        *pixel = color;
+        if (pixel == last) break;
 
         const int e2 = 2 * error;
         if (e2 >= dy) {
             // Favor moving in X
             error += dy;
-            x0 += incX;
+            pixel += step_x;
         }
         if (e2 <= dx) {
             // Favor moving in Y
             error += dx;
-            y0 += incY;
+            pixel += step_y;
         }
     }
 }
@@ -200,60 +1267,144 @@ void set_pixel(
 ) {
     uint32_t *restrict pixels = buffer->memory;
     pixels[y * buffer->width + x] = (r << 16) | (g << 8) | b;
+    mark_dirty(buffer, (int32_t) x, (int32_t) y, (int32_t) x, (int32_t) y);
 }
 
-void model_build_unique_edges(model *m) {
-    TracyCZone(model_build_unique_edges, true);
+// Edges are keyed as (smaller index << 32 | larger index) so (v0, v1) and (v1, v0) collide.
+// Keys go into an open-addressing table sized to at least twice the worst case (one new edge
+// per index), which keeps probe chains short and makes the whole build linear in index_count.
+#define EDGE_HASH_EMPTY UINT64_MAX
 
-    uint32_t capacity = m->index_count;
-    model_edge *restrict unique_edges = malloc(sizeof(model_edge) * capacity);
-    uint32_t unique_count = 0;
+static inline uint64_t edge_key(const uint32_t a, const uint32_t b) {
+    return a < b ? (uint64_t) a << 32 | b : (uint64_t) b << 32 | a;
+}
+
+static inline uint32_t edge_hash(const uint64_t key, const uint32_t shift) {
+    // Fibonacci hashing, top bits of the product are the best mixed
+    return (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+static void build_unique_edges(model *restrict m, const bool build_adjacency) {
+    m->edges = 0;
+    m->edge_count = 0;
+    m->edge_triangles = 0;
+
+    // Without a whole triangle there would be no edges, and shrinking the arrays to zero below
+    // would free them
+    if (m->index_count < 3) {
+        return;
+    }
+    const uint32_t max_edges = m->index_count;
+
+    uint32_t table_bits = 4;
+    while ((1u << table_bits) < max_edges * 2) {
+        table_bits++;
+    }
+    const uint32_t table_size = 1u << table_bits;
+    const uint32_t table_mask = table_size - 1;
+    const uint32_t shift = 64 - table_bits;
+
+    uint64_t *restrict keys = malloc(sizeof(uint64_t) * table_size);
+    uint32_t *restrict slots = malloc(sizeof(uint32_t) * table_size);
+    model_edge *restrict unique_edges = malloc(sizeof(model_edge) * max_edges);
+    model_edge_triangles *restrict triangles = build_adjacency
+                                                   ? malloc(sizeof(model_edge_triangles) * max_edges)
+                                                   : 0;
+    if (!keys || !slots || !unique_edges || (build_adjacency && !triangles)) {
+        free(keys);
+        free(slots);
+        free(unique_edges);
+        free(triangles);
+        return;
+    }
+    TracyCAlloc(keys, sizeof(uint64_t) * table_size);
+    TracyCAlloc(slots, sizeof(uint32_t) * table_size);
+    memset(keys, 0xFF, sizeof(uint64_t) * table_size); // EDGE_HASH_EMPTY
 
-    for (uint32_t i = 0; i < m->index_count; i += 3) {
+    uint32_t unique_count = 0;
+    for (uint32_t i = 0; i + 2 < m->index_count; i += 3) {
         const uint32_t indices[3] = {m->indices[i], m->indices[i + 1], m->indices[i + 2]};
-        const model_edge triangle_edges[3] = {
-            {indices[0], indices[1]}, {indices[1], indices[2]}, {indices[2], indices[0]}
-        };
+        const uint32_t triangle = i / 3;
 
         for (int j = 0; j < 3; j++) {
-            // Canonical representation (smaller index first) to ensure (v0, v1) is the same as (v1, v0)
-            const uint32_t v_start = triangle_edges[j].v0 < triangle_edges[j].v1
-                                         ? triangle_edges[j].v0
-                                         : triangle_edges[j].v1;
-            const uint32_t v_end = triangle_edges[j].v0 > triangle_edges[j].v1
-                                       ? triangle_edges[j].v0
-                                       : triangle_edges[j].v1;
-
-            bool found = false;
-            for (uint32_t k = 0; k < unique_count; k++) {
-                if (unique_edges[k].v0 == v_start && unique_edges[k].v1 == v_end) {
-                    found = true;
-                    break;
-                }
+            const uint32_t a = indices[j];
+            const uint32_t b = indices[j == 2 ? 0 : j + 1];
+            const uint64_t key = edge_key(a, b);
+
+            uint32_t slot = edge_hash(key, shift);
+            while (keys[slot] != EDGE_HASH_EMPTY && keys[slot] != key) {
+                slot = (slot + 1) & table_mask;
             }
 
-            if (!found) {
-                if (unique_count >= capacity) {
-                    capacity *= 2;
-                    unique_edges = realloc(unique_edges, sizeof(model_edge) * capacity);
+            if (keys[slot] == key) {
+                // Seen before: only the adjacency changes. Non-manifold edges keep their first two triangles.
+                if (triangles && triangles[slots[slot]].t1 == MODEL_EDGE_NO_TRIANGLE) {
+                    triangles[slots[slot]].t1 = triangle;
                 }
-                unique_edges[unique_count++] = (model_edge){v_start, v_end};
+                continue;
             }
+
+            keys[slot] = key;
+            slots[slot] = unique_count;
+            unique_edges[unique_count] = (model_edge){(uint32_t) (key >> 32), (uint32_t) key};
+            if (triangles) {
+                triangles[unique_count] = (model_edge_triangles){triangle, MODEL_EDGE_NO_TRIANGLE};
+            }
+            unique_count++;
         }
     }
 
+    TracyCFree(keys);
+    free(keys);
+    TracyCFree(slots);
+    free(slots);
+
+    // Give back the worst-case slack
+    model_edge *edges = realloc(unique_edges, sizeof(model_edge) * unique_count);
+    m->edges = edges ? edges : unique_edges;
     m->edge_count = unique_count;
-    m->edges = malloc(sizeof(model_edge) * m->edge_count);
-    TracyCAlloc(m->edges, sizeof(model_edge) * m->edge_count);
-    if (m->edges) {
-        memcpy(m->edges, unique_edges, sizeof(model_edge) * m->edge_count);
+    TracyCAlloc(m->edges, sizeof(model_edge) * unique_count);
+
+    if (triangles) {
+        model_edge_triangles *shrunk = realloc(triangles, sizeof(model_edge_triangles) * unique_count);
+        m->edge_triangles = shrunk ? shrunk : triangles;
+        TracyCAlloc(m->edge_triangles, sizeof(model_edge_triangles) * unique_count);
     }
-    TracyCFree(unique_edges);
-    free(unique_edges);
+}
 
+void model_build_unique_edges(model *m) {
+    TracyCZone(model_build_unique_edges, true);
+    build_unique_edges(m, false);
     TracyCZoneEnd(model_build_unique_edges);
 }
 
+void model_build_edge_adjacency(model *m) {
+    TracyCZone(model_build_edge_adjacency, true);
+    build_unique_edges(m, true);
+    TracyCZoneEnd(model_build_edge_adjacency);
+}
+
+void model_build_bounds(model *m) {
+    m->has_bounds = false;
+    instance_stage_model_bounds(m, m->bounds);
+    m->has_bounds = true;
+}
+
+void model_free(model *m) {
+    model_free_meshlets(m);
+    model_free_lods(m);
+
+    void *arrays[] = {m->vertices, m->indices, m->edges, m->edge_triangles, m->attributes};
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i) {
+        if (arrays[i]) {
+            TracyCFree(arrays[i]);
+            free(arrays[i]);
+        }
+    }
+
+    *m = (model){0};
+}
+
 
 void render_obj_wire(model model, vec3 pos, versor rot, vec3 scale, camera *restrict cam,
                      graphics_buffer *restrict buff) {
@@ -280,33 +1431,44 @@ void render_obj_wire(model model, vec3 pos, versor rot, vec3 scale, camera *rest
     const float half_width = 0.5f * (float) buff->width;
     const float half_height = 0.5f * (float) buff->height;
 
+    // Transform every vertex once, edges only gather
+    clip_vertices *restrict verts = &g_clip_vertices;
+    vertex_stage_transform(mvp_mat, model.vertices, model.vertex_count, verts);
+    if (verts->count != model.vertex_count) {
+        return;
+    }
+
     for (uint32_t i = 0; i < model.edge_count; ++i) {
         // Get vertex indices for the current edge
         const uint32_t i0 = model.edges[i].v0;
         const uint32_t i1 = model.edges[i].v1;
 
-        // Transform vertices to Clip Space
-        vec4 clip_v0, clip_v1;
-        glm_mat4_mulv(mvp_mat, model.vertices[i0], clip_v0);
-        glm_mat4_mulv(mvp_mat, model.vertices[i1], clip_v1);
-
-        // Simple Near-Plane Culling for the line segment
-        if (clip_v0[3] <= 0.0f || clip_v1[3] <= 0.0f) {
+        // Trivial rejection: both ends outside the same plane
+        if ((verts->outcode[i0] & verts->outcode[i1]) != 0) {
             continue;
         }
 
+        // Near-Plane Clipping for the line segment
+        vec4 clip_v0 = {verts->x[i0], verts->y[i0], verts->z[i0], verts->w[i0]};
+        vec4 clip_v1 = {verts->x[i1], verts->y[i1], verts->z[i1], verts->w[i1]};
+        if ((verts->outcode[i0] | verts->outcode[i1]) & OUTCODE_NEAR) {
+            if (!clip_stage_line_near(clip_v0, clip_v1)) {
+                continue;
+            }
+        }
+
         // Perspective Divide
         vec3 ndc_v0, ndc_v1;
         glm_vec3_divs((vec3){clip_v0[0], clip_v0[1], clip_v0[2]}, clip_v0[3], ndc_v0);
         glm_vec3_divs((vec3){clip_v1[0], clip_v1[1], clip_v1[2]}, clip_v1[3], ndc_v1);
 
-        // Viewport Transform
-        const int sx0 = (ndc_v0[0] + 1.0f) * half_width;
-        const int sy0 = (1.0f - ndc_v0[1]) * half_height;
-        const int sx1 = (ndc_v1[0] + 1.0f) * half_width;
-        const int sy1 = (1.0f - ndc_v1[1]) * half_height;
+        // Viewport Transform. Off-screen ends are left to draw_line's clipping.
+        const float sx0 = (ndc_v0[0] + 1.0f) * half_width;
+        const float sy0 = (1.0f - ndc_v0[1]) * half_height;
+        const float sx1 = (ndc_v1[0] + 1.0f) * half_width;
+        const float sy1 = (1.0f - ndc_v1[1]) * half_height;
 
-        draw_line(buff, sx0, sy0, sx1, sy1, 0xFF, 0x00, 0xFF);
+        draw_line(buff, sx0, sy0, sx1, sy1, 0xFF << 16 | 0x00 << 8 | 0xFF);
     }
 }
 
@@ -335,49 +1497,64 @@ void render_obj(model model, vec3 pos, versor rot, vec3 scale, camera *restrict
     const float half_width = 0.5f * (float) buff->width;
     const float half_height = 0.5f * (float) buff->height;
 
-    // --- 2. Process each triangle of the model ---
+    // --- 2. Transform every vertex once from Model Space to Clip Space ---
+    clip_vertices *restrict verts = &g_clip_vertices;
+    vertex_stage_transform(mvp_mat, model.vertices, model.vertex_count, verts);
+    if (verts->count != model.vertex_count) {
+        return;
+    }
+
+    // --- 3. Process each triangle of the model ---
     for (int i = 0; i < model.index_count; i += 3) {
         const uint32_t i0 = model.indices[i];
         const uint32_t i1 = model.indices[i + 1];
         const uint32_t i2 = model.indices[i + 2];
 
-        // --- 2a. Transform vertices from Model Space to Clip Space ---
-        vec4 clip_v0, clip_v1, clip_v2;
-        glm_mat4_mulv(mvp_mat, model.vertices[i0], clip_v0);
-        glm_mat4_mulv(mvp_mat, model.vertices[i1], clip_v1);
-        glm_mat4_mulv(mvp_mat, model.vertices[i2], clip_v2);
-
-        // --- 2b. CRITICAL: Near-Plane Culling ---
-        // Discard any triangle with a vertex behind or on the camera's near plane.
-        if (clip_v0[3] <= 0.0f || clip_v1[3] <= 0.0f || clip_v2[3] <= 0.0f) {
+        // --- 3a. OPTIMIZATION: Frustum Culling (Trivial Rejection) ---
+        // Discard triangles that are entirely outside the viewing volume.
+        // If the bitwise AND is non-zero, all 3 vertices are outside the same plane.
+        if ((verts->outcode[i0] & verts->outcode[i1] & verts->outcode[i2]) != 0) {
             continue;
         }
 
-        // --- 2c. Perspective Divide (to Normalized Device Coordinates) ---
-        vec3 ndc_v0, ndc_v1, ndc_v2; {
-            // Use reciprocal multiplication (faster than division)
-            const float recip_w0 = 1.0f / clip_v0[3];
-            ndc_v0[0] = clip_v0[0] * recip_w0;
-            ndc_v0[1] = clip_v0[1] * recip_w0;
-            ndc_v0[2] = clip_v0[2] * recip_w0;
+        // --- 3b. CRITICAL: Near-Plane Clipping ---
+        // A triangle crossing the near plane becomes a quad that lies entirely in front of it.
+        clip_vertex polygon[CLIP_MAX_POLYGON_VERTICES];
+        uint32_t polygon_count = 3;
+        {
+            const uint32_t indices[3] = {i0, i1, i2};
+            for (int k = 0; k < 3; ++k) {
+                polygon[k].position[0] = verts->x[indices[k]];
+                polygon[k].position[1] = verts->y[indices[k]];
+                polygon[k].position[2] = verts->z[indices[k]];
+                polygon[k].position[3] = verts->w[indices[k]];
+            }
 
-            const float recip_w1 = 1.0f / clip_v1[3];
-            ndc_v1[0] = clip_v1[0] * recip_w1;
-            ndc_v1[1] = clip_v1[1] * recip_w1;
-            ndc_v1[2] = clip_v1[2] * recip_w1;
+            if ((verts->outcode[i0] | verts->outcode[i1] | verts->outcode[i2]) & OUTCODE_NEAR) {
+                const clip_vertex triangle[3] = {polygon[0], polygon[1], polygon[2]};
+                polygon_count = clip_stage_polygon(triangle, CLIP_PLANE_NEAR, (clip_guard_band){0}, 0, polygon);
+                if (polygon_count < 3) {
+                    continue;
+                }
+            }
+        }
 
-            const float recip_w2 = 1.0f / clip_v2[3];
-            ndc_v2[0] = clip_v2[0] * recip_w2;
-            ndc_v2[1] = clip_v2[1] * recip_w2;
-            ndc_v2[2] = clip_v2[2] * recip_w2;
+        // --- 3c. Perspective Divide (to Normalized Device Coordinates) ---
+        vec3 ndc[CLIP_MAX_POLYGON_VERTICES];
+        for (uint32_t k = 0; k < polygon_count; ++k) {
+            const float recip_w = 1.0f / polygon[k].position[3];
+            ndc[k][0] = polygon[k].position[0] * recip_w;
+            ndc[k][1] = polygon[k].position[1] * recip_w;
+            ndc[k][2] = polygon[k].position[2] * recip_w;
         }
 
-        // --- 2d. OPTIMIZATION: Back-Face Culling ---
-        // Discard triangles that are facing away from the camera.
+        // --- 3d. OPTIMIZATION: Back-Face Culling ---
+        // Discard triangles that are facing away from the camera. The clipped polygon is planar,
+        // so its first three vertices have the triangle's winding.
         {
             vec3 edge1, edge2;
-            glm_vec3_sub(ndc_v1, ndc_v0, edge1);
-            glm_vec3_sub(ndc_v2, ndc_v0, edge2);
+            glm_vec3_sub(ndc[1], ndc[0], edge1);
+            glm_vec3_sub(ndc[2], ndc[0], edge2);
             vec3 normal;
             glm_vec3_cross(edge1, edge2, normal);
             if (normal[2] > 0.0f) {
@@ -386,45 +1563,272 @@ void render_obj(model model, vec3 pos, versor rot, vec3 scale, camera *restrict
             }
         }
 
-        // --- 2e. OPTIMIZATION: Frustum Culling (Trivial Rejection) ---
-        // Discard triangles that are entirely outside the viewing volume.
-        {
-            const int outcode0 = compute_outcode(ndc_v0);
-            const int outcode1 = compute_outcode(ndc_v1);
-            const int outcode2 = compute_outcode(ndc_v2);
+        // --- 3e. Viewport Transform (NDC to Screen Coordinates) and outline ---
+        // Map X from [-1, 1] to [0, screen_width], Y from [-1, 1] to [screen_height, 0]
+        // (inverting Y for top-left origin). Edges keep the red/green/blue order of the triangle.
+        static const uint32_t edge_colors[3] = {0xFF << 16, 0xFF << 8, 0xFF};
+        for (uint32_t k = 0; k < polygon_count; ++k) {
+            const uint32_t next = k + 1 == polygon_count ? 0 : k + 1;
+            draw_line(buff,
+                      (ndc[k][0] + 1.0f) * half_width, (1.0f - ndc[k][1]) * half_height,
+                      (ndc[next][0] + 1.0f) * half_width, (1.0f - ndc[next][1]) * half_height,
+                      edge_colors[k % 3]);
+        }
+    }
+}
 
-            // If the bitwise AND is non-zero, all 3 vertices are outside the same plane.
-            if ((outcode0 & outcode1 & outcode2) != 0) {
-                continue;
+// Clears larger than this go around the cache: the frame will not read them back before
+// the rasterizer writes them again, and a 4K clear would flush everything else out.
+#define CLEAR_STREAM_BYTES (1u << 20)
+
+// Fills count 32-bit words, through non-temporal stores when stream is set. Rows are rarely
+// 32-byte aligned, so the head and tail are scalar.
+static inline void fill_words(uint32_t *restrict dst, size_t count, const uint32_t value, const bool stream) {
+    while (count && ((uintptr_t) dst & 31)) {
+        *dst++ = value;
+        count--;
+    }
+
+    const simde__m256i fill = simde_mm256_set1_epi32((int32_t) value);
+    if (stream) {
+        for (; count >= 8; count -= 8, dst += 8) {
+            simde_mm256_stream_si256((simde__m256i *) dst, fill);
+        }
+    } else {
+        for (; count >= 8; count -= 8, dst += 8) {
+            simde_mm256_store_si256((simde__m256i *) dst, fill);
+        }
+    }
+
+    while (count--) {
+        *dst++ = value;
+    }
+}
+
+// Color, depth and Hi-Z of pixels [x0, x1] x [y0, y1] in one pass. Depth padding past the
+// buffer's edges is never written by the fills, so it keeps the far plane from depth init.
+static void clear_rect(const graphics_buffer *restrict buffer, const int32_t x0, const int32_t y0,
+                       const int32_t x1, const int32_t y1, const bool stream) {
+    constexpr uint32_t far_plane = 0x3F800000; // 1.0f
+    const size_t span = (size_t) (x1 - x0 + 1);
+
+    for (int32_t y = y0; y <= y1; ++y) {
+        fill_words((uint32_t *) ((uint8_t *) buffer->memory + (size_t) y * buffer->pitch) + x0, span, 0, stream);
+        if (buffer->depth) {
+            fill_words((uint32_t *) (buffer->depth + (size_t) y * buffer->depth_pitch + x0), span, far_plane, stream);
+        }
+    }
+
+    if (buffer->depth) {
+        for (int32_t by = y0 / RASTER_HIZ_BLOCK_SIZE; by <= y1 / RASTER_HIZ_BLOCK_SIZE; ++by) {
+            for (int32_t bx = x0 / RASTER_HIZ_BLOCK_SIZE; bx <= x1 / RASTER_HIZ_BLOCK_SIZE; ++bx) {
+                buffer->hiz_min[by * buffer->hiz_width + bx] = 1.0f;
+                buffer->hiz_max[by * buffer->hiz_width + bx] = 1.0f;
+            }
+        }
+    }
+}
+
+void clean_buff(const graphics_buffer *restrict buffer) {
+    TracyCZone(clean_buff_tracy, true);
+
+    const size_t bytes_per_pixel = buffer->depth ? 8 : 4;
+    if (!buffer->dirty) {
+        const bool stream = (size_t) buffer->width * buffer->height * bytes_per_pixel > CLEAR_STREAM_BYTES;
+        clear_rect(buffer, 0, 0, (int32_t) buffer->width - 1, (int32_t) buffer->height - 1, stream);
+    } else {
+        size_t drawn_count = 0;
+        const size_t tile_count = (size_t) buffer->dirty_width * buffer->dirty_height;
+        for (size_t i = 0; i < tile_count; ++i) {
+            drawn_count += buffer->dirty[i] & RASTER_DIRTY_DRAWN;
+        }
+        const bool stream = drawn_count * RASTER_TILE_SIZE * RASTER_TILE_SIZE * bytes_per_pixel > CLEAR_STREAM_BYTES;
+
+        // Runs of drawn tiles along each tile row become one wider clear
+        for (uint32_t ty = 0; ty < buffer->dirty_height && drawn_count; ++ty) {
+            uint8_t *restrict row = buffer->dirty + ty * buffer->dirty_width;
+            for (uint32_t tx = 0; tx < buffer->dirty_width;) {
+                if (!(row[tx] & RASTER_DIRTY_DRAWN)) {
+                    tx++;
+                    continue;
+                }
+
+                const uint32_t first = tx;
+                for (; tx < buffer->dirty_width && (row[tx] & RASTER_DIRTY_DRAWN); ++tx) {
+                    row[tx] = RASTER_DIRTY_CHANGED; // Cleared pixels differ from the presented ones
+                }
+                clear_rect(buffer, (int32_t) (first * RASTER_TILE_SIZE), (int32_t) (ty * RASTER_TILE_SIZE),
+                           min((int32_t) (tx * RASTER_TILE_SIZE), (int32_t) buffer->width) - 1,
+                           min((int32_t) ((ty + 1) * RASTER_TILE_SIZE), (int32_t) buffer->height) - 1, stream);
             }
         }
+    }
+
+    // Order the streamed stores before the rasterizer's
+    simde_mm_sfence();
+
+    TracyCZoneEnd(clean_buff_tracy);
+}
+
+void renderer_dirty_free(graphics_buffer *buff) {
+    if (buff->dirty) {
+        TracyCFree(buff->dirty);
+        free(buff->dirty);
+    }
+
+    buff->dirty = 0;
+    buff->dirty_width = 0;
+    buff->dirty_height = 0;
+}
+
+void renderer_dirty_init(graphics_buffer *buff) {
+    renderer_dirty_free(buff);
+
+    const uint32_t dirty_width = (buff->width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    const uint32_t dirty_height = (buff->height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    const size_t size = (size_t) dirty_width * dirty_height;
+    if (size == 0) {
+        return;
+    }
 
-        // --- 2f. Viewport Transform (NDC to Screen Coordinates) ---
-        vec3 screen_v0, screen_v1, screen_v2; {
-            // Map X from [-1, 1] to [0, screen_width]
-            screen_v0[0] = (ndc_v0[0] + 1.0f) * half_width;
-            screen_v1[0] = (ndc_v1[0] + 1.0f) * half_width;
-            screen_v2[0] = (ndc_v2[0] + 1.0f) * half_width;
+    buff->dirty = malloc(size);
+    if (!buff->dirty) {
+        return;
+    }
+    TracyCAlloc(buff->dirty, size);
+
+    // Whatever the buffer holds is unknown: clear and present all of it once
+    memset(buff->dirty, RASTER_DIRTY_DRAWN | RASTER_DIRTY_CHANGED, size);
+    buff->dirty_width = dirty_width;
+    buff->dirty_height = dirty_height;
+}
+
+uint32_t renderer_take_dirty_rects(graphics_buffer *buff, ivec4 *rects, const uint32_t capacity) {
+    uint32_t count = 0;
+    bool overflow = !buff->dirty || capacity == 0;
+
+    for (uint32_t ty = 0; ty < buff->dirty_height && !overflow; ++ty) {
+        uint8_t *restrict row = buff->dirty + ty * buff->dirty_width;
+        const uint32_t previous_row_end = count;
+        const int32_t y0 = (int32_t) (ty * RASTER_TILE_SIZE);
+        const int32_t y1 = min((int32_t) ((ty + 1) * RASTER_TILE_SIZE), (int32_t) buff->height) - 1;
+
+        for (uint32_t tx = 0; tx < buff->dirty_width;) {
+            if (!(row[tx] & RASTER_DIRTY_CHANGED)) {
+                tx++;
+                continue;
+            }
+
+            const uint32_t first = tx;
+            for (; tx < buff->dirty_width && (row[tx] & RASTER_DIRTY_CHANGED); ++tx) {
+                row[tx] &= (uint8_t) ~RASTER_DIRTY_CHANGED;
+            }
+            const int32_t x0 = (int32_t) (first * RASTER_TILE_SIZE);
+            const int32_t x1 = min((int32_t) (tx * RASTER_TILE_SIZE), (int32_t) buff->width) - 1;
+
+            // Extend the rectangle above when it has exactly this span
+            bool merged = false;
+            for (uint32_t r = 0; r < previous_row_end; ++r) {
+                if (rects[r][0] == x0 && rects[r][2] == x1 && rects[r][3] == y0 - 1) {
+                    rects[r][3] = y1;
+                    merged = true;
+                    break;
+                }
+            }
+            if (merged) {
+                continue;
+            }
 
-            // Map Y from [-1, 1] to [screen_height, 0] (inverting Y for top-left origin)
-            screen_v0[1] = (1.0f - ndc_v0[1]) * half_height;
-            screen_v1[1] = (1.0f - ndc_v1[1]) * half_height;
-            screen_v2[1] = (1.0f - ndc_v2[1]) * half_height;
+            if (count == capacity) {
+                overflow = true;
+                break;
+            }
+            rects[count][0] = x0;
+            rects[count][1] = y0;
+            rects[count][2] = x1;
+            rects[count][3] = y1;
+            count++;
+        }
+    }
 
-            // Map Z from [-1, 1] to [0, 1] for the depth buffer
-            screen_v0[2] = (ndc_v0[2] + 1.0f) * 0.5f;
-            screen_v1[2] = (ndc_v1[2] + 1.0f) * 0.5f;
-            screen_v2[2] = (ndc_v2[2] + 1.0f) * 0.5f;
+    if (overflow) {
+        if (buff->dirty) {
+            const size_t tile_count = (size_t) buff->dirty_width * buff->dirty_height;
+            for (size_t i = 0; i < tile_count; ++i) {
+                buff->dirty[i] &= (uint8_t) ~RASTER_DIRTY_CHANGED;
+            }
         }
+        if (capacity == 0) {
+            return 0;
+        }
+        rects[0][0] = 0;
+        rects[0][1] = 0;
+        rects[0][2] = (int32_t) buff->width - 1;
+        rects[0][3] = (int32_t) buff->height - 1;
+        return 1;
+    }
+
+    return count;
+}
 
-        draw_line(buff, screen_v0[0], screen_v0[1], screen_v1[0], screen_v1[1], 0xFF, 0x00, 0x00);
-        draw_line(buff, screen_v1[0], screen_v1[1], screen_v2[0], screen_v2[1], 0x00, 0xFF, 0x00);
-        draw_line(buff, screen_v2[0], screen_v2[1], screen_v0[0], screen_v0[1], 0x00, 0x00, 0xFF);
+void renderer_depth_free(graphics_buffer *buff) {
+    if (buff->depth) {
+        TracyCFree(buff->depth);
+        free(buff->depth);
+        TracyCFree(buff->hiz_min);
+        free(buff->hiz_min);
+        TracyCFree(buff->hiz_max);
+        free(buff->hiz_max);
     }
+
+    buff->depth = 0;
+    buff->depth_pitch = 0;
+    buff->hiz_min = 0;
+    buff->hiz_max = 0;
+    buff->hiz_width = 0;
+    buff->hiz_height = 0;
 }
 
-void clean_buff(const graphics_buffer *restrict buffer) {
-    memset(buffer->memory, 0, buffer->pitch * buffer->height);
+void renderer_depth_init(graphics_buffer *buff) {
+    renderer_depth_free(buff);
+
+    const uint32_t hiz_width = (buff->width + RASTER_HIZ_BLOCK_SIZE - 1) / RASTER_HIZ_BLOCK_SIZE;
+    const uint32_t hiz_height = (buff->height + RASTER_HIZ_BLOCK_SIZE - 1) / RASTER_HIZ_BLOCK_SIZE;
+    const size_t depth_size = sizeof(float) * hiz_width * hiz_height * RASTER_HIZ_BLOCK_SIZE * RASTER_HIZ_BLOCK_SIZE;
+    const size_t hiz_size = sizeof(float) * hiz_width * hiz_height;
+    if (depth_size == 0) {
+        return;
+    }
+
+    float *depth = malloc(depth_size);
+    float *hiz_min = malloc(hiz_size);
+    float *hiz_max = malloc(hiz_size);
+    if (!depth || !hiz_min || !hiz_max) {
+        free(depth);
+        free(hiz_min);
+        free(hiz_max);
+        return;
+    }
+    TracyCAlloc(depth, depth_size);
+    TracyCAlloc(hiz_min, hiz_size);
+    TracyCAlloc(hiz_max, hiz_size);
+
+    buff->depth = depth;
+    buff->depth_pitch = hiz_width * RASTER_HIZ_BLOCK_SIZE;
+    buff->hiz_min = hiz_min;
+    buff->hiz_max = hiz_max;
+    buff->hiz_width = hiz_width;
+    buff->hiz_height = hiz_height;
+
+    // Padding past the edges is never cleared again, it only has to start at the far plane
+    for (size_t i = 0; i < depth_size / sizeof(float); ++i) {
+        depth[i] = 1.0f;
+    }
+    for (size_t i = 0; i < hiz_size / sizeof(float); ++i) {
+        hiz_min[i] = 1.0f;
+        hiz_max[i] = 1.0f;
+    }
+    mark_dirty(buff, 0, 0, (int32_t) buff->width - 1, (int32_t) buff->height - 1);
 }
 
 mat4 const *camera_get_pv_matrix(camera *restrict cam) {
@@ -492,130 +1896,532 @@ void render_gradient(const graphics_buffer *restrict buffer, const uint32_t x_of
         }
         row += buffer->pitch;
     }
+
+    mark_dirty(buffer, 0, 0, (int32_t) buffer->width - 1, (int32_t) buffer->height - 1);
 }
 
-void render_obj_raster(model model, vec3 pos, versor rot, vec3 scale, camera *restrict cam,
-                       const graphics_buffer *restrict buff) {
-    TracyCZone(renderer_obj_tracy, true);
+// Viewport transform, snapping and depth plane for a width x height target. Returns false when
+// no pixel center can be covered.
+static bool setup_triangle(const uint32_t width, const uint32_t height,
+                           const vec3 ndc_v0, const vec3 ndc_v1, const vec3 ndc_v2,
+                           const uint32_t color, raster_triangle *restrict out) {
+    const float half_width = 0.5f * (float) width;
+    const float half_height = 0.5f * (float) height;
+
+    vec3 screen_v0, screen_v1, screen_v2;
+    screen_v0[0] = (ndc_v0[0] + 1.0f) * half_width;
+    screen_v0[1] = (1.0f - ndc_v0[1]) * half_height;
+    screen_v1[0] = (ndc_v1[0] + 1.0f) * half_width;
+    screen_v1[1] = (1.0f - ndc_v1[1]) * half_height;
+    screen_v2[0] = (ndc_v2[0] + 1.0f) * half_width;
+    screen_v2[1] = (1.0f - ndc_v2[1]) * half_height;
+
+    // Map Z from [-1, 1] to [0, 1] for the depth buffer
+    screen_v0[2] = (ndc_v0[2] + 1.0f) * 0.5f;
+    screen_v1[2] = (ndc_v1[2] + 1.0f) * 0.5f;
+    screen_v2[2] = (ndc_v2[2] + 1.0f) * 0.5f;
+
+    raster_triangle tri = {
+        .v0 = {to_fixed(screen_v0[0]), to_fixed(screen_v0[1])},
+        .v1 = {to_fixed(screen_v1[0]), to_fixed(screen_v1[1])},
+        .v2 = {to_fixed(screen_v2[0]), to_fixed(screen_v2[1])},
+        .z_min = min(screen_v0[2], min(screen_v1[2], screen_v2[2])),
+        .z_max = max(screen_v0[2], max(screen_v1[2], screen_v2[2])),
+        .color = color,
+    };
+
+    // Pixels whose centers (x * ONE + HALF) fall inside the fixed-point bounds
+    const int32_t fx_min = min(tri.v0[0], min(tri.v1[0], tri.v2[0]));
+    const int32_t fy_min = min(tri.v0[1], min(tri.v1[1], tri.v2[1]));
+    const int32_t fx_max = max(tri.v0[0], max(tri.v1[0], tri.v2[0]));
+    const int32_t fy_max = max(tri.v0[1], max(tri.v1[1], tri.v2[1]));
+    tri.aabb[0] = max((fx_min - RASTER_SUBPIXEL_HALF + RASTER_SUBPIXEL_ONE - 1) >> RASTER_SUBPIXEL_BITS, 0);
+    tri.aabb[1] = max((fy_min - RASTER_SUBPIXEL_HALF + RASTER_SUBPIXEL_ONE - 1) >> RASTER_SUBPIXEL_BITS, 0);
+    tri.aabb[2] = min((fx_max - RASTER_SUBPIXEL_HALF) >> RASTER_SUBPIXEL_BITS, (int32_t) width - 1);
+    tri.aabb[3] = min((fy_max - RASTER_SUBPIXEL_HALF) >> RASTER_SUBPIXEL_BITS, (int32_t) height - 1);
+
+    if (tri.aabb[0] > tri.aabb[2] || tri.aabb[1] > tri.aabb[3]) {
+        return false;
+    }
 
-    TracyCZoneN(stage_mvp, "MVPCalc", true);
-    mat4 model_matrix; {
-        mat4 rotation_mat = GLM_MAT4_IDENTITY_INIT;
-        mat4 translate_mat = GLM_MAT4_IDENTITY_INIT;
-        mat4 scale_mat = GLM_MAT4_IDENTITY_INIT;
+    // Depth plane from the same snapped vertices the edge functions use. NDC z is z/w, which
+    // is affine in screen space, so interpolating it linearly is perspective-correct for depth.
+    // The barycentric weight of v0 is edge 1's value, of v1 edge 2's and of v2 edge 0's.
+    const int64_t area = get_determinant(tri.v0[0], tri.v0[1], tri.v1[0], tri.v1[1], tri.v2[0], tri.v2[1]);
+    if (area <= 0) {
+        // Degenerate, or wound so that no pixel can pass the edge tests
+        return false;
+    }
 
-        // Create individual transform matrices
-        glm_quat_rotate(rotation_mat, rot, rotation_mat);
-        glm_translate_make(translate_mat, pos);
-        glm_scale_make(scale_mat, scale);
+    // Plane gradients in pixels; the area and the deltas are both in fixed point, so the
+    // ONE^2 factors cancel.
+    const float inv_area = 1.0f / (float) area;
+    const float dx0 = (float) (tri.v1[0] - tri.v0[0]), dy0 = (float) (tri.v1[1] - tri.v0[1]);
+    const float dx1 = (float) (tri.v2[0] - tri.v1[0]), dy1 = (float) (tri.v2[1] - tri.v1[1]);
+    const float dx2 = (float) (tri.v0[0] - tri.v2[0]), dy2 = (float) (tri.v0[1] - tri.v2[1]);
+    tri.dzdx = -(dy1 * screen_v0[2] + dy2 * screen_v1[2] + dy0 * screen_v2[2]) * inv_area * (float) RASTER_SUBPIXEL_ONE;
+    tri.dzdy = (dx1 * screen_v0[2] + dx2 * screen_v1[2] + dx0 * screen_v2[2]) * inv_area * (float) RASTER_SUBPIXEL_ONE;
+
+    // Shift the origin so that pixel index (x, y) samples the plane at its center
+    const float snapped_x0 = (float) tri.v0[0] / (float) RASTER_SUBPIXEL_ONE - 0.5f;
+    const float snapped_y0 = (float) tri.v0[1] / (float) RASTER_SUBPIXEL_ONE - 0.5f;
+    tri.z_origin = screen_v0[2] - tri.dzdx * snapped_x0 - tri.dzdy * snapped_y0;
+
+    *out = tri;
+    return true;
+}
 
-        // Combine them in standard T * R * S order
-        mat4 rs_mat;
-        glm_mul(rotation_mat, scale_mat, rs_mat);
-        glm_mul(translate_mat, rs_mat, model_matrix);
+// Set while render_obj_occluder runs: set-up triangles update it instead of buff's pixels.
+static occlusion_buffer *g_occlusion_target;
+
+// Per-draw attribute stream, attribute_count floats per vertex indexed like the clip vertices.
+// values is 0 for flat draws.
+typedef struct {
+    const float *values;
+    uint32_t count;
+} draw_attributes;
+
+// Without a shader the fill interpolates the first 3 attributes as the color, so streams with
+// fewer are drawn flat rather than read past their end.
+static inline draw_attributes make_draw_attributes(const float *values, const uint32_t count) {
+    const bool usable = values && count > 0 && (g_shader || count >= 3);
+    return (draw_attributes){.values = usable ? values : 0, .count = usable ? count : 0};
+}
+
+// Viewport transform, triangle setup and hand-off to the binner (or straight to the fill when
+// the buffer has no tiles). Triangles wound away from the viewer fail the area test here, which
+// also back-face culls the pieces coming out of the clipper. attributes may live on the
+// caller's stack; the binner copies them.
+static void setup_and_submit_triangle(graphics_buffer *restrict buff,
+                                      const vec3 ndc_v0, const vec3 ndc_v1, const vec3 ndc_v2,
+                                      const uint32_t color, const raster_attributes *restrict attributes) {
+    raster_triangle tri;
+    if (!setup_triangle(buff->width, buff->height, ndc_v0, ndc_v1, ndc_v2, color, &tri)) {
+        g_frame_stats.triangles_setup_culled++;
+        return;
     }
+    tri.attributes = attributes;
+    g_frame_stats.triangles_rasterized++;
+
+    if (g_occlusion_target) {
+        // Occluders only need depth
+        tri.attributes = 0;
+        fill_occluder(g_occlusion_target, &tri);
+    } else if (buff->tiles) {
+        bin_triangle(buff, &tri);
+    } else {
+        rasterize_triangle(buff, &tri, tri.aabb);
+    }
+}
 
-    mat4 mvp_mat;
-    glm_mat4_mul(*camera_get_pv_matrix(cam), model_matrix, mvp_mat);
+// Clips a triangle that crosses the near plane or leaves the guard band and submits the fan.
+static void clip_and_submit_triangle(graphics_buffer *restrict buff, const clip_vertices *restrict verts,
+                                     const uint32_t i0, const uint32_t i1, const uint32_t i2,
+                                     const clip_guard_band guard, const uint32_t color,
+                                     const draw_attributes *restrict attributes) {
+    clip_vertex triangle[3];
+    const uint32_t indices[3] = {i0, i1, i2};
+    const uint32_t attribute_count = attributes->values ? attributes->count : 0;
+    uint32_t plane_mask = 0;
+    for (int k = 0; k < 3; ++k) {
+        float *p = triangle[k].position;
+        p[0] = verts->x[indices[k]];
+        p[1] = verts->y[indices[k]];
+        p[2] = verts->z[indices[k]];
+        p[3] = verts->w[indices[k]];
+        plane_mask |= clip_stage_codes(p, guard);
+
+        for (uint32_t a = 0; a < attribute_count; ++a) {
+            triangle[k].attributes[a] = attributes->values[indices[k] * attribute_count + a];
+        }
+    }
 
-    // Pre-calculate loop-invariant values for the viewport transform
-    const float half_width = 0.5f * (float) buff->width;
-    const float half_height = 0.5f * (float) buff->height;
+    clip_vertex polygon[CLIP_MAX_POLYGON_VERTICES];
+    uint32_t polygon_count = 3;
+    if (plane_mask) {
+        polygon_count = clip_stage_polygon(triangle, plane_mask, guard, attribute_count, polygon);
+    } else {
+        // Outside the viewport but inside the guard band: the AABB clamp is enough
+        polygon[0] = triangle[0];
+        polygon[1] = triangle[1];
+        polygon[2] = triangle[2];
+    }
 
-    TracyCZoneEnd(stage_mvp);
+    vec3 ndc[CLIP_MAX_POLYGON_VERTICES];
+    float inv_w[CLIP_MAX_POLYGON_VERTICES];
+    for (uint32_t k = 0; k < polygon_count; ++k) {
+        const float *p = polygon[k].position;
+        inv_w[k] = 1.0f / p[3];
+        ndc[k][0] = p[0] * inv_w[k];
+        ndc[k][1] = p[1] * inv_w[k];
+        ndc[k][2] = p[2] * inv_w[k];
+    }
 
-    for (int i = 0; i < model.index_count; i += 3) {
-        TracyCZoneN(triangle_pipeline, "TrianglePipeline", true);
+    for (uint32_t k = 1; k + 1 < polygon_count; ++k) {
+        if (!attribute_count) {
+            setup_and_submit_triangle(buff, ndc[0], ndc[k], ndc[k + 1], color, 0);
+            continue;
+        }
 
-        // --- Transform vertices ---
-        TracyCZoneN(stage_transform, "Transform", true);
-        const uint32_t i0 = model.indices[i];
-        const uint32_t i1 = model.indices[i + 1];
-        const uint32_t i2 = model.indices[i + 2];
+        const uint32_t fan[3] = {0, k, k + 1};
+        raster_attributes fan_attributes = {
+            .count = attribute_count,
+            .shader = g_shader,
+            .shader_data = g_shader_data,
+        };
+        for (int v = 0; v < 3; ++v) {
+            fan_attributes.inv_w[v] = inv_w[fan[v]];
+            memcpy(fan_attributes.values[v], polygon[fan[v]].attributes, attribute_count * sizeof(float));
+        }
+        setup_and_submit_triangle(buff, ndc[0], ndc[k], ndc[k + 1], color, &fan_attributes);
+    }
+}
+
+// Culling, clipping and triangle setup for one triangle of transformed vertices.
+static inline void submit_triangle(graphics_buffer *restrict buff, const clip_vertices *restrict verts,
+                                   const uint32_t i0, const uint32_t i1, const uint32_t i2,
+                                   const clip_guard_band guard, const draw_attributes *restrict attributes) {
+    PROFILE_FINE_ZONE(triangle_pipeline, "Triangle");
+    g_frame_stats.triangles_in++;
+
+    // --- Frustum culling ---
+    // All 3 vertices outside the same plane. Valid in clip space even for vertices behind the eye.
+    PROFILE_FINE_ZONE(stage_frustum, "FrustumCull");
+    const uint32_t outcode_and = verts->outcode[i0] & verts->outcode[i1] & verts->outcode[i2];
+    const uint32_t outcode_or = verts->outcode[i0] | verts->outcode[i1] | verts->outcode[i2];
+    if (outcode_and != 0) {
+        g_frame_stats.triangles_frustum_culled++;
+        PROFILE_FINE_ZONE_END(stage_frustum);
+        PROFILE_FINE_ZONE_END(triangle_pipeline);
+
+        return;
+    }
+    PROFILE_FINE_ZONE_END(stage_frustum);
+
+    // --- Clipping ---
+    // Only triangles crossing the near plane or leaving the viewport can need it; the rest
+    // skip straight to the divide. Guard band tests happen inside the clip path.
+    if (outcode_or & (OUTCODE_NEAR | OUTCODE_LEFT | OUTCODE_RIGHT | OUTCODE_TOP | OUTCODE_BOTTOM)) {
+        PROFILE_FINE_ZONE(stage_clip, "Clip");
+        g_frame_stats.triangles_clipped++;
+        clip_and_submit_triangle(buff, verts, i0, i1, i2, guard, 0xFF << 16 | 0xFF << 8 | 0xFF, attributes);
+        PROFILE_FINE_ZONE_END(stage_clip);
+        PROFILE_FINE_ZONE_END(triangle_pipeline);
 
-        vec4 clip_v0, clip_v1, clip_v2;
-        glm_mat4_mulv(mvp_mat, model.vertices[i0], clip_v0);
-        glm_mat4_mulv(mvp_mat, model.vertices[i1], clip_v1);
-        glm_mat4_mulv(mvp_mat, model.vertices[i2], clip_v2);
-        TracyCZoneEnd(stage_transform);
+        return;
+    }
 
-        // --- Near-plane culling ---
-        TracyCZoneN(stage_nearplane, "NearPlaneCull", true);
-        if (clip_v0[3] <= 0.0f || clip_v1[3] <= 0.0f || clip_v2[3] <= 0.0f) {
-            TracyCZoneEnd(stage_nearplane);
-            TracyCZoneEnd(triangle_pipeline);
+    // --- Perspective divide ---
+    PROFILE_FINE_ZONE(stage_ndc, "PerspectiveDivide");
+    vec3 ndc_v0, ndc_v1, ndc_v2;
+    gather_ndc(verts, i0, ndc_v0);
+    gather_ndc(verts, i1, ndc_v1);
+    gather_ndc(verts, i2, ndc_v2);
+    PROFILE_FINE_ZONE_END(stage_ndc);
+
+    // --- Back-face culling ---
+    PROFILE_FINE_ZONE(stage_backface, "BackfaceCull");
+    vec3 edge1, edge2, normal;
+    glm_vec3_sub(ndc_v1, ndc_v0, edge1);
+    glm_vec3_sub(ndc_v2, ndc_v0, edge2);
+    glm_vec3_cross(edge1, edge2, normal);
+    if (normal[2] > 0.0f) {
+        g_frame_stats.triangles_backface_culled++;
+        PROFILE_FINE_ZONE_END(stage_backface);
+        PROFILE_FINE_ZONE_END(triangle_pipeline);
 
-            continue;
+        return;
+    }
+    PROFILE_FINE_ZONE_END(stage_backface);
+
+    // --- Rasterization ---
+    PROFILE_FINE_ZONE(stage_raster, "Rasterize");
+    if (!attributes->values) {
+        setup_and_submit_triangle(buff, ndc_v0, ndc_v1, ndc_v2, 0xFF << 16 | 0xFF << 8 | 0xFF, 0);
+    } else {
+        // Unclipped, so every w is positive and the vertex stage's 1 / w can be used as-is
+        const uint32_t indices[3] = {i0, i1, i2};
+        const uint32_t count = attributes->count;
+        raster_attributes triangle_attributes = {
+            .count = count,
+            .shader = g_shader,
+            .shader_data = g_shader_data,
+        };
+        for (int v = 0; v < 3; ++v) {
+            triangle_attributes.inv_w[v] = verts->inv_w[indices[v]];
+            memcpy(triangle_attributes.values[v], attributes->values + indices[v] * count, count * sizeof(float));
         }
-        TracyCZoneEnd(stage_nearplane);
-
-        // --- Perspective divide ---
-        TracyCZoneN(stage_ndc, "PerspectiveDivide", true);
-        vec3 ndc_v0, ndc_v1, ndc_v2;
-        const float rw0 = 1.0f / clip_v0[3];
-        const float rw1 = 1.0f / clip_v1[3];
-        const float rw2 = 1.0f / clip_v2[3];
-        glm_vec3_copy((vec3){clip_v0[0] * rw0, clip_v0[1] * rw0, clip_v0[2] * rw0}, ndc_v0);
-        glm_vec3_copy((vec3){clip_v1[0] * rw1, clip_v1[1] * rw1, clip_v1[2] * rw1}, ndc_v1);
-        glm_vec3_copy((vec3){clip_v2[0] * rw2, clip_v2[1] * rw2, clip_v2[2] * rw2}, ndc_v2);
-        TracyCZoneEnd(stage_ndc);
-
-        // --- Back-face culling ---
-        TracyCZoneN(stage_backface, "BackfaceCull", true);
-        vec3 edge1, edge2, normal;
-        glm_vec3_sub(ndc_v1, ndc_v0, edge1);
-        glm_vec3_sub(ndc_v2, ndc_v0, edge2);
-        glm_vec3_cross(edge1, edge2, normal);
-        if (normal[2] > 0.0f) {
-            TracyCZoneEnd(stage_backface);
-            TracyCZoneEnd(triangle_pipeline);
+        setup_and_submit_triangle(buff, ndc_v0, ndc_v1, ndc_v2, 0xFF << 16 | 0xFF << 8 | 0xFF, &triangle_attributes);
+    }
+    PROFILE_FINE_ZONE_END(stage_raster);
+
+    PROFILE_FINE_ZONE_END(triangle_pipeline);
+}
 
+// Meshlet path: whole clusters outside the frustum or facing away are rejected before their
+// vertices are transformed, and the survivors go through the vertex stage one at a time.
+static void submit_model_meshlets(const model *restrict m, const mat4 mvp, const clip_guard_band guard,
+                                  graphics_buffer *restrict buff) {
+    TracyCZoneN(meshlet_cull_tracy, "MeshletCull", true);
+    meshlet_cull_view view;
+    meshlet_cull_view_from_mvp(mvp, &view);
+    TracyCZoneEnd(meshlet_cull_tracy);
+
+    TracyCZoneN(meshlets_tracy, "Meshlets", true);
+    const model_meshlets *restrict meshlets = m->meshlets;
+    clip_vertices *restrict verts = &g_clip_vertices;
+    for (uint32_t c = 0; c < meshlets->meshlet_count; ++c) {
+        const meshlet *ml = &meshlets->meshlets[c];
+        if (meshlet_is_culled(ml, &view)) {
+            g_frame_stats.meshlets_culled++;
             continue;
         }
-        TracyCZoneEnd(stage_backface);
 
-        // --- Frustum culling ---
-        TracyCZoneN(stage_frustum, "FrustumCull", true);
-        const int outcode0 = compute_outcode(ndc_v0);
-        const int outcode1 = compute_outcode(ndc_v1);
-        const int outcode2 = compute_outcode(ndc_v2);
-        if ((outcode0 & outcode1 & outcode2) != 0) {
-            TracyCZoneEnd(stage_frustum);
-            TracyCZoneEnd(triangle_pipeline);
+        vertex_stage_transform(mvp, meshlets->vertices + ml->vertex_offset, ml->vertex_count, verts);
+        if (verts->count != ml->vertex_count) {
+            break;
+        }
 
-            continue;
+        const draw_attributes attributes = make_draw_attributes(
+            meshlets->attributes ? meshlets->attributes + ml->vertex_offset * meshlets->attribute_count : 0,
+            meshlets->attribute_count);
+        const uint8_t *restrict indices = meshlets->indices + ml->index_offset;
+        for (uint32_t i = 0; i < ml->triangle_count * 3; i += 3) {
+            submit_triangle(buff, verts, indices[i], indices[i + 1], indices[i + 2], guard, &attributes);
         }
-        TracyCZoneEnd(stage_frustum);
-
-        // --- Rasterization ---
-        TracyCZoneN(stage_raster, "Rasterize", true);
-        vec3 screen_v0, screen_v1, screen_v2;
-        screen_v0[0] = (ndc_v0[0] + 1.0f) * half_width;
-        screen_v0[1] = (1.0f - ndc_v0[1]) * half_height;
-        screen_v1[0] = (ndc_v1[0] + 1.0f) * half_width;
-        screen_v1[1] = (1.0f - ndc_v1[1]) * half_height;
-        screen_v2[0] = (ndc_v2[0] + 1.0f) * half_width;
-        screen_v2[1] = (1.0f - ndc_v2[1]) * half_height;
-
-        ivec4 aabb;
-        get_raster_triangle_AABB(screen_v0, screen_v1, screen_v2, aabb);
-        aabb[0] = max(aabb[0], 0);
-        aabb[1] = max(aabb[1], 0);
-        aabb[2] = min(aabb[2], buff->width - 1);
-        aabb[3] = min(aabb[3], buff->height - 1);
-
-        fill_triangle(buff, (ivec3){(int) screen_v0[0], (int) screen_v0[1]},
-                      (ivec3){(int) screen_v1[0], (int) screen_v1[1]},
-                      (ivec3){(int) screen_v2[0], (int) screen_v2[1]},
-                      aabb, 0xFF, 0xFF, 0xFF);
-        TracyCZoneEnd(stage_raster);
-
-        TracyCZoneEnd(triangle_pipeline);
     }
+    TracyCZoneEnd(meshlets_tracy);
+}
+
+// Vertex stage, culling, clipping and triangle setup for one draw of m with the given MVP.
+static void submit_model_triangles(const model *restrict m, const mat4 mvp, const clip_guard_band guard,
+                                   graphics_buffer *restrict buff) {
+    if (m->meshlets) {
+        submit_model_meshlets(m, mvp, guard, buff);
+        return;
+    }
+
+    // --- Transform every vertex once ---
+    clip_vertices *restrict verts = &g_clip_vertices;
+    vertex_stage_transform(mvp, m->vertices, m->vertex_count, verts);
+    if (verts->count != m->vertex_count) {
+        return;
+    }
+
+    const draw_attributes attributes = make_draw_attributes(m->attributes, m->attribute_count);
+    TracyCZoneN(triangles_tracy, "TrianglePipeline", true);
+    for (int i = 0; i < m->index_count; i += 3) {
+        submit_triangle(buff, verts, m->indices[i], m->indices[i + 1], m->indices[i + 2], guard, &attributes);
+    }
+    TracyCZoneEnd(triangles_tracy);
+}
+
+static inline void get_model_mat4(vec3 pos, versor rot, vec3 scale, mat4 dest) {
+    mat4 rotation_mat = GLM_MAT4_IDENTITY_INIT;
+    mat4 translate_mat = GLM_MAT4_IDENTITY_INIT;
+    mat4 scale_mat = GLM_MAT4_IDENTITY_INIT;
+
+    // Create individual transform matrices
+    glm_quat_rotate(rotation_mat, rot, rotation_mat);
+    glm_translate_make(translate_mat, pos);
+    glm_scale_make(scale_mat, scale);
+
+    // Combine them in standard T * R * S order
+    mat4 rs_mat;
+    glm_mul(rotation_mat, scale_mat, rs_mat);
+    glm_mul(translate_mat, rs_mat, dest);
+}
+
+void render_obj_raster(model model, vec3 pos, versor rot, vec3 scale, camera *restrict cam,
+                       graphics_buffer *restrict buff) {
+    TracyCZone(renderer_obj_tracy, true);
+
+    TracyCZoneN(stage_mvp, "MVPCalc", true);
+    mat4 model_matrix;
+    get_model_mat4(pos, rot, scale, model_matrix);
+
+    mat4 mvp_mat;
+    glm_mat4_mul(*camera_get_pv_matrix(cam), model_matrix, mvp_mat);
+
+    const clip_guard_band guard = clip_stage_guard_band(buff->width, buff->height);
+
+    TracyCZoneEnd(stage_mvp);
+
+    submit_model_triangles(&model, mvp_mat, guard, buff);
+
     TracyCZoneEnd(renderer_obj_tracy);
 }
 
 
+void render_obj_raster_instanced(const model *restrict m, const instance_data *restrict instances,
+                                 const uint32_t instance_count, camera *restrict cam,
+                                 graphics_buffer *restrict buff) {
+    TracyCZone(renderer_instanced_tracy, true);
+
+    // Per draw, not per instance: the camera, its frustum and the model's (usually cached) bounding sphere
+    mat4 pv;
+    glm_mat4_copy(*(mat4 *) camera_get_pv_matrix(cam), pv);
+    vec4 planes[6];
+    glm_frustum_planes(pv, planes);
+    vec4 bounds;
+    instance_stage_model_bounds(m, bounds);
+
+    const clip_guard_band guard = clip_stage_guard_band(buff->width, buff->height);
+
+    for (uint32_t first = 0; first < instance_count; first += INSTANCE_STAGE_BATCH_SIZE) {
+        const uint32_t count = min(instance_count - first, (uint32_t) INSTANCE_STAGE_BATCH_SIZE);
+
+        instance_batch batch;
+        instance_stage_batch(pv, planes, bounds, instances, first, count, &batch);
+
+        for (uint32_t lane = 0; lane < count; ++lane) {
+            if (batch.visible_mask & (1u << lane)) {
+                submit_model_triangles(m, batch.mvp[lane], guard, buff);
+            }
+        }
+    }
+
+    TracyCZoneEnd(renderer_instanced_tracy);
+}
+
+void occlusion_buffer_free(occlusion_buffer *ob) {
+    if (ob->blocks) {
+        TracyCFree(ob->blocks);
+        free(ob->blocks);
+    }
+
+    *ob = (occlusion_buffer){0};
+}
+
+void occlusion_buffer_init(occlusion_buffer *ob, const uint32_t width, const uint32_t height) {
+    occlusion_buffer_free(ob);
+
+    const uint32_t block_width = (width + RASTER_HIZ_BLOCK_SIZE - 1) / RASTER_HIZ_BLOCK_SIZE;
+    const uint32_t block_height = (height + RASTER_HIZ_BLOCK_SIZE - 1) / RASTER_HIZ_BLOCK_SIZE;
+    const size_t size = sizeof(occlusion_block) * block_width * block_height;
+    if (size == 0) {
+        return;
+    }
+
+    ob->blocks = malloc(size);
+    if (!ob->blocks) {
+        return;
+    }
+    TracyCAlloc(ob->blocks, size);
+
+    ob->width = width;
+    ob->height = height;
+    ob->block_width = block_width;
+    ob->block_height = block_height;
+    occlusion_buffer_clear(ob);
+}
+
+void occlusion_buffer_clear(occlusion_buffer *ob) {
+    const uint32_t block_count = ob->block_width * ob->block_height;
+    for (uint32_t i = 0; i < block_count; ++i) {
+        ob->blocks[i] = (occlusion_block){.mask = 0, .z_far = 1.0f, .z_mask = 0.0f};
+    }
+}
+
+void render_obj_occluder(const model *restrict m, vec3 pos, versor rot, vec3 scale, camera *restrict cam,
+                         occlusion_buffer *restrict ob) {
+    if (!ob->blocks) {
+        return;
+    }
+
+    TracyCZone(render_occluder_tracy, true);
+
+    mat4 model_matrix, mvp_mat;
+    get_model_mat4(pos, rot, scale, model_matrix);
+    glm_mat4_mul(*camera_get_pv_matrix(cam), model_matrix, mvp_mat);
+
+    // The stages only need the target's size; triangles are routed to ob by setup
+    graphics_buffer target = {.width = ob->width, .height = ob->height};
+    const clip_guard_band guard = clip_stage_guard_band(ob->width, ob->height);
+
+    g_occlusion_target = ob;
+    submit_model_triangles(m, mvp_mat, guard, &target);
+    g_occlusion_target = 0;
+
+    TracyCZoneEnd(render_occluder_tracy);
+}
+
+bool occlusion_test_aabb(const occlusion_buffer *restrict ob, camera *restrict cam, const float aabb_min[3],
+                         const float aabb_max[3]) {
+    if (!ob->blocks) {
+        return true;
+    }
+
+    TracyCZone(occlusion_test_tracy, true);
+
+    // Screen rect and nearest depth of the projected corners. NDC z is monotonic in view
+    // depth, so the nearest point of the box is one of them.
+    mat4 pv;
+    glm_mat4_copy(*camera_get_pv_matrix(cam), pv);
+    float x_min = INFINITY, y_min = INFINITY, x_max = -INFINITY, y_max = -INFINITY, z_min = INFINITY;
+    for (int corner = 0; corner < 8; ++corner) {
+        vec4 p = {
+            corner & 1 ? aabb_max[0] : aabb_min[0],
+            corner & 2 ? aabb_max[1] : aabb_min[1],
+            corner & 4 ? aabb_max[2] : aabb_min[2],
+            1.0f,
+        };
+        vec4 clip;
+        glm_mat4_mulv(pv, p, clip);
+        if (clip[3] <= 0.0f || clip[2] < -clip[3]) {
+            TracyCZoneEnd(occlusion_test_tracy);
+            return true;
+        }
+
+        const float inv_w = 1.0f / clip[3];
+        x_min = min(x_min, clip[0] * inv_w);
+        x_max = max(x_max, clip[0] * inv_w);
+        y_min = min(y_min, clip[1] * inv_w);
+        y_max = max(y_max, clip[1] * inv_w);
+        z_min = min(z_min, (clip[2] * inv_w + 1.0f) * 0.5f);
+    }
+
+    // Every buffer pixel whose square touches the rect, same viewport transform as setup. A corner
+    // just in front of the camera can land far outside int32, so clamp before converting.
+    const float half_width = 0.5f * (float) ob->width;
+    const float half_height = 0.5f * (float) ob->height;
+    const float width = (float) ob->width, height = (float) ob->height;
+    const int32_t px0 = max((int32_t) floorf(glm_clamp((x_min + 1.0f) * half_width, -1.0f, width)), 0);
+    const int32_t px1 = min((int32_t) floorf(glm_clamp((x_max + 1.0f) * half_width, -1.0f, width)),
+                            (int32_t) ob->width - 1);
+    const int32_t py0 = max((int32_t) floorf(glm_clamp((1.0f - y_max) * half_height, -1.0f, height)), 0);
+    const int32_t py1 = min((int32_t) floorf(glm_clamp((1.0f - y_min) * half_height, -1.0f, height)),
+                            (int32_t) ob->height - 1);
+
+    bool visible = false;
+    for (int32_t by = py0 & ~(RASTER_HIZ_BLOCK_SIZE - 1); by <= py1 && !visible; by += RASTER_HIZ_BLOCK_SIZE) {
+        for (int32_t bx = px0 & ~(RASTER_HIZ_BLOCK_SIZE - 1); bx <= px1 && !visible; bx += RASTER_HIZ_BLOCK_SIZE) {
+            const occlusion_block *block = &ob->blocks[(by / RASTER_HIZ_BLOCK_SIZE) * ob->block_width +
+                                                       bx / RASTER_HIZ_BLOCK_SIZE];
+            if (z_min > block->z_far) {
+                continue;
+            }
+            if (z_min > block->z_mask && block->mask) {
+                // Hidden only if the rect's pixels in this block all lie in the mask
+                const int32_t x0 = max(px0, bx) - bx, x1 = min(px1, bx + RASTER_HIZ_BLOCK_SIZE - 1) - bx;
+                const int32_t y0 = max(py0, by) - by, y1 = min(py1, by + RASTER_HIZ_BLOCK_SIZE - 1) - by;
+                const uint64_t row_mask = ((1u << (x1 + 1)) - 1u) & ~((1u << x0) - 1u);
+                uint64_t rect_mask = 0;
+                for (int32_t y = y0; y <= y1; ++y) {
+                    rect_mask |= row_mask << (y * RASTER_HIZ_BLOCK_SIZE);
+                }
+                if ((rect_mask & ~block->mask) == 0) {
+                    continue;
+                }
+            }
+            visible = true;
+        }
+    }
+
+    TracyCZoneEnd(occlusion_test_tracy);
+    return visible;
+}
+
 void draw_rect(const graphics_buffer *restrict buff, uint32_t x0, uint32_t y0, const int32_t x1, const uint32_t y1,
                const uint8_t r, const uint8_t g, const uint8_t b) {
     if (x0 > x1) swap_int(&x0, &x1);
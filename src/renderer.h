@@ -1,13 +1,63 @@
 ﻿#ifndef MYC23PROJECT_RENDERER_H
 #define MYC23PROJECT_RENDERER_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "cglm/cglm.h"
 
+// Screen-space tile edge in pixels. Tiles are the unit of work for the raster workers.
+#define RASTER_TILE_SIZE 64
+// Edge of the hierarchical-Z blocks in pixels. Must divide RASTER_TILE_SIZE.
+#define RASTER_HIZ_BLOCK_SIZE 8
+// Fractional bits of the fixed-point screen coordinates vertices are snapped to (28.4).
+#define RASTER_SUBPIXEL_BITS 4
+
+// Most per-vertex attributes a model can carry into the rasterizer.
+#define RASTER_MAX_ATTRIBUTES 8
+
+// Interpolated attributes of 8 horizontally adjacent pixels: values[a][lane] is attribute a
+// of pixel lane. Lanes outside the triangle hold garbage, their colors are discarded.
+// ddx/ddy are the screen-space derivatives of each attribute at the center of the span, for
+// mip selection; one set per 8 pixels plays the role of a GPU's per-quad derivatives.
+typedef struct {
+    alignas(32) float values[RASTER_MAX_ATTRIBUTES][8];
+    float ddx[RASTER_MAX_ATTRIBUTES];
+    float ddy[RASTER_MAX_ATTRIBUTES];
+} raster_fragments;
+
+// Colors 8 pixels from their fragments
+typedef void (*raster_shader)(const raster_fragments *restrict fragments, uint32_t attribute_count,
+                              const void *user, uint32_t colors[8]);
+
+// Per-vertex attributes of a set-up triangle, interpolated perspective-correctly by the
+// attribute fill. Allocated alongside the triangle for the frame.
+typedef struct {
+    float inv_w[3]; // 1 / clip w of v0, v1, v2
+    float values[3][RASTER_MAX_ATTRIBUTES];
+    uint32_t count;
+    raster_shader shader; // 0 = Gouraud: attributes 0-2 are r, g, b in [0, 1]
+    const void *shader_data;
+} raster_attributes;
+
+// A triangle that survived culling and setup, ready for fill_triangle. Binned triangles are
+// pool records owned by the renderer for the frame and referenced by pointer from the tiles.
+typedef struct {
+    ivec3 v0, v1, v2; // Screen coordinates in 28.4 fixed point, z unused
+    ivec4 aabb; // [xmin, ymin, xmax, ymax] of covered pixel centers, already clamped to the screen
+    float z_origin, dzdx, dzdy; // Depth plane at pixel centers: z(x, y) = z_origin + dzdx * x + dzdy * y, z in [0, 1]
+    float z_min, z_max; // Depth range over the three vertices, for Hi-Z tests
+    uint32_t color; // Flat color, when attributes is 0
+    const raster_attributes *attributes; // 0 = flat
+} raster_triangle;
+
+// Chunk of a tile's triangle list, allocated from the renderer's frame arena
+typedef struct tile_bin tile_bin;
+
 typedef struct {
     int32_t x_min, y_min, x_max, y_max;
-    ivec3 *triangle_list;
+    tile_bin *first_bin; // Triangles in submission order, chained
+    tile_bin *last_bin;
     uint32_t triangle_count;
 } Tile;
 
@@ -16,14 +66,47 @@ typedef struct {
     uint32_t height;
     uint32_t pitch;
     void *memory;
-    Tile *tiles;
+    size_t memory_size; // Size of the platform allocation backing `memory`, may be larger than pitch * height
+    // Optional depth buffer (0 = no depth test), padded to whole Hi-Z blocks in both directions
+    float *depth;
+    uint32_t depth_pitch; // In floats
+    // Conservative per-block depth bounds, hiz_width x hiz_height blocks
+    float *hiz_min;
+    float *hiz_max;
+    uint32_t hiz_width;
+    uint32_t hiz_height;
+
+    Tile *tiles; // 0 = rasterize immediately, otherwise bin and rasterize in renderer_end_frame
+    uint32_t tile_count_x;
+    uint32_t tile_count_y;
+
+    // Optional dirty tracking (0 = clean_buff clears everything, every frame is presented whole).
+    // One byte of RASTER_DIRTY_* bits per RASTER_TILE_SIZE tile, the same grid as tiles.
+    uint8_t *dirty;
+    uint32_t dirty_width;
+    uint32_t dirty_height;
 } graphics_buffer;
 
+#define RASTER_DIRTY_DRAWN 1 // Written since the last clean_buff, which must clear it
+#define RASTER_DIRTY_CHANGED 2 // Differs from what renderer_take_dirty_rects last reported
+
 typedef struct {
     uint32_t v0;
     uint32_t v1;
 } model_edge;
 
+// Marks the missing second triangle of a boundary edge
+#define MODEL_EDGE_NO_TRIANGLE UINT32_MAX
+
+typedef struct model_meshlets model_meshlets;
+typedef struct model_lods model_lods;
+
+// The (up to) two triangles sharing an edge, as triangle numbers (first index / 3).
+typedef struct {
+    uint32_t t0;
+    uint32_t t1; // MODEL_EDGE_NO_TRIANGLE on boundary edges
+} model_edge_triangles;
+
 typedef struct {
     vec4 *vertices;
     uint32_t vertex_count;
@@ -33,6 +116,16 @@ typedef struct {
     // --- NEW MEMBERS ---
     model_edge *edges; // A dynamic array of unique edges
     uint32_t edge_count; // The number of unique edges
+    model_edge_triangles *edge_triangles; // Optional, parallel to edges (silhouettes, ...)
+    model_meshlets *meshlets; // Optional, see meshlet.h. Drawn instead of indices when present.
+    model_lods *lods; // Optional, see lod.h
+    vec4 bounds; // Model-space bounding sphere, center xyz and radius w, when has_bounds
+    bool has_bounds; // Set by model_build_bounds; without it every instanced draw recomputes the sphere
+
+    // Optional attribute stream: attribute_count floats per vertex, vertex after vertex.
+    // Shaded by the current renderer_set_shader shader; models without it are drawn flat.
+    float *attributes;
+    uint32_t attribute_count; // 0 to RASTER_MAX_ATTRIBUTES
 } model;
 
 typedef struct {
@@ -55,8 +148,23 @@ typedef struct {
 void render_obj_wire(model model, vec3 pos, versor rot, vec3 scale, camera *restrict cam,
                      graphics_buffer *restrict buff);
 
+// Builds model.edges in first-seen order, each edge stored as (smaller, larger) index.
 void model_build_unique_edges(model *restrict m);
 
+// Same edges as model_build_unique_edges, plus model.edge_triangles.
+void model_build_edge_adjacency(model *restrict m);
+
+// Caches the bounding sphere of the vertices in model.bounds. Call again after moving vertices.
+void model_build_bounds(model *restrict m);
+
+// Frees the arrays of a heap-allocated model (init_cube_mesh, obj_import), its meshlets and LODs.
+// Not for models that point into a mesh_file mapping: use model_free_meshlets and
+// model_free_lods for those.
+void model_free(model *m);
+
+// Clears color to black and depth to the far plane in one pass over the rows: the whole buffer,
+// or with dirty tracking only the tiles drawn since the previous call. Large clears use
+// non-temporal stores so they do not evict the rest of the frame's working set.
 void clean_buff(const graphics_buffer *restrict buffer);
 
 mat4 const *camera_get_pv_matrix(camera *restrict cam);
@@ -66,7 +174,135 @@ void camera_init(camera *cam, vec3 pos, versor rot, float fov, float aspect, flo
 void render_gradient(const graphics_buffer *restrict buffer, uint32_t x_offset, uint32_t y_offset);
 
 void render_obj_raster(model model, vec3 pos, versor rot, vec3 scale, camera *restrict cam,
-                       const graphics_buffer *restrict buff);
+                       graphics_buffer *restrict buff);
+
+// Transforms of many copies of one model, one array per component, all instance_count long.
+typedef struct {
+    const float *position_x, *position_y, *position_z;
+    const float *rotation_x, *rotation_y, *rotation_z, *rotation_w; // Quaternion, same order as versor
+    const float *scale_x, *scale_y, *scale_z;
+} instance_data;
+
+// Same result as calling render_obj_raster once per instance. MVPs are built 8 instances at a
+// time, instances whose bounding sphere is outside the frustum are skipped before any vertex
+// work, and the model's index data is shared by every instance.
+void render_obj_raster_instanced(const model *restrict m, const instance_data *restrict instances,
+                                 uint32_t instance_count, camera *restrict cam, graphics_buffer *restrict buff);
+
+// Low-resolution, depth-only view of a few large occluders, in the style of masked occlusion
+// culling: every RASTER_HIZ_BLOCK_SIZE^2 block of pixels keeps a coverage mask and two depth
+// bounds instead of per-pixel depth. Draw the occluders first, then test the bounds of
+// everything else before submitting it.
+typedef struct {
+    uint64_t mask; // Pixels covered by the working layer, bit (y % 8) * 8 + x % 8
+    float z_far; // Nothing in the block is farther than this
+    float z_mask; // Nothing in the mask's pixels is farther than this
+} occlusion_block;
+
+typedef struct {
+    uint32_t width; // In pixels, independent of the framebuffer's
+    uint32_t height;
+    uint32_t block_width;
+    uint32_t block_height;
+    occlusion_block *blocks;
+} occlusion_buffer;
+
+void occlusion_buffer_init(occlusion_buffer *ob, uint32_t width, uint32_t height);
+
+void occlusion_buffer_free(occlusion_buffer *ob);
+
+// Empties the buffer: everything is visible until occluders are drawn.
+void occlusion_buffer_clear(occlusion_buffer *ob);
+
+// Draws a model into the occlusion buffer instead of a framebuffer, through the same vertex,
+// clip and setup stages as render_obj_raster.
+void render_obj_occluder(const model *restrict m, vec3 pos, versor rot, vec3 scale, camera *restrict cam,
+                         occlusion_buffer *restrict ob);
+
+// False when the world-space box is entirely behind the occluders drawn so far. Boxes crossing
+// the near plane are always visible.
+bool occlusion_test_aabb(const occlusion_buffer *restrict ob, camera *restrict cam, const float aabb_min[3],
+                         const float aabb_max[3]);
+
+// Inner loop used by every triangle fill. Both produce identical pixels; the switch exists so
+// the two can be A/B'd at runtime.
+typedef enum {
+    RASTER_PATH_SCALAR, // One pixel per iteration
+    RASTER_PATH_SIMD, // 8 pixels per iteration through simde (AVX2, SSE/NEON fallbacks)
+} raster_path;
+
+void renderer_set_raster_path(raster_path path);
+
+// How render_obj_wire and render_obj draw their lines. Both clip to the buffer.
+typedef enum {
+    LINE_MODE_ALIASED, // Spans and Bresenham, one write per pixel
+    LINE_MODE_ANTIALIASED, // Xiaolin Wu, blended into the framebuffer
+} line_mode;
+
+void renderer_set_line_mode(line_mode mode);
+
+// Shader for the following draws of models with attributes, 0 for Gouraud on the first 3
+// attributes as r, g, b (models with fewer are drawn flat). user is passed through to it and
+// must stay alive until the frame is rasterized. Triangles with attributes always use the SIMD
+// attribute fill, whatever the raster path.
+void renderer_set_shader(raster_shader shader, const void *user);
+
+// (Re)allocates the depth buffer and its Hi-Z levels for the buffer's current size. Call after
+// every resize; clean_buff resets them to the far plane along with the color, in the same pass.
+void renderer_depth_init(graphics_buffer *buff);
+
+void renderer_depth_free(graphics_buffer *buff);
+
+// (Re)builds the tile grid for the buffer's current size. Call after every resize to switch
+// render_obj_raster to the binned path.
+void renderer_tiles_init(graphics_buffer *buff);
+
+void renderer_tiles_free(graphics_buffer *buff);
+
+// Number of threads that rasterize tiles in renderer_end_frame, including the caller.
+void renderer_set_thread_count(uint32_t thread_count);
+
+// (Re)allocates the dirty tile grid for the buffer's current size, every tile dirty. Call after
+// every resize. With it, clean_buff only clears the tiles drawn since the previous clear.
+void renderer_dirty_init(graphics_buffer *buff);
+
+void renderer_dirty_free(graphics_buffer *buff);
+
+// Writes the rectangles that changed since the previous call, [xmin, ymin, xmax, ymax]
+// inclusive and at most capacity of them, and returns their count. Adjacent dirty tiles are
+// merged into rows, then rows with the same span into rectangles. Without dirty tracking, or
+// when they do not fit, returns the whole buffer as one rectangle.
+uint32_t renderer_take_dirty_rects(graphics_buffer *buff, ivec4 *rects, uint32_t capacity);
+
+// What the triangle pipeline did between renderer_begin_frame and renderer_end_frame. Stages
+// count into plain per-thread counters, summed once per frame; render_obj_wire is not counted.
+typedef struct {
+    uint64_t triangles_in; // Indexed triangles entering the pipeline, after meshlet culling
+    uint64_t meshlets_culled;
+    uint64_t triangles_frustum_culled; // All three vertices outside one plane
+    uint64_t triangles_clipped; // Went through the clipper, each may become a fan
+    uint64_t triangles_backface_culled; // Unclipped triangles wound away from the viewer
+    uint64_t triangles_setup_culled; // Set up from the clipper's fans or unclipped triangles, but
+                                     // degenerate, wound away, or between pixel centers
+    uint64_t triangles_rasterized; // Handed to a fill (or to the occlusion buffer)
+    uint64_t triangles_dropped; // Rasterized but lost from some or all tiles: binning ran out of memory
+    uint64_t pixels_tested; // Inside a triangle and the rect, in blocks the Hi-Z did not reject
+    uint64_t pixels_written; // Passed the depth test
+    double overdraw; // pixels_written per framebuffer pixel
+} renderer_stats;
+
+void renderer_begin_frame(graphics_buffer *buff);
+
+// Rasterizes everything binned so far and empties the bins, for drawing that writes the
+// framebuffer directly (lines) on top of binned triangles. Nothing to do without tiles.
+void renderer_flush_tiles(graphics_buffer *buff);
+
+// Rasterizes everything binned since renderer_begin_frame (or the last renderer_flush_tiles),
+// one tile per job, then publishes the frame's renderer_stats, also as Tracy plots.
+void renderer_end_frame(graphics_buffer *buff);
+
+// The stats of the last frame renderer_end_frame finished.
+void renderer_get_stats(renderer_stats *stats);
 
 void draw_rect(const graphics_buffer *restrict buff, uint32_t x0, uint32_t y0, const int32_t x1, const uint32_t y1,
                const uint8_t r, const uint8_t g, const uint8_t b);
@@ -0,0 +1,464 @@
+#include "scene.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lod.h"
+#include "simde/x86/avx2.h"
+#include "tracy/TracyC.h"
+
+// realloc for Tracy-tracked heap arrays
+static bool resize(void **array, const size_t bytes) {
+    void *resized = realloc(*array, bytes);
+    if (!resized) {
+        return false;
+    }
+
+    if (*array) {
+        TracyCFree(*array);
+    }
+    TracyCAlloc(resized, bytes);
+    *array = resized;
+    return true;
+}
+
+static bool grow(void **array, uint32_t *capacity, const uint32_t needed, const size_t element_size) {
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    uint32_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    if (!resize(array, element_size * new_capacity)) {
+        return false;
+    }
+    *capacity = new_capacity;
+    return true;
+}
+
+static void release(void *array) {
+    if (array) {
+        TracyCFree(array);
+        free(array);
+    }
+}
+
+void scene_init(scene *s) {
+    *s = (scene){0};
+}
+
+void scene_free(scene *s) {
+    release(s->meshes);
+    release(s->objects);
+    release(s->nodes);
+    release(s->parents);
+    release(s->dirty);
+    release(s->leaf_objects);
+    release(s->cull_stack);
+    release(s->visible);
+
+    *s = (scene){0};
+}
+
+uint32_t scene_add_mesh(scene *s, const model *mesh) {
+    if (!grow((void **) &s->meshes, &s->mesh_capacity, s->mesh_count + 1, sizeof(scene_mesh))) {
+        return SCENE_INVALID_ID;
+    }
+
+    scene_mesh *out = &s->meshes[s->mesh_count];
+    *out = (scene_mesh){.mesh = mesh};
+    for (uint32_t i = 0; i < mesh->vertex_count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            out->aabb_min[k] = i ? fminf(out->aabb_min[k], mesh->vertices[i][k]) : mesh->vertices[i][k];
+            out->aabb_max[k] = i ? fmaxf(out->aabb_max[k], mesh->vertices[i][k]) : mesh->vertices[i][k];
+        }
+    }
+
+    return s->mesh_count++;
+}
+
+// World AABB of the object's mesh AABB under T * R * S: the center goes through the matrix,
+// the half extents through its absolute value.
+static void update_object_bounds(const scene *restrict s, scene_object *restrict object) {
+    const scene_mesh *mesh = &s->meshes[object->mesh];
+
+    mat4 rotation;
+    glm_quat_mat4(object->rotation, rotation);
+
+    for (int r = 0; r < 3; ++r) {
+        float center = object->position[r];
+        float extent = 0.0f;
+        for (int c = 0; c < 3; ++c) {
+            const float m = rotation[c][r] * object->scale[c];
+            center += m * 0.5f * (mesh->aabb_min[c] + mesh->aabb_max[c]);
+            extent += fabsf(m) * 0.5f * (mesh->aabb_max[c] - mesh->aabb_min[c]);
+        }
+        object->aabb_min[r] = center - extent;
+        object->aabb_max[r] = center + extent;
+    }
+}
+
+uint32_t scene_add_object(scene *s, const uint32_t mesh, vec3 pos, versor rot, vec3 scale) {
+    if (mesh >= s->mesh_count ||
+        !grow((void **) &s->objects, &s->object_capacity, s->object_count + 1, sizeof(scene_object))) {
+        return SCENE_INVALID_ID;
+    }
+
+    scene_object *object = &s->objects[s->object_count];
+    *object = (scene_object){.mesh = mesh, .leaf = SCENE_INVALID_ID};
+    glm_vec3_copy(pos, object->position);
+    glm_quat_copy(rot, object->rotation);
+    glm_vec3_copy(scale, object->scale);
+    update_object_bounds(s, object);
+
+    s->needs_rebuild = true;
+    return s->object_count++;
+}
+
+void scene_set_transform(scene *s, const uint32_t object_id, vec3 pos, versor rot, vec3 scale) {
+    scene_object *object = &s->objects[object_id];
+    glm_vec3_copy(pos, object->position);
+    glm_quat_copy(rot, object->rotation);
+    glm_vec3_copy(scale, object->scale);
+    update_object_bounds(s, object);
+
+    // Mark the path to the root; stop where an earlier move already did
+    for (uint32_t n = object->leaf; n != SCENE_INVALID_ID && !s->dirty[n]; n = s->parents[n]) {
+        s->dirty[n] = 1;
+        s->needs_refit = true;
+    }
+}
+
+static void fit_node(const scene *restrict s, scene_bvh_node *restrict node) {
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+    if (node->count) {
+        for (uint32_t i = node->first; i < node->first + node->count; ++i) {
+            const scene_object *object = &s->objects[s->leaf_objects[i]];
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = fminf(lo[k], object->aabb_min[k]);
+                hi[k] = fmaxf(hi[k], object->aabb_max[k]);
+            }
+        }
+    } else {
+        const scene_bvh_node *left = &s->nodes[node->first];
+        const scene_bvh_node *right = &s->nodes[node->first + 1];
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = fminf(left->aabb_min[k], right->aabb_min[k]);
+            hi[k] = fmaxf(left->aabb_max[k], right->aabb_max[k]);
+        }
+    }
+
+    memcpy(node->aabb_min, lo, sizeof(lo));
+    memcpy(node->aabb_max, hi, sizeof(hi));
+}
+
+static inline float object_centroid(const scene_object *object, const int axis) {
+    return 0.5f * (object->aabb_min[axis] + object->aabb_max[axis]);
+}
+
+void scene_rebuild(scene *s) {
+    TracyCZone(scene_rebuild_tracy, true);
+
+    s->needs_rebuild = false;
+    s->needs_refit = false;
+    s->node_count = 0;
+    s->visible_count = 0;
+
+    const uint32_t count = s->object_count;
+    if (count == 0) {
+        TracyCZoneEnd(scene_rebuild_tracy);
+        return;
+    }
+
+    // A binary tree with at most one object per leaf has 2n - 1 nodes. The capacities only move
+    // once every array sharing them has been resized.
+    if (2 * count > s->node_capacity) {
+        const uint32_t capacity = 2 * count;
+        if (!resize((void **) &s->nodes, sizeof(scene_bvh_node) * capacity) ||
+            !resize((void **) &s->parents, sizeof(uint32_t) * capacity) ||
+            !resize((void **) &s->dirty, sizeof(uint8_t) * capacity) ||
+            !resize((void **) &s->cull_stack, sizeof(uint32_t) * capacity)) {
+            TracyCZoneEnd(scene_rebuild_tracy);
+            return;
+        }
+        s->node_capacity = capacity;
+    }
+    if (count > s->leaf_capacity) {
+        if (!resize((void **) &s->leaf_objects, sizeof(uint32_t) * count) ||
+            !resize((void **) &s->visible, sizeof(uint32_t) * count)) {
+            TracyCZoneEnd(scene_rebuild_tracy);
+            return;
+        }
+        s->leaf_capacity = count;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        s->leaf_objects[i] = i;
+    }
+
+    // Breadth-first: nodes are split in creation order, so children always land after their
+    // parent and no recursion stack is needed.
+    s->nodes[0] = (scene_bvh_node){.first = 0, .count = count};
+    s->parents[0] = SCENE_INVALID_ID;
+    s->node_count = 1;
+    for (uint32_t n = 0; n < s->node_count; ++n) {
+        scene_bvh_node *node = &s->nodes[n];
+        s->dirty[n] = 0;
+
+        if (node->count <= SCENE_BVH_LEAF_SIZE) {
+            for (uint32_t i = node->first; i < node->first + node->count; ++i) {
+                s->objects[s->leaf_objects[i]].leaf = n;
+            }
+            continue;
+        }
+
+        // Split at the middle of the longest axis of the centroid bounds
+        float lo[3] = {INFINITY, INFINITY, INFINITY};
+        float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (uint32_t i = node->first; i < node->first + node->count; ++i) {
+            const scene_object *object = &s->objects[s->leaf_objects[i]];
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = fminf(lo[k], object_centroid(object, k));
+                hi[k] = fmaxf(hi[k], object_centroid(object, k));
+            }
+        }
+        int axis = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (hi[k] - lo[k] > hi[axis] - lo[axis]) {
+                axis = k;
+            }
+        }
+        const float split = 0.5f * (lo[axis] + hi[axis]);
+
+        uint32_t *objects = s->leaf_objects + node->first;
+        uint32_t left_count = 0;
+        for (uint32_t i = 0; i < node->count; ++i) {
+            if (object_centroid(&s->objects[objects[i]], axis) < split) {
+                const uint32_t swap = objects[left_count];
+                objects[left_count++] = objects[i];
+                objects[i] = swap;
+            }
+        }
+        // Coincident centroids: any split is as good as another
+        if (left_count == 0 || left_count == node->count) {
+            left_count = node->count / 2;
+        }
+
+        const uint32_t left = s->node_count;
+        s->nodes[left] = (scene_bvh_node){.first = node->first, .count = left_count};
+        s->nodes[left + 1] = (scene_bvh_node){.first = node->first + left_count, .count = node->count - left_count};
+        s->parents[left] = n;
+        s->parents[left + 1] = n;
+        s->node_count += 2;
+
+        node->first = left;
+        node->count = 0;
+    }
+
+    // Bottom-up bounds
+    for (uint32_t n = s->node_count; n-- > 0;) {
+        fit_node(s, &s->nodes[n]);
+    }
+
+    TracyCZoneEnd(scene_rebuild_tracy);
+}
+
+void scene_update(scene *s) {
+    if (s->needs_rebuild) {
+        scene_rebuild(s);
+        return;
+    }
+    if (!s->needs_refit) {
+        return;
+    }
+
+    TracyCZone(scene_refit_tracy, true);
+
+    // Children come after their parent, so a reverse walk refits bottom-up
+    for (uint32_t n = s->node_count; n-- > 0;) {
+        if (s->dirty[n]) {
+            fit_node(s, &s->nodes[n]);
+            s->dirty[n] = 0;
+        }
+    }
+    s->needs_refit = false;
+
+    TracyCZoneEnd(scene_refit_tracy);
+}
+
+// The six frustum planes, one per lane. The last two lanes repeat the first plane, which
+// changes no result.
+typedef struct {
+    simde__m256 nx, ny, nz, d;
+    simde__m256 abs_nx, abs_ny, abs_nz;
+} frustum_lanes;
+
+typedef enum {
+    AABB_OUTSIDE,
+    AABB_INTERSECTS,
+    AABB_INSIDE,
+} aabb_visibility;
+
+static inline simde__m256 madd(const simde__m256 a, const simde__m256 b, const simde__m256 c) {
+    return simde_mm256_add_ps(simde_mm256_mul_ps(a, b), c);
+}
+
+static void frustum_lanes_init(camera *restrict cam, frustum_lanes *restrict out) {
+    mat4 pv;
+    glm_mat4_copy(*camera_get_pv_matrix(cam), pv);
+    vec4 planes[6];
+    glm_frustum_planes(pv, planes);
+
+    float lanes[4][8];
+    for (int lane = 0; lane < 8; ++lane) {
+        const int p = lane < 6 ? lane : 0;
+        for (int k = 0; k < 4; ++k) {
+            lanes[k][lane] = planes[p][k];
+        }
+    }
+
+    const simde__m256 sign = simde_mm256_set1_ps(-0.0f);
+    out->nx = simde_mm256_loadu_ps(lanes[0]);
+    out->ny = simde_mm256_loadu_ps(lanes[1]);
+    out->nz = simde_mm256_loadu_ps(lanes[2]);
+    out->d = simde_mm256_loadu_ps(lanes[3]);
+    out->abs_nx = simde_mm256_andnot_ps(sign, out->nx);
+    out->abs_ny = simde_mm256_andnot_ps(sign, out->ny);
+    out->abs_nz = simde_mm256_andnot_ps(sign, out->nz);
+}
+
+// Center/extent form: the box is outside a plane when its center is farther behind it than the
+// box's projected radius, and inside it when the center is at least that far in front.
+static inline aabb_visibility test_aabb(const frustum_lanes *restrict f, const float *restrict lo,
+                                        const float *restrict hi) {
+    const simde__m256 cx = simde_mm256_set1_ps(0.5f * (lo[0] + hi[0]));
+    const simde__m256 cy = simde_mm256_set1_ps(0.5f * (lo[1] + hi[1]));
+    const simde__m256 cz = simde_mm256_set1_ps(0.5f * (lo[2] + hi[2]));
+    const simde__m256 ex = simde_mm256_set1_ps(0.5f * (hi[0] - lo[0]));
+    const simde__m256 ey = simde_mm256_set1_ps(0.5f * (hi[1] - lo[1]));
+    const simde__m256 ez = simde_mm256_set1_ps(0.5f * (hi[2] - lo[2]));
+
+    const simde__m256 distance = madd(f->nx, cx, madd(f->ny, cy, madd(f->nz, cz, f->d)));
+    const simde__m256 radius = madd(f->abs_nx, ex, madd(f->abs_ny, ey, simde_mm256_mul_ps(f->abs_nz, ez)));
+
+    const simde__m256 neg_radius = simde_mm256_xor_ps(radius, simde_mm256_set1_ps(-0.0f));
+    if (simde_mm256_movemask_ps(simde_mm256_cmp_ps(distance, neg_radius, SIMDE_CMP_LT_OQ))) {
+        return AABB_OUTSIDE;
+    }
+    if (simde_mm256_movemask_ps(simde_mm256_cmp_ps(distance, radius, SIMDE_CMP_GE_OQ)) == 0xFF) {
+        return AABB_INSIDE;
+    }
+    return AABB_INTERSECTS;
+}
+
+// Draws the visible occluders into s->occlusion, then compacts s->visible to the occluders and
+// the objects they do not hide.
+static void occlude(scene *restrict s, camera *restrict cam) {
+    TracyCZone(scene_occlude_tracy, true);
+
+    occlusion_buffer_clear(s->occlusion);
+    for (uint32_t i = 0; i < s->visible_count; ++i) {
+        scene_object *object = &s->objects[s->visible[i]];
+        if (object->is_occluder) {
+            render_obj_occluder(s->meshes[object->mesh].mesh, object->position, object->rotation, object->scale,
+                                cam, s->occlusion);
+        }
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < s->visible_count; ++i) {
+        const scene_object *object = &s->objects[s->visible[i]];
+        if (object->is_occluder || occlusion_test_aabb(s->occlusion, cam, object->aabb_min, object->aabb_max)) {
+            s->visible[kept++] = s->visible[i];
+        }
+    }
+    s->occluded_count = s->visible_count - kept;
+    s->visible_count = kept;
+
+    TracyCZoneEnd(scene_occlude_tracy);
+}
+
+uint32_t scene_cull(scene *s, camera *restrict cam) {
+    scene_update(s);
+
+    TracyCZone(scene_cull_tracy, true);
+
+    s->visible_count = 0;
+    s->occluded_count = 0;
+    if (s->node_count == 0) {
+        TracyCZoneEnd(scene_cull_tracy);
+        return 0;
+    }
+
+    frustum_lanes frustum;
+    frustum_lanes_init(cam, &frustum);
+
+    uint32_t *restrict stack = s->cull_stack;
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top) {
+        const scene_bvh_node *node = &s->nodes[stack[--top]];
+        const aabb_visibility visibility = test_aabb(&frustum, node->aabb_min, node->aabb_max);
+        if (visibility == AABB_OUTSIDE) {
+            continue;
+        }
+
+        if (visibility == AABB_INSIDE) {
+            // The subtree's objects are one contiguous run, between its leftmost and rightmost leaf
+            const scene_bvh_node *leftmost = node, *rightmost = node;
+            while (leftmost->count == 0) {
+                leftmost = &s->nodes[leftmost->first];
+            }
+            while (rightmost->count == 0) {
+                rightmost = &s->nodes[rightmost->first + 1];
+            }
+            const uint32_t run = rightmost->first + rightmost->count - leftmost->first;
+            memcpy(s->visible + s->visible_count, s->leaf_objects + leftmost->first, sizeof(uint32_t) * run);
+            s->visible_count += run;
+            continue;
+        }
+
+        if (node->count) {
+            // Partially visible leaf: the objects' own boxes are tighter
+            for (uint32_t i = node->first; i < node->first + node->count; ++i) {
+                const scene_object *object = &s->objects[s->leaf_objects[i]];
+                if (test_aabb(&frustum, object->aabb_min, object->aabb_max) != AABB_OUTSIDE) {
+                    s->visible[s->visible_count++] = s->leaf_objects[i];
+                }
+            }
+            continue;
+        }
+
+        stack[top++] = node->first + 1;
+        stack[top++] = node->first;
+    }
+
+    TracyCZoneEnd(scene_cull_tracy);
+
+    if (s->occlusion) {
+        occlude(s, cam);
+    }
+    return s->visible_count;
+}
+
+void scene_render(scene *s, camera *restrict cam, graphics_buffer *restrict buff) {
+    TracyCZone(scene_render_tracy, true);
+
+    scene_cull(s, cam);
+    for (uint32_t i = 0; i < s->visible_count; ++i) {
+        scene_object *object = &s->objects[s->visible[i]];
+        const model *mesh = s->meshes[object->mesh].mesh;
+        object->lod = (uint8_t) lod_select(mesh, cam, buff->height, object->position, object->rotation,
+                                           object->scale, object->lod);
+        render_obj_raster(*model_lod(mesh, object->lod), object->position, object->rotation, object->scale, cam,
+                          buff);
+    }
+
+    TracyCZoneEnd(scene_render_tracy);
+}
@@ -0,0 +1,104 @@
+#ifndef MYC23PROJECT_SCENE_H
+#define MYC23PROJECT_SCENE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "renderer.h"
+
+// Objects per BVH leaf. Small leaves keep the culling tight, the node test is cheap.
+#define SCENE_BVH_LEAF_SIZE 4
+
+#define SCENE_INVALID_ID UINT32_MAX
+
+// A model registered with the scene, with its model-space AABB computed once.
+typedef struct {
+    const model *mesh; // Not owned, must outlive the scene
+    float aabb_min[3];
+    float aabb_max[3];
+} scene_mesh;
+
+typedef struct {
+    uint32_t mesh; // Index into scene.meshes
+    vec3 position;
+    versor rotation;
+    vec3 scale;
+    float aabb_min[3]; // World space, from the transform above
+    float aabb_max[3];
+    uint32_t leaf; // BVH node holding the object, SCENE_INVALID_ID until the next build
+    bool is_occluder; // Drawn into scene.occlusion before the other objects are tested
+    uint8_t lod; // Level drawn by the last scene_render, see lod_select
+} scene_object;
+
+// 32 bytes, two to a cache line. Children of an inner node are adjacent (first, first + 1)
+// and always stored after their parent, so a reverse walk over the nodes is bottom-up.
+typedef struct {
+    float aabb_min[3];
+    uint32_t first; // Leaf: first slot in scene.leaf_objects. Inner: left child.
+    float aabb_max[3];
+    uint32_t count; // Objects in a leaf, 0 for inner nodes
+} scene_bvh_node;
+
+typedef struct {
+    scene_mesh *meshes;
+    uint32_t mesh_count;
+    uint32_t mesh_capacity;
+
+    scene_object *objects;
+    uint32_t object_count;
+    uint32_t object_capacity;
+
+    scene_bvh_node *nodes;
+    uint32_t *parents; // Parallel to nodes, SCENE_INVALID_ID for the root
+    uint8_t *dirty; // Parallel to nodes: bounds need a refit
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t *leaf_objects; // Object ids in leaf order, object_count long. Every subtree
+                            // covers a contiguous range of it.
+    uint32_t *cull_stack; // Traversal scratch, as long as nodes
+
+    uint32_t leaf_capacity; // Of leaf_objects and visible
+
+    uint32_t *visible; // Output of scene_cull
+    uint32_t visible_count;
+    uint32_t occluded_count; // Frustum-visible objects scene_cull dropped as occluded
+
+    occlusion_buffer *occlusion; // Optional, not owned. Enables occlusion culling in scene_cull.
+
+    bool needs_rebuild; // Objects were added since the last build
+    bool needs_refit; // Objects moved since the last build or refit
+} scene;
+
+void scene_init(scene *s);
+
+void scene_free(scene *s);
+
+// Registers a model and computes its bounds. Returns its mesh id, SCENE_INVALID_ID on failure.
+uint32_t scene_add_mesh(scene *s, const model *mesh);
+
+// Returns the object id, SCENE_INVALID_ID on failure. The object is part of the BVH from the
+// next scene_update.
+uint32_t scene_add_object(scene *s, uint32_t mesh, vec3 pos, versor rot, vec3 scale);
+
+// Moves an object. Only its leaf and the leaf's ancestors are refit by the next scene_update.
+void scene_set_transform(scene *s, uint32_t object, vec3 pos, versor rot, vec3 scale);
+
+// Rebuilds the BVH when objects were added, otherwise refits the nodes above moved objects.
+// Refitting keeps the topology, so trees degrade when objects travel far; scene_rebuild then
+// restores them.
+void scene_update(scene *s);
+
+void scene_rebuild(scene *s);
+
+// Fills s->visible with the objects whose AABB intersects the camera frustum, testing all six
+// planes of a node at once. Subtrees entirely inside the frustum are taken without tests.
+// With s->occlusion set, the visible occluders are then drawn into it and every other object
+// whose AABB they hide is dropped. Calls scene_update first. Returns s->visible_count.
+uint32_t scene_cull(scene *s, camera *restrict cam);
+
+// scene_cull, then render_obj_raster for every visible object, at the level lod_select picks
+// for meshes with LODs. Occluders are always drawn into the occlusion buffer at full detail.
+void scene_render(scene *s, camera *restrict cam, graphics_buffer *restrict buff);
+
+#endif //MYC23PROJECT_SCENE_H
@@ -0,0 +1,247 @@
+#include "swapchain.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "tracy/TracyC.h"
+
+typedef struct {
+    graphics_buffer buffer; // Color and dirty tiles only
+    ivec4 rects[SWAPCHAIN_MAX_RECTS];
+    uint32_t rect_count;
+    uint64_t frame;
+} swapchain_image;
+
+struct swapchain {
+    swapchain_desc desc;
+    swapchain_image images[SWAPCHAIN_MAX_IMAGES];
+
+    pthread_t thread;
+    sem_t free_images; // Posted by the present thread when it is done with an image
+    sem_t queued_images; // Posted per submit, and once more by swapchain_destroy
+    atomic_uint_fast64_t submitted;
+
+    // Render thread
+    uint32_t acquire_index;
+    uint32_t current; // Image acquired last
+    uint32_t width;
+    uint32_t height;
+    uint8_t *shown; // RASTER_DIRTY_DRAWN tiles of the last submitted frame, what the screen shows
+    uint32_t shown_width;
+    uint32_t shown_height;
+    atomic_bool full_present;
+
+    // Present thread
+    uint32_t present_index;
+    uint64_t presented;
+};
+
+static void wait_semaphore(sem_t *sem) {
+    while (sem_wait(sem) != 0 && errno == EINTR) {
+    }
+}
+
+static void *present_main(void *arg) {
+    swapchain *chain = arg;
+
+    TracyCSetThreadName("Present");
+
+    for (;;) {
+        wait_semaphore(&chain->queued_images);
+
+        // Every frame token is posted after its submission is counted, so once they are all
+        // presented the remaining token is the shutdown one
+        if (chain->presented == atomic_load_explicit(&chain->submitted, memory_order_acquire)) {
+            break;
+        }
+
+        swapchain_image *image = &chain->images[chain->present_index];
+        chain->present_index = (chain->present_index + 1) % chain->desc.image_count;
+
+        TracyCZone(swapchain_present_tracy, true);
+        chain->desc.present(chain->desc.user, &image->buffer, image->rects, image->rect_count, image->frame);
+        TracyCZoneEnd(swapchain_present_tracy);
+
+        chain->presented++;
+        sem_post(&chain->free_images);
+    }
+
+    return 0;
+}
+
+swapchain *swapchain_create(const swapchain_desc *desc) {
+    swapchain *chain = calloc(1, sizeof(swapchain));
+    if (!chain) {
+        return 0;
+    }
+    TracyCAlloc(chain, sizeof(swapchain));
+
+    chain->desc = *desc;
+    if (chain->desc.image_count < 2) {
+        chain->desc.image_count = 2;
+    } else if (chain->desc.image_count > SWAPCHAIN_MAX_IMAGES) {
+        chain->desc.image_count = SWAPCHAIN_MAX_IMAGES;
+    }
+    chain->width = desc->width;
+    chain->height = desc->height;
+    atomic_init(&chain->submitted, 0);
+    atomic_init(&chain->full_present, true);
+
+    if (sem_init(&chain->free_images, 0, chain->desc.image_count) != 0) {
+        TracyCFree(chain);
+        free(chain);
+        return 0;
+    }
+    if (sem_init(&chain->queued_images, 0, 0) != 0) {
+        sem_destroy(&chain->free_images);
+        TracyCFree(chain);
+        free(chain);
+        return 0;
+    }
+    if (pthread_create(&chain->thread, 0, present_main, chain) != 0) {
+        sem_destroy(&chain->free_images);
+        sem_destroy(&chain->queued_images);
+        TracyCFree(chain);
+        free(chain);
+        return 0;
+    }
+
+    return chain;
+}
+
+void swapchain_destroy(swapchain *chain) {
+    if (!chain) {
+        return;
+    }
+
+    sem_post(&chain->queued_images);
+    pthread_join(chain->thread, 0);
+
+    for (uint32_t i = 0; i < chain->desc.image_count; ++i) {
+        renderer_dirty_free(&chain->images[i].buffer);
+        if (chain->images[i].buffer.memory) {
+            chain->desc.release_image(&chain->images[i].buffer, chain->desc.user);
+        }
+    }
+    if (chain->shown) {
+        TracyCFree(chain->shown);
+        free(chain->shown);
+    }
+    sem_destroy(&chain->free_images);
+    sem_destroy(&chain->queued_images);
+
+    TracyCFree(chain);
+    free(chain);
+}
+
+void swapchain_resize(swapchain *chain, const uint32_t width, const uint32_t height) {
+    chain->width = width;
+    chain->height = height;
+}
+
+void swapchain_invalidate(swapchain *chain) {
+    atomic_store_explicit(&chain->full_present, true, memory_order_relaxed);
+}
+
+bool swapchain_acquire(swapchain *chain, graphics_buffer *target) {
+    TracyCZone(swapchain_acquire_tracy, true);
+
+    wait_semaphore(&chain->free_images);
+    chain->current = chain->acquire_index;
+    chain->acquire_index = (chain->acquire_index + 1) % chain->desc.image_count;
+
+    graphics_buffer *image = &chain->images[chain->current].buffer;
+    if (!image->memory || image->width != chain->width || image->height != chain->height) {
+        chain->desc.resize_image(image, chain->width, chain->height, chain->desc.user);
+        if (!image->memory) {
+            image->width = 0;
+            image->height = 0;
+        }
+        if (chain->desc.track_dirty) {
+            renderer_dirty_init(image);
+        }
+    }
+
+    const bool resized = target->width != image->width || target->height != image->height;
+    target->width = image->width;
+    target->height = image->height;
+    target->pitch = image->pitch;
+    target->memory = image->memory;
+    target->memory_size = image->memory_size;
+    target->dirty = image->dirty;
+    target->dirty_width = image->dirty_width;
+    target->dirty_height = image->dirty_height;
+
+    TracyCZoneEnd(swapchain_acquire_tracy);
+    return resized;
+}
+
+// The screen shows the previous frame, so the rectangles to present are the tiles drawn in
+// either. Each image's dirty tiles only know about the frames drawn into it, a third of them
+// with three images, while the depth buffer behind them is shared: every other image also
+// inherits this frame's drawn tiles, so its next clean_buff clears this frame's depth too.
+static void collect_rects(swapchain *chain, swapchain_image *image) {
+    graphics_buffer *buffer = &image->buffer;
+    const size_t tile_count = (size_t) buffer->dirty_width * buffer->dirty_height;
+
+    bool full = atomic_exchange_explicit(&chain->full_present, false, memory_order_relaxed);
+    if (chain->shown_width != buffer->dirty_width || chain->shown_height != buffer->dirty_height) {
+        if (chain->shown) {
+            TracyCFree(chain->shown);
+            free(chain->shown);
+        }
+        chain->shown = malloc(tile_count);
+        if (chain->shown) {
+            TracyCAlloc(chain->shown, tile_count);
+        }
+        chain->shown_width = chain->shown ? buffer->dirty_width : 0;
+        chain->shown_height = chain->shown ? buffer->dirty_height : 0;
+        full = true;
+    }
+
+    for (uint32_t i = 0; i < chain->desc.image_count; ++i) {
+        graphics_buffer *other = &chain->images[i].buffer;
+        if (other == buffer || other->dirty_width != buffer->dirty_width ||
+            other->dirty_height != buffer->dirty_height) {
+            continue;
+        }
+        for (size_t t = 0; t < tile_count; ++t) {
+            other->dirty[t] |= buffer->dirty[t] & RASTER_DIRTY_DRAWN;
+        }
+    }
+
+    for (size_t t = 0; t < tile_count; ++t) {
+        const uint8_t drawn = buffer->dirty[t] & RASTER_DIRTY_DRAWN;
+        const bool changed = full || drawn || (chain->shown && chain->shown[t]);
+        buffer->dirty[t] = drawn | (changed ? RASTER_DIRTY_CHANGED : 0);
+        if (chain->shown) {
+            chain->shown[t] = drawn;
+        }
+    }
+
+    image->rect_count = renderer_take_dirty_rects(buffer, image->rects, SWAPCHAIN_MAX_RECTS);
+}
+
+void swapchain_submit(swapchain *chain) {
+    TracyCZone(swapchain_submit_tracy, true);
+
+    swapchain_image *image = &chain->images[chain->current];
+    const uint64_t frame = atomic_load_explicit(&chain->submitted, memory_order_relaxed);
+    image->frame = frame;
+
+    if (!image->buffer.memory) {
+        image->rect_count = 0; // Minimized
+    } else if (image->buffer.dirty) {
+        collect_rects(chain, image);
+    } else {
+        image->rect_count = renderer_take_dirty_rects(&image->buffer, image->rects, SWAPCHAIN_MAX_RECTS);
+    }
+
+    atomic_store_explicit(&chain->submitted, frame + 1, memory_order_release);
+    sem_post(&chain->queued_images);
+
+    TracyCZoneEnd(swapchain_submit_tracy);
+}
@@ -0,0 +1,64 @@
+#ifndef MYC23PROJECT_SWAPCHAIN_H
+#define MYC23PROJECT_SWAPCHAIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "renderer.h"
+
+#define SWAPCHAIN_MAX_IMAGES 3
+
+// Dirty rectangles kept per presented frame, past that it is presented whole
+#define SWAPCHAIN_MAX_RECTS 64
+
+// (Re)allocates an image's color memory at width x height, like win32_resize_dib_section and
+// linux_resize_buffer. Leaves memory at 0 on failure.
+typedef void swapchain_resize_fn(graphics_buffer *image, uint32_t width, uint32_t height, void *user);
+
+typedef void swapchain_release_fn(graphics_buffer *image, void *user);
+
+// Runs on the present thread. rects are inclusive pixel bounds of what differs from the
+// previously presented frame; frame counts submissions from 0.
+typedef void swapchain_present_fn(void *user, const graphics_buffer *image, const ivec4 *rects,
+                                  uint32_t rect_count, uint64_t frame);
+
+typedef struct {
+    uint32_t image_count; // 2 or 3
+    uint32_t width;
+    uint32_t height;
+    bool track_dirty; // Dirty tiles per image: partial clears and presents
+    swapchain_resize_fn *resize_image;
+    swapchain_release_fn *release_image;
+    swapchain_present_fn *present;
+    void *user;
+} swapchain_desc;
+
+// A ring of color buffers handed between the render thread and a present thread, so frame N+1
+// renders while frame N is presented. Images are taken and returned in order through two
+// semaphores and nothing else is shared: the render thread never waits unless every other
+// image is still queued for presentation. Frames are presented in order, none are dropped.
+typedef struct swapchain swapchain;
+
+swapchain *swapchain_create(const swapchain_desc *desc);
+
+// Presents everything submitted so far, then stops the present thread and frees the images.
+void swapchain_destroy(swapchain *chain);
+
+// Size of the images acquired from now on. Images still queued keep their size, each is
+// reallocated the next time it is acquired. Render thread only, like everything below.
+void swapchain_resize(swapchain *chain, uint32_t width, uint32_t height);
+
+// Presents the next frame whole, e.g. after the window was uncovered.
+void swapchain_invalidate(swapchain *chain);
+
+// Waits for the next free image and points target's color memory and dirty tiles at it.
+// Depth and tiles stay the caller's, shared by every image. Returns true when target's size
+// changed, the first acquire included: they need renderer_depth_init / renderer_tiles_init.
+bool swapchain_acquire(swapchain *chain, graphics_buffer *target);
+
+// Queues the image acquired last for presentation. The acquire target must not be drawn to
+// until the next acquire.
+void swapchain_submit(swapchain *chain);
+
+#endif //MYC23PROJECT_SWAPCHAIN_H
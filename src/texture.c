@@ -0,0 +1,242 @@
+#include "texture.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aligned_memory.h"
+#include "simde/x86/avx2.h"
+#include "tracy/TracyC.h"
+
+static inline bool is_power_of_two(const uint32_t x) {
+    return x && (x & (x - 1)) == 0;
+}
+
+static inline uint32_t log2_u32(const uint32_t x) {
+    return 31u - (uint32_t) __builtin_clz(x);
+}
+
+// Low 16 bits of x to the even bits of the result
+static inline uint32_t spread_bits(uint32_t x) {
+    x &= 0x0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+static inline simde__m256i spread_bits8(simde__m256i x) {
+    x = simde_mm256_and_si256(x, simde_mm256_set1_epi32(0x0000FFFF));
+    x = simde_mm256_and_si256(simde_mm256_or_si256(x, simde_mm256_slli_epi32(x, 8)), simde_mm256_set1_epi32(0x00FF00FF));
+    x = simde_mm256_and_si256(simde_mm256_or_si256(x, simde_mm256_slli_epi32(x, 4)), simde_mm256_set1_epi32(0x0F0F0F0F));
+    x = simde_mm256_and_si256(simde_mm256_or_si256(x, simde_mm256_slli_epi32(x, 2)), simde_mm256_set1_epi32(0x33333333));
+    x = simde_mm256_and_si256(simde_mm256_or_si256(x, simde_mm256_slli_epi32(x, 1)), simde_mm256_set1_epi32(0x55555555));
+    return x;
+}
+
+// Morton index = x part | y part. Both axes share the low min(width_bits, height_bits) bits,
+// interleaved x first; the rest of the longer axis sits above them.
+static inline uint32_t shared_bits(const texture_level *restrict level) {
+    return level->width_bits < level->height_bits ? level->width_bits : level->height_bits;
+}
+
+static inline uint32_t morton_index(const texture_level *restrict level, const uint32_t x, const uint32_t y) {
+    const uint32_t shared = shared_bits(level);
+    const uint32_t low = (1u << shared) - 1;
+    return spread_bits(x & low) | spread_bits(y & low) << 1 | ((x >> shared) | (y >> shared)) << (2 * shared);
+}
+
+// x and y parts of the Morton index for 8 wrapped coordinates
+static inline simde__m256i morton_part8(const simde__m256i coordinate, const uint32_t shared, const int axis) {
+    const simde__m256i low = simde_mm256_and_si256(coordinate, simde_mm256_set1_epi32((int32_t) ((1u << shared) - 1)));
+    const simde__m256i high = simde_mm256_srlv_epi32(coordinate, simde_mm256_set1_epi32((int32_t) shared));
+    return simde_mm256_or_si256(simde_mm256_sllv_epi32(spread_bits8(low), simde_mm256_set1_epi32(axis)),
+                                simde_mm256_sllv_epi32(high, simde_mm256_set1_epi32((int32_t) (2 * shared))));
+}
+
+// 2x2 box filter of row-major src into row-major dst, rounding per channel. Axes already down
+// to 1 texel reuse their only row or column.
+static void downsample(const uint32_t *restrict src, const uint32_t src_width, const uint32_t src_height,
+                       uint32_t *restrict dst, const uint32_t dst_width, const uint32_t dst_height) {
+    for (uint32_t y = 0; y < dst_height; ++y) {
+        const uint32_t *row0 = src + (2 * y) * src_width;
+        const uint32_t *row1 = src + (src_height > 1 ? 2 * y + 1 : 2 * y) * src_width;
+        for (uint32_t x = 0; x < dst_width; ++x) {
+            const uint32_t x0 = 2 * x;
+            const uint32_t x1 = src_width > 1 ? 2 * x + 1 : 2 * x;
+            const uint32_t t[4] = {row0[x0], row0[x1], row1[x0], row1[x1]};
+
+            // Red and blue share one add, 16 bits apart, so neither can carry into the other
+            uint32_t rb = 0x00020002, g = 0x00000200;
+            for (int i = 0; i < 4; ++i) {
+                rb += t[i] & 0x00FF00FF;
+                g += t[i] & 0x0000FF00;
+            }
+            dst[y * dst_width + x] = ((rb >> 2) & 0x00FF00FF) | ((g >> 2) & 0x0000FF00);
+        }
+    }
+}
+
+bool texture_init(texture *t, const uint32_t *pixels, const uint32_t width, const uint32_t height,
+                  const uint32_t pitch, const texture_filter filter) {
+    TracyCZone(texture_init_tracy, true);
+
+    *t = (texture){.filter = filter};
+    if (!is_power_of_two(width) || !is_power_of_two(height) || width > (1u << (TEXTURE_MAX_LEVELS - 1)) ||
+        height > (1u << (TEXTURE_MAX_LEVELS - 1))) {
+        TracyCZoneEnd(texture_init_tracy);
+        return false;
+    }
+
+    const uint32_t width_bits = log2_u32(width);
+    const uint32_t height_bits = log2_u32(height);
+    t->level_count = (width_bits > height_bits ? width_bits : height_bits) + 1;
+
+    size_t total = 0;
+    for (uint32_t l = 0; l < t->level_count; ++l) {
+        const uint32_t level_width_bits = width_bits > l ? width_bits - l : 0;
+        const uint32_t level_height_bits = height_bits > l ? height_bits - l : 0;
+        total += (size_t) 1 << (level_width_bits + level_height_bits);
+    }
+
+    // Cache-line aligned, and rounded up so the allocation size is too
+    const size_t bytes = (total * sizeof(uint32_t) + 63) & ~(size_t) 63;
+    t->memory = aligned_malloc(64, bytes);
+    uint32_t *scratch[2] = {malloc(sizeof(uint32_t) * width * height), malloc(sizeof(uint32_t) * width * height)};
+    if (!t->memory || !scratch[0] || !scratch[1]) {
+        aligned_free(t->memory);
+        free(scratch[0]);
+        free(scratch[1]);
+        *t = (texture){0};
+        TracyCZoneEnd(texture_init_tracy);
+        return false;
+    }
+    TracyCAlloc(t->memory, bytes);
+
+    for (uint32_t y = 0; y < height; ++y) {
+        memcpy(scratch[0] + y * width, pixels + (size_t) y * pitch, sizeof(uint32_t) * width);
+    }
+
+    // Each level is filtered from the previous one in row-major scratch, then swizzled
+    uint32_t *level_texels = t->memory;
+    for (uint32_t l = 0; l < t->level_count; ++l) {
+        texture_level *level = &t->levels[l];
+        level->width_bits = width_bits > l ? width_bits - l : 0;
+        level->height_bits = height_bits > l ? height_bits - l : 0;
+        level->width = 1u << level->width_bits;
+        level->height = 1u << level->height_bits;
+        level->texels = level_texels;
+
+        const uint32_t *src = scratch[l & 1];
+        if (l > 0) {
+            const texture_level *parent = &t->levels[l - 1];
+            downsample(scratch[(l - 1) & 1], parent->width, parent->height, scratch[l & 1], level->width,
+                       level->height);
+        }
+        for (uint32_t y = 0; y < level->height; ++y) {
+            for (uint32_t x = 0; x < level->width; ++x) {
+                level_texels[morton_index(level, x, y)] = src[y * level->width + x];
+            }
+        }
+
+        level_texels += (size_t) level->width * level->height;
+    }
+
+    free(scratch[0]);
+    free(scratch[1]);
+
+    TracyCZoneEnd(texture_init_tracy);
+    return true;
+}
+
+void texture_free(texture *t) {
+    if (t->memory) {
+        TracyCFree(t->memory);
+        aligned_free(t->memory);
+    }
+    *t = (texture){0};
+}
+
+float texture_lod(const texture *t, const float dudx, const float dvdx, const float dudy, const float dvdy) {
+    const float width = (float) t->levels[0].width;
+    const float height = (float) t->levels[0].height;
+    const float x_sq = dudx * dudx * width * width + dvdx * dvdx * height * height;
+    const float y_sq = dudy * dudy * width * width + dvdy * dvdy * height * height;
+    const float rho_sq = x_sq > y_sq ? x_sq : y_sq;
+    return rho_sq > 0.0f ? 0.5f * log2f(rho_sq) : -(float) TEXTURE_MAX_LEVELS;
+}
+
+// (a * (256 - w) + b * w) / 256 per channel, w in [0, 256). Red and blue go through one
+// multiply: each sum stays below 65280 + 128 because the weights add up to 256, so it fits
+// its 16 bits.
+static inline simde__m256i lerp_texels8(const simde__m256i a, const simde__m256i b, const simde__m256i w) {
+    const simde__m256i rb_mask = simde_mm256_set1_epi32(0x00FF00FF);
+    const simde__m256i g_mask = simde_mm256_set1_epi32(0x0000FF00);
+    const simde__m256i inv_w = simde_mm256_sub_epi32(simde_mm256_set1_epi32(256), w);
+
+    const simde__m256i rb = simde_mm256_add_epi32(
+        simde_mm256_mullo_epi32(simde_mm256_and_si256(a, rb_mask), inv_w),
+        simde_mm256_mullo_epi32(simde_mm256_and_si256(b, rb_mask), w));
+    const simde__m256i g = simde_mm256_add_epi32(
+        simde_mm256_mullo_epi32(simde_mm256_and_si256(a, g_mask), inv_w),
+        simde_mm256_mullo_epi32(simde_mm256_and_si256(b, g_mask), w));
+
+    // Round to nearest: + 128 in every channel before the shift
+    const simde__m256i rb_round = simde_mm256_add_epi32(rb, simde_mm256_set1_epi32(0x00800080));
+    const simde__m256i g_round = simde_mm256_add_epi32(g, simde_mm256_set1_epi32(0x00008000));
+    return simde_mm256_or_si256(simde_mm256_and_si256(simde_mm256_srli_epi32(rb_round, 8), rb_mask),
+                                simde_mm256_and_si256(simde_mm256_srli_epi32(g_round, 8), g_mask));
+}
+
+void texture_sample(const texture *restrict t, const float u[8], const float v[8], const float lod,
+                    uint32_t out[8]) {
+    // Nearest level; magnification stays on level 0
+    int32_t level_index = (int32_t) lrintf(lod);
+    level_index = level_index < 0 ? 0 : level_index;
+    level_index = level_index >= (int32_t) t->level_count ? (int32_t) t->level_count - 1 : level_index;
+    const texture_level *restrict level = &t->levels[level_index];
+
+    const uint32_t shared = shared_bits(level);
+    const simde__m256i x_mask = simde_mm256_set1_epi32((int32_t) (level->width - 1));
+    const simde__m256i y_mask = simde_mm256_set1_epi32((int32_t) (level->height - 1));
+    const int *base = (const int *) level->texels;
+
+    const simde__m256 x = simde_mm256_mul_ps(simde_mm256_loadu_ps(u), simde_mm256_set1_ps((float) level->width));
+    const simde__m256 y = simde_mm256_mul_ps(simde_mm256_loadu_ps(v), simde_mm256_set1_ps((float) level->height));
+
+    if (t->filter == TEXTURE_FILTER_POINT) {
+        const simde__m256i ix = simde_mm256_and_si256(simde_mm256_cvttps_epi32(simde_mm256_floor_ps(x)), x_mask);
+        const simde__m256i iy = simde_mm256_and_si256(simde_mm256_cvttps_epi32(simde_mm256_floor_ps(y)), y_mask);
+        const simde__m256i index = simde_mm256_or_si256(morton_part8(ix, shared, 0), morton_part8(iy, shared, 1));
+        simde_mm256_storeu_si256((simde__m256i *) out, simde_mm256_i32gather_epi32(base, index, 4));
+        return;
+    }
+
+    // Bilinear: the 4 texels around (x - 0.5, y - 0.5), 8-bit weights
+    const simde__m256 half = simde_mm256_set1_ps(0.5f);
+    const simde__m256 sx = simde_mm256_sub_ps(x, half);
+    const simde__m256 sy = simde_mm256_sub_ps(y, half);
+    const simde__m256 fx = simde_mm256_floor_ps(sx);
+    const simde__m256 fy = simde_mm256_floor_ps(sy);
+    const simde__m256 scale = simde_mm256_set1_ps(256.0f);
+    const simde__m256i wx = simde_mm256_cvttps_epi32(simde_mm256_mul_ps(simde_mm256_sub_ps(sx, fx), scale));
+    const simde__m256i wy = simde_mm256_cvttps_epi32(simde_mm256_mul_ps(simde_mm256_sub_ps(sy, fy), scale));
+
+    const simde__m256i one = simde_mm256_set1_epi32(1);
+    const simde__m256i ix = simde_mm256_cvttps_epi32(fx);
+    const simde__m256i iy = simde_mm256_cvttps_epi32(fy);
+    const simde__m256i x0 = morton_part8(simde_mm256_and_si256(ix, x_mask), shared, 0);
+    const simde__m256i x1 = morton_part8(simde_mm256_and_si256(simde_mm256_add_epi32(ix, one), x_mask), shared, 0);
+    const simde__m256i y0 = morton_part8(simde_mm256_and_si256(iy, y_mask), shared, 1);
+    const simde__m256i y1 = morton_part8(simde_mm256_and_si256(simde_mm256_add_epi32(iy, one), y_mask), shared, 1);
+
+    const simde__m256i t00 = simde_mm256_i32gather_epi32(base, simde_mm256_or_si256(x0, y0), 4);
+    const simde__m256i t10 = simde_mm256_i32gather_epi32(base, simde_mm256_or_si256(x1, y0), 4);
+    const simde__m256i t01 = simde_mm256_i32gather_epi32(base, simde_mm256_or_si256(x0, y1), 4);
+    const simde__m256i t11 = simde_mm256_i32gather_epi32(base, simde_mm256_or_si256(x1, y1), 4);
+
+    const simde__m256i top = lerp_texels8(t00, t10, wx);
+    const simde__m256i bottom = lerp_texels8(t01, t11, wx);
+    simde_mm256_storeu_si256((simde__m256i *) out, lerp_texels8(top, bottom, wy));
+}
@@ -0,0 +1,49 @@
+#ifndef MYC23PROJECT_TEXTURE_H
+#define MYC23PROJECT_TEXTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Enough levels for a 32768 texel wide texture
+#define TEXTURE_MAX_LEVELS 16
+
+typedef enum {
+    TEXTURE_FILTER_POINT,
+    TEXTURE_FILTER_BILINEAR,
+} texture_filter;
+
+// One mip level in Morton (Z) order: texel (x, y) is at the interleaved bits of x and y, so
+// a 2x2 footprint, or any small square, is a few cache lines whatever the direction a triangle
+// walks it in. When the level is not square, the longer axis' extra high bits go on top.
+typedef struct {
+    const uint32_t *texels;
+    uint32_t width; // Powers of two
+    uint32_t height;
+    uint32_t width_bits; // log2(width)
+    uint32_t height_bits;
+} texture_level;
+
+// Mip chain down to 1x1, box filtered, all levels in one allocation. Texels are 0x00RRGGBB
+// like the framebuffer. Coordinates wrap (repeat addressing).
+typedef struct {
+    uint32_t *memory;
+    texture_level levels[TEXTURE_MAX_LEVELS];
+    uint32_t level_count;
+    texture_filter filter;
+} texture;
+
+// Builds the chain from row-major pixels. width and height must be powers of two.
+bool texture_init(texture *t, const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch,
+                  texture_filter filter);
+
+void texture_free(texture *t);
+
+// Level of detail for a footprint with the given UV derivatives, log2 of its larger axis in
+// level 0 texels. Negative when magnified.
+float texture_lod(const texture *t, float dudx, float dvdx, float dudy, float dvdy);
+
+// Samples 8 UVs from the nearest level to lod with the texture's filter.
+void texture_sample(const texture *restrict t, const float u[8], const float v[8], float lod,
+                    uint32_t out[8]);
+
+#endif //MYC23PROJECT_TEXTURE_H
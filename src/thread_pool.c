@@ -0,0 +1,168 @@
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "tracy/TracyC.h"
+
+struct thread_pool {
+    pthread_t *threads;
+    uint32_t worker_count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    // Protected by mutex
+    uint64_t generation;
+    uint32_t busy_workers;
+    bool shutting_down;
+
+    // Current batch, published under mutex before generation is bumped
+    thread_pool_job *job;
+    void *user;
+    uint32_t job_count;
+    atomic_uint next_job;
+};
+
+typedef struct {
+    thread_pool *pool;
+    uint32_t thread_index;
+} worker_args;
+
+static void drain_jobs(thread_pool *pool, const uint32_t thread_index) {
+    for (;;) {
+        const uint32_t job_index = atomic_fetch_add_explicit(&pool->next_job, 1, memory_order_relaxed);
+        if (job_index >= pool->job_count) {
+            break;
+        }
+        pool->job(pool->user, job_index, thread_index);
+    }
+}
+
+static void *worker_main(void *arg) {
+    const worker_args args = *(worker_args *) arg;
+    free(arg);
+
+    thread_pool *pool = args.pool;
+    uint64_t seen_generation = 0;
+
+    TracyCSetThreadName("RasterWorker");
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->generation == seen_generation && !pool->shutting_down) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+        if (pool->shutting_down) {
+            break;
+        }
+        seen_generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        drain_jobs(pool, args.thread_index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy_workers == 0) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return 0;
+}
+
+thread_pool *thread_pool_create(const uint32_t worker_count) {
+    thread_pool *pool = calloc(1, sizeof(thread_pool));
+    if (!pool) {
+        return 0;
+    }
+
+    pthread_mutex_init(&pool->mutex, 0);
+    pthread_cond_init(&pool->work_cond, 0);
+    pthread_cond_init(&pool->done_cond, 0);
+    atomic_init(&pool->next_job, 0);
+
+    pool->threads = calloc(worker_count ? worker_count : 1, sizeof(pthread_t));
+    if (!pool->threads) {
+        pthread_cond_destroy(&pool->done_cond);
+        pthread_cond_destroy(&pool->work_cond);
+        pthread_mutex_destroy(&pool->mutex);
+        free(pool);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        // Run with however many workers we managed to start.
+        worker_args *args = malloc(sizeof(worker_args));
+        if (!args) {
+            break;
+        }
+        *args = (worker_args){pool, i + 1};
+        if (pthread_create(&pool->threads[i], 0, worker_main, args) != 0) {
+            free(args);
+            break;
+        }
+        pool->worker_count++;
+    }
+
+    return pool;
+}
+
+void thread_pool_destroy(thread_pool *pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (uint32_t i = 0; i < pool->worker_count; ++i) {
+        pthread_join(pool->threads[i], 0);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool);
+}
+
+void thread_pool_run(thread_pool *pool, const uint32_t job_count, thread_pool_job *job, void *user) {
+    if (job_count == 0) {
+        return;
+    }
+
+    // Not worth waking anybody up for a single job.
+    if (!pool || pool->worker_count == 0 || job_count == 1) {
+        for (uint32_t i = 0; i < job_count; ++i) {
+            job(user, i, 0);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->job = job;
+    pool->user = user;
+    pool->job_count = job_count;
+    atomic_store_explicit(&pool->next_job, 0, memory_order_relaxed);
+    pool->busy_workers = pool->worker_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    drain_jobs(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busy_workers > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+uint32_t thread_pool_thread_count(const thread_pool *pool) {
+    return pool ? pool->worker_count + 1 : 1;
+}
@@ -0,0 +1,23 @@
+#ifndef MYC23PROJECT_THREAD_POOL_H
+#define MYC23PROJECT_THREAD_POOL_H
+
+#include <stdint.h>
+
+// A minimal fork/join pool: thread_pool_run hands out job indices [0, job_count) to the
+// workers *and* the calling thread, and returns once every job has finished.
+// thread_index is 0 for the caller and 1..worker_count for the workers, so jobs can index
+// per-thread scratch data without synchronisation.
+typedef void thread_pool_job(void *user, uint32_t job_index, uint32_t thread_index);
+
+typedef struct thread_pool thread_pool;
+
+thread_pool *thread_pool_create(uint32_t worker_count);
+
+void thread_pool_destroy(thread_pool *pool);
+
+void thread_pool_run(thread_pool *pool, uint32_t job_count, thread_pool_job *job, void *user);
+
+// Number of threads that can execute jobs, including the caller.
+uint32_t thread_pool_thread_count(const thread_pool *pool);
+
+#endif //MYC23PROJECT_THREAD_POOL_H
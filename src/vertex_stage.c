@@ -0,0 +1,145 @@
+#include "vertex_stage.h"
+
+#include <stdlib.h>
+
+#include "aligned_memory.h"
+#include "simde/x86/avx2.h"
+#include "tracy/TracyC.h"
+
+static bool reserve(clip_vertices *restrict out, const uint32_t vertex_count) {
+    if (vertex_count <= out->capacity) {
+        return true;
+    }
+
+    vertex_stage_free(out);
+
+    const uint32_t capacity = (vertex_count + 7) & ~7u;
+    const size_t array_size = sizeof(float) * capacity;
+    uint8_t *block = aligned_malloc(32, array_size * 6);
+    if (!block) {
+        return false;
+    }
+    TracyCAlloc(block, array_size * 6);
+
+    out->x = (float *) block;
+    out->y = (float *) (block + array_size);
+    out->z = (float *) (block + array_size * 2);
+    out->w = (float *) (block + array_size * 3);
+    out->inv_w = (float *) (block + array_size * 4);
+    out->outcode = (uint32_t *) (block + array_size * 5);
+    out->capacity = capacity;
+    return true;
+}
+
+void vertex_stage_free(clip_vertices *vertices) {
+    // All arrays share the allocation that starts at x
+    if (vertices->x) {
+        TracyCFree(vertices->x);
+        aligned_free(vertices->x);
+    }
+
+    *vertices = (clip_vertices){0};
+}
+
+static inline uint32_t compute_clip_outcode(const float x, const float y, const float z, const float w) {
+    uint32_t code = 0;
+    if (x > w) code |= OUTCODE_RIGHT;
+    if (x < -w) code |= OUTCODE_LEFT;
+    if (y > w) code |= OUTCODE_TOP;
+    if (y < -w) code |= OUTCODE_BOTTOM;
+    if (z > w) code |= OUTCODE_FAR;
+    if (z < -w) code |= OUTCODE_NEAR;
+
+    return code;
+}
+
+static inline simde__m256i outcode_bit(const simde__m256 a, const simde__m256 b, const int32_t bit) {
+    // (a > b) ? bit : 0
+    return simde_mm256_and_si256(simde_mm256_castps_si256(simde_mm256_cmp_ps(a, b, SIMDE_CMP_GT_OQ)),
+                                 simde_mm256_set1_epi32(bit));
+}
+
+void vertex_stage_transform(const mat4 mvp, const vec4 *restrict vertices, const uint32_t vertex_count,
+                            clip_vertices *restrict out) {
+    TracyCZoneN(vertex_stage_tracy, "VertexStage", true);
+
+    out->count = 0;
+    if (!reserve(out, vertex_count)) {
+        TracyCZoneEnd(vertex_stage_tracy);
+        return;
+    }
+
+    simde__m256 m[4][4];
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            m[col][row] = simde_mm256_set1_ps(mvp[col][row]);
+        }
+    }
+
+    // Undoes the lane order left by the 4x8 transpose below, which yields vertices 0 2 4 6 1 3 5 7
+    const simde__m256i unshuffle = simde_mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const simde__m256 one = simde_mm256_set1_ps(1.0f);
+    const simde__m256 sign_bit = simde_mm256_set1_ps(-0.0f);
+
+    uint32_t i = 0;
+    for (; i + 8 <= vertex_count; i += 8) {
+        // AoS -> SoA: every load holds two whole vertices
+        const float *src = vertices[i];
+        const simde__m256 r0 = simde_mm256_loadu_ps(src);
+        const simde__m256 r1 = simde_mm256_loadu_ps(src + 8);
+        const simde__m256 r2 = simde_mm256_loadu_ps(src + 16);
+        const simde__m256 r3 = simde_mm256_loadu_ps(src + 24);
+
+        const simde__m256 t0 = simde_mm256_unpacklo_ps(r0, r1);
+        const simde__m256 t1 = simde_mm256_unpackhi_ps(r0, r1);
+        const simde__m256 t2 = simde_mm256_unpacklo_ps(r2, r3);
+        const simde__m256 t3 = simde_mm256_unpackhi_ps(r2, r3);
+
+        const simde__m256 vx = simde_mm256_permutevar8x32_ps(simde_mm256_shuffle_ps(t0, t2, 0x44), unshuffle);
+        const simde__m256 vy = simde_mm256_permutevar8x32_ps(simde_mm256_shuffle_ps(t0, t2, 0xEE), unshuffle);
+        const simde__m256 vz = simde_mm256_permutevar8x32_ps(simde_mm256_shuffle_ps(t1, t3, 0x44), unshuffle);
+        const simde__m256 vw = simde_mm256_permutevar8x32_ps(simde_mm256_shuffle_ps(t1, t3, 0xEE), unshuffle);
+
+        simde__m256 clip[4];
+        for (int row = 0; row < 4; ++row) {
+            clip[row] = simde_mm256_add_ps(
+                simde_mm256_add_ps(simde_mm256_mul_ps(m[0][row], vx), simde_mm256_mul_ps(m[1][row], vy)),
+                simde_mm256_add_ps(simde_mm256_mul_ps(m[2][row], vz), simde_mm256_mul_ps(m[3][row], vw)));
+        }
+
+        const simde__m256 neg_w = simde_mm256_xor_ps(clip[3], sign_bit);
+        simde__m256i code = outcode_bit(clip[0], clip[3], OUTCODE_RIGHT);
+        code = simde_mm256_or_si256(code, outcode_bit(neg_w, clip[0], OUTCODE_LEFT));
+        code = simde_mm256_or_si256(code, outcode_bit(clip[1], clip[3], OUTCODE_TOP));
+        code = simde_mm256_or_si256(code, outcode_bit(neg_w, clip[1], OUTCODE_BOTTOM));
+        code = simde_mm256_or_si256(code, outcode_bit(clip[2], clip[3], OUTCODE_FAR));
+        code = simde_mm256_or_si256(code, outcode_bit(neg_w, clip[2], OUTCODE_NEAR));
+
+        simde_mm256_store_ps(out->x + i, clip[0]);
+        simde_mm256_store_ps(out->y + i, clip[1]);
+        simde_mm256_store_ps(out->z + i, clip[2]);
+        simde_mm256_store_ps(out->w + i, clip[3]);
+        simde_mm256_store_ps(out->inv_w + i, simde_mm256_div_ps(one, clip[3]));
+        simde_mm256_store_si256((simde__m256i *) (out->outcode + i), code);
+    }
+
+    // Tail, same math one vertex at a time
+    for (; i < vertex_count; ++i) {
+        const float *v = vertices[i];
+        float clip[4];
+        for (int row = 0; row < 4; ++row) {
+            clip[row] = (mvp[0][row] * v[0] + mvp[1][row] * v[1]) + (mvp[2][row] * v[2] + mvp[3][row] * v[3]);
+        }
+
+        out->x[i] = clip[0];
+        out->y[i] = clip[1];
+        out->z[i] = clip[2];
+        out->w[i] = clip[3];
+        out->inv_w[i] = 1.0f / clip[3];
+        out->outcode[i] = compute_clip_outcode(clip[0], clip[1], clip[2], clip[3]);
+    }
+
+    out->count = vertex_count;
+
+    TracyCZoneEnd(vertex_stage_tracy);
+}
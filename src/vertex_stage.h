@@ -0,0 +1,33 @@
+#ifndef MYC23PROJECT_VERTEX_STAGE_H
+#define MYC23PROJECT_VERTEX_STAGE_H
+
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+
+// Homogeneous clip outcodes: a vertex is outside a plane when |x|, |y| or |z| exceeds w.
+// For w > 0 these are the same bits as testing NDC against [-1, 1].
+#define OUTCODE_RIGHT  1  // 000001
+#define OUTCODE_LEFT   2  // 000010
+#define OUTCODE_TOP    4  // 000100
+#define OUTCODE_BOTTOM 8  // 001000
+#define OUTCODE_FAR    16 // 010000
+#define OUTCODE_NEAR   32 // 100000
+
+// Post-transform vertex buffer in structure-of-arrays form. Filled once per draw so a vertex
+// shared by several triangles is only transformed once; triangle setup gathers by index.
+typedef struct {
+    float *x, *y, *z, *w; // Clip-space position
+    float *inv_w; // 1 / w, only meaningful where w > 0
+    uint32_t *outcode; // OUTCODE_* bits
+    uint32_t count;
+    uint32_t capacity; // Multiple of 8, every array is 32-byte aligned
+} clip_vertices;
+
+// Transforms vertices by mvp, 8 per iteration, computing outcodes and 1 / w in the same pass.
+void vertex_stage_transform(const mat4 mvp, const vec4 *restrict vertices, uint32_t vertex_count,
+                            clip_vertices *restrict out);
+
+void vertex_stage_free(clip_vertices *vertices);
+
+#endif //MYC23PROJECT_VERTEX_STAGE_H
@@ -22,7 +22,17 @@ void win32_resize_dib_section(graphics_buffer *buffer, const uint32_t width, con
     const uint32_t bytes_per_pixel = 4;
     buffer->pitch = width * bytes_per_pixel;
 
-    buffer->memory = VirtualAlloc(0, buffer->pitch * height, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    buffer->memory_size = buffer->pitch * height;
+    buffer->memory = VirtualAlloc(0, buffer->memory_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void win32_free_buffer(graphics_buffer *buffer) {
+    if (buffer->memory) {
+        VirtualFree(buffer->memory, 0, MEM_RELEASE);
+    }
+
+    buffer->memory = 0;
+    buffer->memory_size = 0;
 }
 
 void win32_display_buffer(
@@ -53,3 +63,50 @@ void win32_display_buffer(
 
     TracyCZoneEnd(win32_stretchDIBits_tracy);
 }
+
+void win32_display_buffer_rects(
+    const graphics_buffer *buffer,
+    HDC device_context,
+    const uint32_t window_width,
+    const uint32_t window_height,
+    const ivec4 *rects,
+    const uint32_t rect_count
+) {
+    TracyCZone(win32_stretchDIBits_rects_tracy, true);
+
+    BITMAPINFO info = {0};
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = buffer->width;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    for (uint32_t i = 0; i < rect_count; ++i) {
+        const int32_t x0 = rects[i][0];
+        const int32_t y0 = rects[i][1];
+        const int32_t x1 = rects[i][2] + 1;
+        const int32_t y1 = rects[i][3] + 1;
+
+        // A top-down DIB starting at the rectangle's first row: source rows of a top-down
+        // StretchDIBits are counted from the bottom, this sidesteps that
+        info.bmiHeader.biHeight = -(y1 - y0);
+        const uint8_t *rows = (const uint8_t *) buffer->memory + (size_t) y0 * buffer->pitch;
+
+        const int32_t dst_x0 = (int32_t) ((int64_t) x0 * window_width / buffer->width);
+        const int32_t dst_y0 = (int32_t) ((int64_t) y0 * window_height / buffer->height);
+        const int32_t dst_x1 = (int32_t) ((int64_t) x1 * window_width / buffer->width);
+        const int32_t dst_y1 = (int32_t) ((int64_t) y1 * window_height / buffer->height);
+
+        StretchDIBits(
+            device_context,
+            dst_x0, dst_y0, dst_x1 - dst_x0, dst_y1 - dst_y0,
+            x0, 0, x1 - x0, y1 - y0,
+            rows,
+            &info,
+            DIB_RGB_COLORS,
+            SRCCOPY
+        );
+    }
+
+    TracyCZoneEnd(win32_stretchDIBits_rects_tracy);
+}
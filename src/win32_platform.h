@@ -12,6 +12,8 @@ typedef struct {
 
 void win32_resize_dib_section(graphics_buffer *buffer, uint32_t width, uint32_t height);
 
+void win32_free_buffer(graphics_buffer *buffer);
+
 void win32_display_buffer(
     const graphics_buffer *buffer,
     HDC device_context,
@@ -19,4 +21,15 @@ void win32_display_buffer(
     uint32_t window_height
 );
 
+// Presents only the given rectangles (inclusive pixel bounds, as from renderer_take_dirty_rects),
+// each scaled to the window the same way the full present is.
+void win32_display_buffer_rects(
+    const graphics_buffer *buffer,
+    HDC device_context,
+    uint32_t window_width,
+    uint32_t window_height,
+    const ivec4 *rects,
+    uint32_t rect_count
+);
+
 #endif //MYC23PROJECT_WIN32_PLATFORM_H
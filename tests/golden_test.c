@@ -0,0 +1,732 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aligned_memory.h"
+#include "cglm/cglm.h"
+#include "cube.h"
+#include "renderer.h"
+#include "tracy/TracyC.h"
+
+// Golden-image conformance of the raster paths. Every canonical scene is rendered headlessly
+// through each selectable path; the scalar immediate fill is the reference implementation.
+// Each path must match the other paths' pixels exactly, since they share triangle setup and
+// the top-left fill rule, and the reference image stored in the source tree up to a few
+// pixels on coverage boundaries, where a different compiler's rounding may move an edge
+// across a pixel center. A mismatch anywhere else fails. Failures write the rendered image
+// and a diff image next to each other, and list the first mismatches.
+
+#define GOLDEN_WIDTH 157 // Odd sizes: partial 8-pixel blocks, partial tiles
+#define GOLDEN_HEIGHT 113
+#define GOLDEN_MAX_REPORTED 8
+#define GOLDEN_EDGE_CONTRAST 32 // See on_boundary
+
+typedef enum {
+    GOLDEN_PATH_SCALAR, // Immediate, one pixel per iteration
+    GOLDEN_PATH_SIMD, // Immediate, 8 pixels per iteration
+    GOLDEN_PATH_TILED, // Binned, rasterized per tile on one thread
+    GOLDEN_PATH_THREADED, // Binned, tiles spread over GOLDEN_THREADS threads
+    GOLDEN_PATH_COUNT,
+} golden_path;
+
+#define GOLDEN_THREADS 4
+
+static const char *g_path_names[GOLDEN_PATH_COUNT] = {"scalar", "simd", "tiled", "threaded"};
+
+typedef struct {
+    model cube; // Position colors, see position_attributes
+    model checker_cube; // Same attributes, for checker_shader
+    model fan; // Unshared vertices, one color per triangle
+    model grid; // Same
+    model sphere; // Edges only, for render_obj_wire
+    float *instance_components;
+    instance_data instances;
+} golden_assets;
+
+#define GOLDEN_INSTANCE_COUNT 64
+
+typedef void golden_draw(const golden_assets *assets, camera *cam, graphics_buffer *buff);
+
+typedef struct {
+    const char *name;
+    golden_draw *draw; // Between renderer_begin_frame and renderer_end_frame
+    golden_draw *overlay; // After renderer_end_frame, straight to the framebuffer; may be 0
+    bool single_layer; // No triangle overlaps another: every covered pixel is written exactly once
+    uint32_t edge_tolerance; // Boundary pixels that may differ from the stored reference
+} golden_scene;
+
+// --- Assets ---
+
+static bool alloc_model(model *m, const uint32_t vertex_count, const uint32_t index_count,
+                        const uint32_t attribute_count) {
+    *m = (model){0};
+    m->vertices = malloc(sizeof(vec4) * vertex_count);
+    m->indices = malloc(sizeof(uint32_t) * index_count);
+    m->attributes = attribute_count ? malloc(sizeof(float) * attribute_count * vertex_count) : 0;
+    if (!m->vertices || !m->indices || (attribute_count && !m->attributes)) {
+        free(m->vertices);
+        free(m->indices);
+        free(m->attributes);
+        *m = (model){0};
+        return false;
+    }
+    TracyCAlloc(m->vertices, sizeof(vec4) * vertex_count);
+    TracyCAlloc(m->indices, sizeof(uint32_t) * index_count);
+    if (m->attributes) {
+        TracyCAlloc(m->attributes, sizeof(float) * attribute_count * vertex_count);
+    }
+
+    m->vertex_count = vertex_count;
+    m->index_count = index_count;
+    m->attribute_count = attribute_count;
+    return true;
+}
+
+// Same as the headless runner: the model-space position remapped to [0, 1] over the bounds,
+// read as r, g, b by the Gouraud fill
+static bool add_position_attributes(model *m) {
+    float *attributes = malloc(sizeof(float) * 3 * m->vertex_count);
+    if (!attributes) {
+        return false;
+    }
+    TracyCAlloc(attributes, sizeof(float) * 3 * m->vertex_count);
+
+    vec3 lo, hi;
+    glm_vec3_copy(m->vertices[0], lo);
+    glm_vec3_copy(m->vertices[0], hi);
+    for (uint32_t v = 1; v < m->vertex_count; ++v) {
+        glm_vec3_minv(lo, m->vertices[v], lo);
+        glm_vec3_maxv(hi, m->vertices[v], hi);
+    }
+    for (uint32_t v = 0; v < m->vertex_count; ++v) {
+        for (int a = 0; a < 3; ++a) {
+            const float extent = hi[a] - lo[a];
+            attributes[v * 3 + a] = extent > 0.0f ? (m->vertices[v][a] - lo[a]) / extent : 0.5f;
+        }
+    }
+
+    m->attributes = attributes;
+    m->attribute_count = 3;
+    return true;
+}
+
+// Flat color of triangle t as Gouraud attributes on its three unshared vertices. Distinct
+// neighbours make every pixel on a shared edge show which triangle claimed it.
+static void set_triangle_color(model *m, const uint32_t t) {
+    const float rgb[3] = {
+        (float) (t * 53 % 224 + 32) / 255.0f,
+        (float) (t * 97 % 224 + 32) / 255.0f,
+        (float) (t * 151 % 224 + 32) / 255.0f,
+    };
+    for (uint32_t k = 0; k < 3; ++k) {
+        memcpy(m->attributes + (t * 3 + k) * 3, rgb, sizeof(rgb));
+        m->indices[t * 3 + k] = t * 3 + k;
+    }
+}
+
+static void set_vertex(model *m, const uint32_t v, const float x, const float y, const float z) {
+    m->vertices[v][0] = x;
+    m->vertices[v][1] = y;
+    m->vertices[v][2] = z;
+    m->vertices[v][3] = 1.0f;
+}
+
+// Triangles around a point in the z = 0 plane, with angles that narrow towards the start so
+// the fan goes from wide triangles to slivers thinner than a pixel
+static bool make_fan(model *m, const uint32_t count) {
+    if (!alloc_model(m, count * 3, count * 3, 3)) {
+        return false;
+    }
+
+    const float cx = 0.13f, cy = 0.07f, radius = 1.4f;
+    for (uint32_t t = 0; t < count; ++t) {
+        const float a0 = 2.0f * (float) GLM_PI * powf((float) t / (float) count, 1.6f);
+        const float a1 = 2.0f * (float) GLM_PI * powf((float) (t + 1) / (float) count, 1.6f);
+        // Clockwise on screen: center, then the later angle, then the earlier one
+        set_vertex(m, t * 3, cx, cy, 0.0f);
+        set_vertex(m, t * 3 + 1, cx + radius * cosf(a1), cy + radius * sinf(a1), 0.0f);
+        set_vertex(m, t * 3 + 2, cx + radius * cosf(a0), cy + radius * sinf(a0), 0.0f);
+        set_triangle_color(m, t);
+    }
+    return true;
+}
+
+// columns x rows quads in the z = 0 plane, split along alternating diagonals
+static bool make_grid(model *m, const uint32_t columns, const uint32_t rows) {
+    const uint32_t count = columns * rows * 2;
+    if (!alloc_model(m, count * 3, count * 3, 3)) {
+        return false;
+    }
+
+    uint32_t t = 0;
+    for (uint32_t y = 0; y < rows; ++y) {
+        for (uint32_t x = 0; x < columns; ++x) {
+            const float x0 = 3.0f * ((float) x / (float) columns - 0.5f);
+            const float x1 = 3.0f * ((float) (x + 1) / (float) columns - 0.5f);
+            const float y0 = 3.0f * ((float) y / (float) rows - 0.5f);
+            const float y1 = 3.0f * ((float) (y + 1) / (float) rows - 0.5f);
+            if ((x + y) & 1) {
+                set_vertex(m, t * 3, x0, y0, 0.0f);
+                set_vertex(m, t * 3 + 1, x1, y1, 0.0f);
+                set_vertex(m, t * 3 + 2, x1, y0, 0.0f);
+                set_triangle_color(m, t++);
+                set_vertex(m, t * 3, x0, y0, 0.0f);
+                set_vertex(m, t * 3 + 1, x0, y1, 0.0f);
+                set_vertex(m, t * 3 + 2, x1, y1, 0.0f);
+                set_triangle_color(m, t++);
+            } else {
+                set_vertex(m, t * 3, x0, y0, 0.0f);
+                set_vertex(m, t * 3 + 1, x0, y1, 0.0f);
+                set_vertex(m, t * 3 + 2, x1, y0, 0.0f);
+                set_triangle_color(m, t++);
+                set_vertex(m, t * 3, x1, y0, 0.0f);
+                set_vertex(m, t * 3 + 1, x0, y1, 0.0f);
+                set_vertex(m, t * 3 + 2, x1, y1, 0.0f);
+                set_triangle_color(m, t++);
+            }
+        }
+    }
+    return true;
+}
+
+static bool make_sphere(model *m, const uint32_t slices, const uint32_t stacks) {
+    if (!alloc_model(m, (slices + 1) * (stacks + 1), slices * stacks * 6, 0)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i <= stacks; ++i) {
+        const float theta = (float) GLM_PI * (float) i / (float) stacks;
+        for (uint32_t j = 0; j <= slices; ++j) {
+            const float phi = 2.0f * (float) GLM_PI * (float) j / (float) slices;
+            set_vertex(m, i * (slices + 1) + j, sinf(theta) * cosf(phi), cosf(theta), -sinf(theta) * sinf(phi));
+        }
+    }
+
+    uint32_t *out = m->indices;
+    for (uint32_t i = 0; i < stacks; ++i) {
+        for (uint32_t j = 0; j < slices; ++j) {
+            const uint32_t top = i * (slices + 1) + j;
+            const uint32_t bottom = top + slices + 1;
+            const uint32_t quad[6] = {bottom, top + 1, bottom + 1, bottom, top, top + 1};
+            memcpy(out, quad, sizeof(quad));
+            out += 6;
+        }
+    }
+    model_build_unique_edges(m);
+    return true;
+}
+
+// A 4 x 4 x 4 block of cubes, each turned its own way, some overlapping on screen
+static bool make_instances(golden_assets *assets) {
+    const uint32_t count = GOLDEN_INSTANCE_COUNT;
+    float *c = malloc(sizeof(float) * count * 10);
+    if (!c) {
+        return false;
+    }
+    TracyCAlloc(c, sizeof(float) * count * 10);
+    assets->instance_components = c;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        c[i] = ((float) (i % 4) - 1.5f) * 0.7f;
+        c[count + i] = ((float) (i / 4 % 4) - 1.5f) * 0.45f;
+        c[2 * count + i] = -((float) (i / 16) - 1.5f) * 0.6f;
+
+        versor q;
+        glm_quat(q, (float) i * 0.37f, 0.3f, 1.0f, (float) (i % 5) * 0.2f);
+        for (uint32_t k = 0; k < 4; ++k) {
+            c[(3 + k) * count + i] = q[k];
+        }
+        for (uint32_t k = 0; k < 3; ++k) {
+            c[(7 + k) * count + i] = 0.35f;
+        }
+    }
+
+    assets->instances = (instance_data){
+        c, c + count, c + 2 * count,
+        c + 3 * count, c + 4 * count, c + 5 * count, c + 6 * count,
+        c + 7 * count, c + 8 * count, c + 9 * count,
+    };
+    return true;
+}
+
+static bool assets_init(golden_assets *assets) {
+    *assets = (golden_assets){0};
+    init_cube_mesh(&assets->cube);
+    init_cube_mesh(&assets->checker_cube);
+    return add_position_attributes(&assets->cube) && add_position_attributes(&assets->checker_cube) &&
+           make_fan(&assets->fan, 40) && make_grid(&assets->grid, 9, 7) && make_sphere(&assets->sphere, 24, 12) &&
+           make_instances(assets);
+}
+
+static void assets_free(golden_assets *assets) {
+    model_free(&assets->cube);
+    model_free(&assets->checker_cube);
+    model_free(&assets->fan);
+    model_free(&assets->grid);
+    model_free(&assets->sphere);
+    if (assets->instance_components) {
+        TracyCFree(assets->instance_components);
+        free(assets->instance_components);
+    }
+    *assets = (golden_assets){0};
+}
+
+// --- Scenes ---
+
+// Same cells as the headless runner's checker shader: straight cell borders on screen show
+// the interpolation is perspective-correct
+static void checker_shader(const raster_fragments *restrict fragments, const uint32_t attribute_count,
+                           const void *user, uint32_t colors[8]) {
+    (void) attribute_count;
+    (void) user;
+    for (int lane = 0; lane < 8; ++lane) {
+        const int cell = (int) floorf(fragments->values[0][lane] * 7.5f + 0.25f) +
+                         (int) floorf(fragments->values[1][lane] * 7.5f + 0.25f) +
+                         (int) floorf(fragments->values[2][lane] * 7.5f + 0.25f);
+        colors[lane] = cell & 1 ? 0x00E0E0E0 : 0x00304080;
+    }
+}
+
+static void draw_fan(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = GLM_VEC3_ZERO_INIT;
+    versor rot = GLM_QUAT_IDENTITY_INIT;
+    render_obj_raster(assets->fan, pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+// Tilted away in perspective, so no edge is axis aligned or evenly spaced on screen
+static void draw_grid(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = {0.1f, -0.2f, 0.0f};
+    versor rot;
+    glm_quat(rot, -0.9f, 1.0f, 0.2f, 0.1f);
+    render_obj_raster(assets->grid, pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+// Two interpenetrating cubes: depth test along their intersection
+static void draw_cubes(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = {-0.3f, 0.1f, 0.0f};
+    versor rot;
+    glm_quat(rot, 0.7f, 1.0f, 1.0f, 0.3f);
+    render_obj_raster(assets->cube, pos, rot, (vec3){1.6f, 1.6f, 1.6f}, cam, buff);
+
+    vec3 pos2 = {0.5f, -0.2f, 0.2f};
+    glm_quat(rot, 2.1f, 0.2f, 1.0f, 0.5f);
+    render_obj_raster(assets->cube, pos2, rot, (vec3){1.2f, 1.2f, 1.2f}, cam, buff);
+}
+
+// Long beams reaching past the camera: the clipper's near-plane fans, and perspective-correct
+// attributes on triangles stretched across most of the screen
+static void draw_near_clip(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    renderer_set_shader(checker_shader, 0);
+    versor rot;
+    glm_quat(rot, 0.15f, 0.0f, 1.0f, 0.0f);
+    vec3 right = {1.1f, -0.7f, 0.0f};
+    render_obj_raster(assets->checker_cube, right, rot, (vec3){1.0f, 1.0f, 8.0f}, cam, buff);
+    vec3 left = {-1.3f, 0.6f, 0.5f};
+    render_obj_raster(assets->checker_cube, left, rot, (vec3){0.8f, 0.8f, 8.0f}, cam, buff);
+    renderer_set_shader(0, 0);
+}
+
+static void draw_instances(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    render_obj_raster_instanced(&assets->cube, &assets->instances, GOLDEN_INSTANCE_COUNT, cam, buff);
+}
+
+// The same models without their attributes: flat white triangles go through the raster path's
+// own fill, scalar or SIMD, where attributes always take the SIMD attribute fill
+static model without_attributes(model m) {
+    m.attributes = 0;
+    m.attribute_count = 0;
+    return m;
+}
+
+static void draw_fan_flat(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = GLM_VEC3_ZERO_INIT;
+    versor rot = GLM_QUAT_IDENTITY_INIT;
+    render_obj_raster(without_attributes(assets->fan), pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+static void draw_grid_flat(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    vec3 pos = {0.1f, -0.2f, 0.0f};
+    versor rot;
+    glm_quat(rot, -0.9f, 1.0f, 0.2f, 0.1f);
+    render_obj_raster(without_attributes(assets->grid), pos, rot, GLM_VEC3_ONE, cam, buff);
+}
+
+static void draw_instances_flat(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    const model flat = without_attributes(assets->cube);
+    render_obj_raster_instanced(&flat, &assets->instances, GOLDEN_INSTANCE_COUNT, cam, buff);
+}
+
+static void overlay_wire(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    versor rot;
+    glm_quat(rot, 0.5f, 1.0f, 1.0f, 0.0f);
+    renderer_set_line_mode(LINE_MODE_ALIASED);
+    render_obj_wire(assets->sphere, GLM_VEC3_ZERO, rot, (vec3){1.2f, 1.2f, 1.2f}, cam, buff);
+    // Reaches far off screen on both sides: clipped lines
+    render_obj_wire(assets->cube, (vec3){0.0f, 0.0f, -2.0f}, rot, (vec3){14.0f, 0.5f, 0.5f}, cam, buff);
+}
+
+static void overlay_wire_antialiased(const golden_assets *assets, camera *cam, graphics_buffer *buff) {
+    versor rot;
+    glm_quat(rot, 0.5f, 1.0f, 1.0f, 0.0f);
+    renderer_set_line_mode(LINE_MODE_ANTIALIASED);
+    render_obj_wire(assets->sphere, GLM_VEC3_ZERO, rot, (vec3){1.2f, 1.2f, 1.2f}, cam, buff);
+    render_obj_wire(assets->cube, (vec3){0.0f, 0.0f, -2.0f}, rot, (vec3){14.0f, 0.5f, 0.5f}, cam, buff);
+    renderer_set_line_mode(LINE_MODE_ALIASED);
+}
+
+static const golden_scene g_scenes[] = {
+    {"fan", draw_fan, 0, true, 8},
+    {"fan_flat", draw_fan_flat, 0, true, 8},
+    {"grid", draw_grid, 0, true, 16},
+    {"grid_flat", draw_grid_flat, 0, true, 16},
+    {"cubes", draw_cubes, 0, false, 16},
+    {"near_clip", draw_near_clip, 0, false, 16},
+    {"instances", draw_instances, 0, false, 32},
+    {"instances_flat", draw_instances_flat, 0, false, 32},
+    {"wire", draw_cubes, overlay_wire, false, 32},
+    {"wire_aa", draw_cubes, overlay_wire_antialiased, false, 64},
+};
+
+// --- Rendering ---
+
+typedef struct {
+    uint32_t *pixels; // width x height, no padding
+    uint64_t pixels_written;
+} golden_image;
+
+static bool render_scene(const golden_assets *assets, const golden_scene *scene, const golden_path path,
+                         golden_image *image) {
+    graphics_buffer buff = {0};
+    buff.width = GOLDEN_WIDTH;
+    buff.height = GOLDEN_HEIGHT;
+    buff.pitch = GOLDEN_WIDTH * 4;
+    buff.memory_size = ((size_t) buff.pitch * buff.height + 63) & ~(size_t) 63;
+    buff.memory = aligned_malloc(64, buff.memory_size);
+    image->pixels = malloc(sizeof(uint32_t) * GOLDEN_WIDTH * GOLDEN_HEIGHT);
+    if (!buff.memory || !image->pixels) {
+        aligned_free(buff.memory);
+        free(image->pixels);
+        image->pixels = 0;
+        return false;
+    }
+    TracyCAlloc(buff.memory, buff.memory_size);
+    TracyCAlloc(image->pixels, sizeof(uint32_t) * GOLDEN_WIDTH * GOLDEN_HEIGHT);
+
+    renderer_set_raster_path(path == GOLDEN_PATH_SCALAR ? RASTER_PATH_SCALAR : RASTER_PATH_SIMD);
+    renderer_depth_init(&buff);
+    if (path == GOLDEN_PATH_TILED || path == GOLDEN_PATH_THREADED) {
+        renderer_tiles_init(&buff);
+        renderer_set_thread_count(path == GOLDEN_PATH_THREADED ? GOLDEN_THREADS : 1);
+    }
+
+    camera cam;
+    vec3 eye = {0.0f, 0.0f, 3.0f};
+    versor look;
+    glm_quat_forp(eye, GLM_VEC3_ZERO, ((vec3){0.0f, 1.0f, 0.0f}), look);
+    camera_init(&cam, eye, look, glm_rad(60.0f), (float) buff.width / (float) buff.height, 0.1f, 100.0f);
+
+    clean_buff(&buff);
+    renderer_begin_frame(&buff);
+    scene->draw(assets, &cam, &buff);
+    renderer_end_frame(&buff);
+    if (scene->overlay) {
+        scene->overlay(assets, &cam, &buff);
+    }
+
+    renderer_stats stats;
+    renderer_get_stats(&stats);
+    image->pixels_written = stats.pixels_written;
+    for (uint32_t y = 0; y < buff.height; ++y) {
+        memcpy(image->pixels + y * GOLDEN_WIDTH, (const uint8_t *) buff.memory + (size_t) y * buff.pitch,
+               sizeof(uint32_t) * GOLDEN_WIDTH);
+    }
+
+    renderer_set_thread_count(1);
+    renderer_tiles_free(&buff);
+    renderer_depth_free(&buff);
+    TracyCFree(buff.memory);
+    aligned_free(buff.memory);
+    return true;
+}
+
+static void image_free(golden_image *image) {
+    if (image->pixels) {
+        TracyCFree(image->pixels);
+        free(image->pixels);
+    }
+    *image = (golden_image){0};
+}
+
+// --- PPM files ---
+
+static bool write_ppm(const char *path, const uint32_t *pixels) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", GOLDEN_WIDTH, GOLDEN_HEIGHT);
+    for (uint32_t i = 0; i < GOLDEN_WIDTH * GOLDEN_HEIGHT; ++i) {
+        const uint8_t rgb[3] = {(uint8_t) (pixels[i] >> 16), (uint8_t) (pixels[i] >> 8), (uint8_t) pixels[i]};
+        fwrite(rgb, 1, 3, file);
+    }
+    return fclose(file) == 0;
+}
+
+// Binary PPMs of exactly GOLDEN_WIDTH x GOLDEN_HEIGHT, as write_ppm writes them
+static bool read_ppm(const char *path, uint32_t *pixels) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint32_t width, height, max_value;
+    bool ok = fscanf(file, "P6 %u %u %u", &width, &height, &max_value) == 3 && fgetc(file) != EOF &&
+              width == GOLDEN_WIDTH && height == GOLDEN_HEIGHT && max_value == 255;
+    for (uint32_t i = 0; ok && i < GOLDEN_WIDTH * GOLDEN_HEIGHT; ++i) {
+        uint8_t rgb[3];
+        ok = fread(rgb, 1, 3, file) == 3;
+        pixels[i] = (uint32_t) rgb[0] << 16 | (uint32_t) rgb[1] << 8 | rgb[2];
+    }
+    fclose(file);
+    return ok;
+}
+
+// --- Comparison ---
+
+// A pixel on a coverage boundary: its 8 neighbours, itself left out so that a single wrong pixel
+// does not qualify, span more than a Gouraud gradient does over three pixels in some channel
+static bool on_boundary(const uint32_t *pixels, const uint32_t x, const uint32_t y) {
+    int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            const int nx = (int) x + dx, ny = (int) y + dy;
+            if ((!dx && !dy) || nx < 0 || ny < 0 || nx >= GOLDEN_WIDTH || ny >= GOLDEN_HEIGHT) {
+                continue;
+            }
+            const uint32_t color = pixels[ny * GOLDEN_WIDTH + nx];
+            for (int c = 0; c < 3; ++c) {
+                const int value = (int) (color >> (16 - 8 * c)) & 0xFF;
+                lo[c] = value < lo[c] ? value : lo[c];
+                hi[c] = value > hi[c] ? value : hi[c];
+            }
+        }
+    }
+    return hi[0] - lo[0] > GOLDEN_EDGE_CONTRAST || hi[1] - lo[1] > GOLDEN_EDGE_CONTRAST ||
+           hi[2] - lo[2] > GOLDEN_EDGE_CONTRAST;
+}
+
+typedef struct {
+    uint32_t boundary; // Differing pixels on a coverage boundary in either image
+    uint32_t interior; // Differing pixels anywhere else
+} golden_diff;
+
+// Compares actual to expected, and writes the diff image when diff_path is set: matching pixels
+// dimmed, boundary mismatches yellow, interior mismatches red
+static golden_diff compare_images(const uint32_t *expected, const uint32_t *actual, const char *label,
+                                  const char *diff_path) {
+    golden_diff diff = {0};
+    uint32_t *diff_pixels = diff_path ? malloc(sizeof(uint32_t) * GOLDEN_WIDTH * GOLDEN_HEIGHT) : 0;
+
+    for (uint32_t y = 0; y < GOLDEN_HEIGHT; ++y) {
+        for (uint32_t x = 0; x < GOLDEN_WIDTH; ++x) {
+            const uint32_t i = y * GOLDEN_WIDTH + x;
+            if (expected[i] == actual[i]) {
+                if (diff_pixels) {
+                    diff_pixels[i] = expected[i] >> 2 & 0x003F3F3F;
+                }
+                continue;
+            }
+
+            const bool boundary = on_boundary(expected, x, y) || on_boundary(actual, x, y);
+            if (diff.boundary + diff.interior < GOLDEN_MAX_REPORTED) {
+                fprintf(stderr, "    %s: (%u, %u) expected %06X, got %06X%s\n", label, x, y, expected[i], actual[i],
+                        boundary ? " (boundary)" : "");
+            }
+            diff.boundary += boundary;
+            diff.interior += !boundary;
+            if (diff_pixels) {
+                diff_pixels[i] = boundary ? 0x00FFFF00 : 0x00FF0000;
+            }
+        }
+    }
+
+    if (diff_pixels) {
+        if (diff.boundary + diff.interior && !write_ppm(diff_path, diff_pixels)) {
+            fprintf(stderr, "    failed to write %s\n", diff_path);
+        }
+        free(diff_pixels);
+    }
+    return diff;
+}
+
+static uint32_t count_covered(const uint32_t *pixels) {
+    uint32_t covered = 0;
+    for (uint32_t i = 0; i < GOLDEN_WIDTH * GOLDEN_HEIGHT; ++i) {
+        covered += pixels[i] != 0;
+    }
+    return covered;
+}
+
+// Renders the scene through every path and checks them. update writes the scalar render as
+// the new reference instead of reading it.
+static bool check_scene(const golden_assets *assets, const golden_scene *scene, const char *reference_dir,
+                        const char *output_dir, const bool update) {
+    char path[1024];
+    bool passed = true;
+
+    golden_image images[GOLDEN_PATH_COUNT] = {0};
+    for (uint32_t p = 0; p < GOLDEN_PATH_COUNT; ++p) {
+        if (!render_scene(assets, scene, p, &images[p])) {
+            fprintf(stderr, "%s: failed to allocate a %ux%u target\n", scene->name, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+            passed = false;
+            goto done;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/%s.ppm", reference_dir, scene->name);
+    if (update) {
+        if (!write_ppm(path, images[GOLDEN_PATH_SCALAR].pixels)) {
+            fprintf(stderr, "%s: failed to write %s\n", scene->name, path);
+            passed = false;
+        } else {
+            printf("%-14s reference written to %s\n", scene->name, path);
+        }
+        goto done;
+    }
+
+    uint32_t *reference = malloc(sizeof(uint32_t) * GOLDEN_WIDTH * GOLDEN_HEIGHT);
+    if (!reference || !read_ppm(path, reference)) {
+        fprintf(stderr, "%s: missing or malformed reference %s (run with -u to create it)\n", scene->name, path);
+        free(reference);
+        passed = false;
+        goto done;
+    }
+
+    for (uint32_t p = 0; p < GOLDEN_PATH_COUNT; ++p) {
+        const uint32_t *pixels = images[p].pixels;
+        char label[64], diff_path[1024] = "";
+        bool path_passed = true;
+
+        // Against the stored reference: boundary pixels within the scene's tolerance
+        snprintf(label, sizeof(label), "%s vs reference", g_path_names[p]);
+        if (output_dir) {
+            snprintf(diff_path, sizeof(diff_path), "%s/%s_%s_diff.ppm", output_dir, scene->name, g_path_names[p]);
+        }
+        const golden_diff to_reference = compare_images(reference, pixels, label, output_dir ? diff_path : 0);
+        if (to_reference.interior || to_reference.boundary > scene->edge_tolerance) {
+            fprintf(stderr, "  %s: %u interior and %u boundary pixels differ from the reference (tolerance %u)\n",
+                    label, to_reference.interior, to_reference.boundary, scene->edge_tolerance);
+            path_passed = false;
+        }
+
+        // Against the scalar path of this build: exact
+        if (p != GOLDEN_PATH_SCALAR) {
+            snprintf(label, sizeof(label), "%s vs scalar", g_path_names[p]);
+            if (output_dir) {
+                snprintf(diff_path, sizeof(diff_path), "%s/%s_%s_vs_scalar_diff.ppm", output_dir, scene->name,
+                         g_path_names[p]);
+            }
+            const golden_diff to_scalar = compare_images(images[GOLDEN_PATH_SCALAR].pixels, pixels, label,
+                                                         output_dir ? diff_path : 0);
+            if (to_scalar.interior || to_scalar.boundary) {
+                fprintf(stderr, "  %s: %u interior and %u boundary pixels differ\n", label, to_scalar.interior,
+                        to_scalar.boundary);
+                path_passed = false;
+            }
+        }
+
+        // The fill rule itself: on a single layer of triangles no pixel is written twice
+        if (scene->single_layer) {
+            const uint32_t covered = count_covered(pixels);
+            if (images[p].pixels_written != covered) {
+                fprintf(stderr, "  %s: %llu pixels written for %u covered\n", g_path_names[p],
+                        (unsigned long long) images[p].pixels_written, covered);
+                path_passed = false;
+            }
+        }
+
+        if (!path_passed && output_dir) {
+            snprintf(path, sizeof(path), "%s/%s_%s.ppm", output_dir, scene->name, g_path_names[p]);
+            write_ppm(path, pixels);
+        }
+        printf("%-14s %-9s %s (%u boundary pixels off the reference)\n", scene->name, g_path_names[p],
+               path_passed ? "ok" : "FAILED", to_reference.boundary);
+        passed &= path_passed;
+    }
+    free(reference);
+
+done:
+    for (uint32_t p = 0; p < GOLDEN_PATH_COUNT; ++p) {
+        image_free(&images[p]);
+    }
+    return passed;
+}
+
+static void print_usage(const char *exe) {
+    fprintf(stderr,
+            "usage: %s -r reference_dir [-o output_dir] [-s scene] [-u]\n"
+            "  -r   directory of the reference images, <scene>.ppm\n"
+            "  -o   write the failing renders and diff images here (must exist)\n"
+            "  -s   only this scene\n"
+            "  -u   write the scalar renders as the new references instead of checking\n"
+            "scenes:",
+            exe);
+    for (size_t s = 0; s < sizeof(g_scenes) / sizeof(g_scenes[0]); ++s) {
+        fprintf(stderr, " %s", g_scenes[s].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(const int argc, char **argv) {
+    const char *reference_dir = 0;
+    const char *output_dir = 0;
+    const char *only = 0;
+    bool update = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:o:s:u")) != -1) {
+        switch (opt) {
+            case 'r': reference_dir = optarg;
+                break;
+            case 'o': output_dir = optarg;
+                break;
+            case 's': only = optarg;
+                break;
+            case 'u': update = true;
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (!reference_dir) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    golden_assets assets;
+    if (!assets_init(&assets)) {
+        fprintf(stderr, "failed to build the scenes\n");
+        return 1;
+    }
+
+    bool passed = true;
+    uint32_t checked = 0;
+    for (size_t s = 0; s < sizeof(g_scenes) / sizeof(g_scenes[0]); ++s) {
+        if (only && strcmp(only, g_scenes[s].name) != 0) {
+            continue;
+        }
+        passed &= check_scene(&assets, &g_scenes[s], reference_dir, output_dir, update);
+        checked++;
+    }
+    if (!checked) {
+        fprintf(stderr, "no scene named %s\n", only);
+        passed = false;
+    }
+
+    assets_free(&assets);
+    return passed ? 0 : 1;
+}
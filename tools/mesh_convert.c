@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "mesh_file.h"
+#include "obj_import.h"
+#include "renderer.h"
+
+// Offline OBJ -> binary mesh converter. Parsing, triangulation and edge building happen here
+// once, so the renderer only has to map the result.
+int main(const int argc, char **argv) {
+    bool build_edges = true;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--no-edges") == 0) {
+        build_edges = false;
+        ++arg;
+    }
+
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [--no-edges] input.obj output.mesh\n", argv[0]);
+        return 1;
+    }
+    const char *input = argv[arg];
+    const char *output = argv[arg + 1];
+
+    model m;
+    if (!obj_import(input, &m)) {
+        fprintf(stderr, "failed to import %s\n", input);
+        return 1;
+    }
+
+    if (build_edges) {
+        model_build_unique_edges(&m);
+    }
+
+    if (!mesh_file_write(output, &m)) {
+        fprintf(stderr, "failed to write %s\n", output);
+        model_free(&m);
+        return 1;
+    }
+
+    printf("%s: %u vertices, %u triangles, %u edges\n", output, m.vertex_count, m.index_count / 3, m.edge_count);
+    model_free(&m);
+    return 0;
+}